@@ -0,0 +1,114 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Microbenchmarks, one file per stack module (like the unit tests). Every case
+//reports the time per operation and, when it moves bytes, the throughput.
+//Build from the repository root, with the flags you ship with:
+//  gcc -O2 -Iinc src/*.c bench/*.c -o bench/bench
+//Usage: bench/bench [filter]. Only the cases whose name contains 'filter' run.
+
+#include "bench.h"
+#include <time.h>
+
+const uint8_t bench_size[BENCH_SIZES] = {0, 16, 64, 128, 192};
+const uint8_t bench_density[BENCH_DENSITIES] = {0, 10, 100};
+volatile uint32_t bench_sink = 0;
+static const char *bench_filter = NULL;
+
+static uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//Time 'fn', print ns/op and MB/s (if 'bytes_per_op' isn't 0)
+void bench_run(const char *name, const char *params, bench_fn fn, void *ctx,
+		uint32_t bytes_per_op)
+{
+	uint32_t iterations = 1;
+	uint64_t start = 0, elapsed = 0;
+	double ns_per_op = 0;
+
+	if(bench_filter && !strstr(name, bench_filter))
+	{
+		return;
+	}
+
+	//Warm-up, then double until it takes long enough
+	fn(ctx, 1);
+	while(1)
+	{
+		start = bench_now_ns();
+		fn(ctx, iterations);
+		elapsed = bench_now_ns() - start;
+		if((elapsed >= BENCH_MIN_NS) || (iterations >= (1u << 30)))
+		{
+			break;
+		}
+		iterations *= 2;
+	}
+
+	ns_per_op = (double)elapsed / iterations;
+	printf("%-50s %-24s %10.1f ns/op", name, params, ns_per_op);
+	if(bytes_per_op)
+	{
+		printf(" %10.1f MB/s", bytes_per_op * 1e3 / ns_per_op);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+void bench_skip(const char *name, const char *params, const char *why)
+{
+	if(bench_filter && !strstr(name, bench_filter))
+	{
+		return;
+	}
+
+	printf("%-50s %-24s %s\n", name, params, why);
+}
+
+//Escapable bytes are spread evenly: 10% = one every 10 bytes. The others are
+//regular data.
+void bench_fill_payload(uint8_t *payload, uint8_t len, uint8_t density)
+{
+	static const uint8_t special[3] = {HEADER, FOOTER, ESCAPE};
+	uint32_t acc = 0;
+
+	for(uint8_t i = 0; i < len; i++)
+	{
+		acc += density;
+		if(acc >= 100)
+		{
+			acc -= 100;
+			payload[i] = special[i % 3];
+		}
+		else
+		{
+			payload[i] = i & 0x7F;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	bench_filter = (argc > 1) ? argv[1] : NULL;
+
+	printf("FlexSEA v2.0 Microbenchmarks\n");
+	printf("============================\n\n");
+
+	fx_rx_cmd_init();
+	bench_flexsea_tools();
+	bench_circ_buf();
+	bench_flexsea_codec();
+	bench_flexsea_command();
+
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,45 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef INC_BENCH_H
+#define INC_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "flexsea.h"
+
+//Each case runs for at least this long (the iteration count doubles until it
+//does)
+#define BENCH_MIN_NS			20000000
+
+//Payload sizes (bytes), and escape densities (% of the payload bytes that are
+//HEADER, FOOTER or ESCAPE)
+#define BENCH_SIZES				5
+#define BENCH_DENSITIES			3
+extern const uint8_t bench_size[BENCH_SIZES];
+extern const uint8_t bench_density[BENCH_DENSITIES];
+
+//A case: run 'iterations' operations on 'ctx'
+typedef void (*bench_fn)(void *ctx, uint32_t iterations);
+
+void bench_run(const char *name, const char *params, bench_fn fn, void *ctx,
+		uint32_t bytes_per_op);
+void bench_skip(const char *name, const char *params, const char *why);
+void bench_fill_payload(uint8_t *payload, uint8_t len, uint8_t density);
+
+//Results go here so the compiler can't drop the work
+extern volatile uint32_t bench_sink;
+
+//Prototypes for public functions defined in individual bench files:
+void bench_circ_buf(void);
+void bench_flexsea_codec(void);
+void bench_flexsea_command(void);
+void bench_flexsea_tools(void);
+
+#endif	//INC_BENCH_H
+
+#ifdef __cplusplus
+}
+#endif
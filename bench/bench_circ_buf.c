@@ -0,0 +1,122 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bench.h"
+#include "circ_buf.h"
+
+typedef struct
+{
+	circ_buf_t cb;
+	uint16_t n;
+}BenchCircBuf;
+
+//Buffer holding 'fill' bytes, with 'value' last
+static void bench_circ_buf_prepare(BenchCircBuf *b, uint16_t fill, uint8_t value)
+{
+	circ_buf_init(&b->cb);
+	for(uint16_t i = 0; i < fill; i++)
+	{
+		circ_buf_write_byte(&b->cb, (i == fill - 1) ? value : (i & 0x7F));
+	}
+}
+
+//One byte in, one byte out: the fill level stays the same
+static void bench_circ_buf_write_read_byte(void *ctx, uint32_t iterations)
+{
+	BenchCircBuf *b = ctx;
+	uint8_t value = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		circ_buf_write_byte(&b->cb, (uint8_t)i);
+		circ_buf_read_byte(&b->cb, &value);
+		bench_sink += value;
+	}
+}
+
+//Bulk write of 'n' bytes into an empty buffer
+static void bench_circ_buf_write(void *ctx, uint32_t iterations)
+{
+	static uint8_t bytes[CIRC_BUF_SIZE] = {0};
+	BenchCircBuf *b = ctx;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		b->cb.length = 0;
+		b->cb.read_index = b->cb.write_index;
+		bench_sink += circ_buf_write(&b->cb, bytes, b->n);
+	}
+}
+
+//The value is the last byte: the whole buffer is scanned
+static void bench_circ_buf_search(void *ctx, uint32_t iterations)
+{
+	BenchCircBuf *b = ctx;
+	uint16_t result = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		circ_buf_search(&b->cb, &result, HEADER, 0);
+		bench_sink += result;
+	}
+}
+
+static void bench_circ_buf_checksum(void *ctx, uint32_t iterations)
+{
+	BenchCircBuf *b = ctx;
+	uint8_t checksum = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		circ_buf_checksum(&b->cb, &checksum, 0, b->n);
+		bench_sink += checksum;
+	}
+}
+
+void bench_circ_buf(void)
+{
+	static BenchCircBuf b;
+	static const uint16_t fill[3] = {1, CIRC_BUF_SIZE / 2, CIRC_BUF_SIZE - 1};
+	char params[32];
+
+	for(int i = 0; i < 3; i++)
+	{
+		snprintf(params, sizeof(params), "fill=%u", fill[i]);
+		bench_circ_buf_prepare(&b, fill[i], 0);
+		bench_run("circ_buf_write_byte+read_byte", params,
+				&bench_circ_buf_write_read_byte, &b, 1);
+	}
+
+	for(int i = 1; i < BENCH_SIZES; i++)
+	{
+		snprintf(params, sizeof(params), "len=%u", bench_size[i]);
+		circ_buf_init(&b.cb);
+		b.n = bench_size[i];
+		bench_run("circ_buf_write", params, &bench_circ_buf_write, &b,
+				b.n);
+	}
+
+	for(int i = 0; i < 3; i++)
+	{
+		snprintf(params, sizeof(params), "fill=%u", fill[i]);
+		bench_circ_buf_prepare(&b, fill[i], HEADER);
+		bench_run("circ_buf_search", params, &bench_circ_buf_search, &b,
+				fill[i]);
+	}
+
+	for(int i = 1; i < BENCH_SIZES; i++)
+	{
+		snprintf(params, sizeof(params), "len=%u", bench_size[i]);
+		bench_circ_buf_prepare(&b, bench_size[i], 0);
+		b.n = bench_size[i];
+		bench_run("circ_buf_checksum", params, &bench_circ_buf_checksum, &b,
+				b.n);
+	}
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,146 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bench.h"
+#include "flexsea_codec.h"
+
+typedef struct
+{
+	uint8_t payload[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t len;
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t frame_len;
+	circ_buf_t cb;
+}BenchCodec;
+
+static void bench_fx_encode(void *ctx, uint32_t iterations)
+{
+	BenchCodec *b = ctx;
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t encoded_len = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		fx_encode(b->payload, b->len, encoded, &encoded_len,
+				MAX_ENCODED_PAYLOAD_BYTES);
+		bench_sink += encoded_len;
+	}
+}
+
+//One frame in, one frame out: the fill level stays the same. The write is
+//included, see circ_buf_write for its share.
+static void bench_fx_decode(void *ctx, uint32_t iterations)
+{
+	BenchCodec *b = ctx;
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t decoded[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t encoded_len = 0, decoded_len = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		circ_buf_write(&b->cb, b->frame, b->frame_len);
+		fx_decode(&b->cb, encoded, &encoded_len, decoded, &decoded_len);
+		bench_sink += decoded_len;
+	}
+}
+
+//'len' bytes without a header: everything is flushed
+static void bench_fx_cleanup(void *ctx, uint32_t iterations)
+{
+	BenchCodec *b = ctx;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		circ_buf_write(&b->cb, b->payload, b->len);
+		fx_cleanup(&b->cb);
+		bench_sink += b->cb.length;
+	}
+}
+
+//Frames queued ahead of the one we decode: 'fill' bytes. Returns FX_PROBLEM if
+//a lone frame can't be decoded.
+static uint8_t bench_codec_prepare(BenchCodec *b, uint8_t len, uint8_t density,
+		uint16_t fill)
+{
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t encoded_len = 0;
+
+	b->len = len;
+	bench_fill_payload(b->payload, len, density);
+	fx_encode(b->payload, len, b->frame, &b->frame_len,
+			MAX_ENCODED_PAYLOAD_BYTES);
+	circ_buf_init(&b->cb);
+	circ_buf_write(&b->cb, b->frame, b->frame_len);
+	if(fx_decode(&b->cb, encoded, &encoded_len, NULL, NULL))
+	{
+		return FX_PROBLEM;
+	}
+
+	while(b->cb.length + 2 * b->frame_len <= fill)
+	{
+		circ_buf_write(&b->cb, b->frame, b->frame_len);
+	}
+
+	return FX_SUCCESS;
+}
+
+void bench_flexsea_codec(void)
+{
+	static BenchCodec b;
+	static const uint16_t fill[3] = {0, CIRC_BUF_SIZE / 2, CIRC_BUF_SIZE};
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t encoded_len = 0;
+	char params[32];
+
+	for(int i = 0; i < BENCH_SIZES; i++)
+	{
+		for(int j = 0; j < BENCH_DENSITIES; j++)
+		{
+			snprintf(params, sizeof(params), "len=%u esc=%u%%", bench_size[i],
+					bench_density[j]);
+			bench_fill_payload(b.payload, bench_size[i], bench_density[j]);
+			if(fx_encode(b.payload, bench_size[i], encoded, &encoded_len,
+					MAX_ENCODED_PAYLOAD_BYTES))
+			{
+				bench_skip("fx_encode", params, "(doesn't fit)");
+				bench_skip("circ_buf_write+fx_decode", params, "(doesn't fit)");
+				continue;
+			}
+			b.len = bench_size[i];
+			bench_run("fx_encode", params, &bench_fx_encode, &b, b.len);
+			if(bench_codec_prepare(&b, bench_size[i], bench_density[j], 0))
+			{
+				bench_skip("circ_buf_write+fx_decode", params, "(not decoded)");
+				continue;
+			}
+			bench_run("circ_buf_write+fx_decode", params, &bench_fx_decode, &b,
+					b.len);
+		}
+	}
+
+	//Decoding with frames waiting behind
+	for(int i = 0; i < 3; i++)
+	{
+		snprintf(params, sizeof(params), "len=64 esc=10%% fill=%u", fill[i]);
+		bench_codec_prepare(&b, 64, 10, fill[i]);
+		bench_run("circ_buf_write+fx_decode", params, &bench_fx_decode, &b,
+				b.len);
+	}
+
+	for(int i = 1; i < BENCH_SIZES; i++)
+	{
+		snprintf(params, sizeof(params), "junk=%u", bench_size[i]);
+		circ_buf_init(&b.cb);
+		b.len = bench_size[i];
+		memset(b.payload, 0, b.len);
+		bench_run("circ_buf_write+fx_cleanup", params, &bench_fx_cleanup, &b,
+				b.len);
+	}
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
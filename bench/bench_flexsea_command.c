@@ -0,0 +1,86 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bench.h"
+#include "flexsea_command.h"
+
+#define BENCH_CMD	10
+
+typedef struct
+{
+	uint8_t payload[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t len;
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t bytestream_len;
+	circ_buf_t cb;
+}BenchCommand;
+
+static void bench_fx_create_bytestream_from_cmd(void *ctx, uint32_t iterations)
+{
+	BenchCommand *b = ctx;
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t bytestream_len = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		fx_create_bytestream_from_cmd(BENCH_CMD, CmdWrite, Nack, b->payload,
+				b->len, bytestream, &bytestream_len);
+		bench_sink += bytestream_len;
+	}
+}
+
+//The write is included, see circ_buf_write for its share
+static void bench_fx_get_cmd_handler_from_bytestream(void *ctx,
+		uint32_t iterations)
+{
+	BenchCommand *b = ctx;
+	uint8_t cmd_6bits = 0, buf[MAX_ENCODED_PAYLOAD_BYTES], buf_len = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		circ_buf_write(&b->cb, b->bytestream, b->bytestream_len);
+		fx_get_cmd_handler_from_bytestream(&b->cb, &cmd_6bits, &rw, &ack, buf,
+				&buf_len);
+		bench_sink += buf_len;
+	}
+}
+
+void bench_flexsea_command(void)
+{
+	static BenchCommand b;
+	char params[32];
+
+	for(int i = 0; i < BENCH_SIZES; i++)
+	{
+		for(int j = 0; j < BENCH_DENSITIES; j++)
+		{
+			snprintf(params, sizeof(params), "len=%u esc=%u%%", bench_size[i],
+					bench_density[j]);
+			b.len = bench_size[i];
+			bench_fill_payload(b.payload, b.len, bench_density[j]);
+			if(fx_create_bytestream_from_cmd(BENCH_CMD, CmdWrite, Nack,
+					b.payload, b.len, b.bytestream, &b.bytestream_len))
+			{
+				bench_skip("fx_create_bytestream_from_cmd", params,
+						"(doesn't fit)");
+				bench_skip("circ_buf_write+fx_get_cmd_handler_from_bytestream",
+						params, "(doesn't fit)");
+				continue;
+			}
+			bench_run("fx_create_bytestream_from_cmd", params,
+					&bench_fx_create_bytestream_from_cmd, &b, b.len);
+			circ_buf_init(&b.cb);
+			bench_run("circ_buf_write+fx_get_cmd_handler_from_bytestream",
+					params, &bench_fx_get_cmd_handler_from_bytestream, &b, b.len);
+		}
+	}
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,127 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bench.h"
+#include "flexsea_tools.h"
+
+//One operation = a full payload's worth of values
+#define BENCH_TOOLS_BYTES	196
+
+static uint8_t bench_tools_buf[BENCH_TOOLS_BYTES];
+
+static void bench_split_16(void *ctx, uint32_t iterations)
+{
+	uint16_t index = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		index = 0;
+		while(index < BENCH_TOOLS_BYTES)
+		{
+			SPLIT_16((uint16_t)(i + index), bench_tools_buf, &index);
+		}
+	}
+	bench_sink += bench_tools_buf[0];
+}
+
+static void bench_rebuild_uint16(void *ctx, uint32_t iterations)
+{
+	uint16_t index = 0;
+	uint32_t sum = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		index = 0;
+		while(index < BENCH_TOOLS_BYTES)
+		{
+			sum += REBUILD_UINT16(bench_tools_buf, &index);
+		}
+	}
+	bench_sink += sum;
+}
+
+static void bench_split_32(void *ctx, uint32_t iterations)
+{
+	uint16_t index = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		index = 0;
+		while(index < BENCH_TOOLS_BYTES)
+		{
+			SPLIT_32(i + index, bench_tools_buf, &index);
+		}
+	}
+	bench_sink += bench_tools_buf[0];
+}
+
+static void bench_rebuild_uint32(void *ctx, uint32_t iterations)
+{
+	uint16_t index = 0;
+	uint32_t sum = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		index = 0;
+		while(index < BENCH_TOOLS_BYTES)
+		{
+			sum += REBUILD_UINT32(bench_tools_buf, &index);
+		}
+	}
+	bench_sink += sum;
+}
+
+static void bench_split_float(void *ctx, uint32_t iterations)
+{
+	uint16_t index = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		index = 0;
+		while(index < BENCH_TOOLS_BYTES)
+		{
+			SPLIT_FLOAT((float)index, bench_tools_buf, &index);
+		}
+	}
+	bench_sink += bench_tools_buf[0];
+}
+
+static void bench_rebuild_float(void *ctx, uint32_t iterations)
+{
+	uint16_t index = 0;
+	float sum = 0;
+
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		index = 0;
+		while(index < BENCH_TOOLS_BYTES)
+		{
+			sum += REBUILD_FLOAT(bench_tools_buf, &index);
+		}
+	}
+	bench_sink += (uint32_t)sum;
+}
+
+void bench_flexsea_tools(void)
+{
+	char params[32];
+
+	snprintf(params, sizeof(params), "%u bytes", BENCH_TOOLS_BYTES);
+	bench_run("SPLIT_16", params, &bench_split_16, NULL, BENCH_TOOLS_BYTES);
+	bench_run("REBUILD_UINT16", params, &bench_rebuild_uint16, NULL,
+			BENCH_TOOLS_BYTES);
+	bench_run("SPLIT_32", params, &bench_split_32, NULL, BENCH_TOOLS_BYTES);
+	bench_run("REBUILD_UINT32", params, &bench_rebuild_uint32, NULL,
+			BENCH_TOOLS_BYTES);
+	bench_run("SPLIT_FLOAT", params, &bench_split_float, NULL,
+			BENCH_TOOLS_BYTES);
+	bench_run("REBUILD_FLOAT", params, &bench_rebuild_float, NULL,
+			BENCH_TOOLS_BYTES);
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
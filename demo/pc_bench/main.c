@@ -0,0 +1,431 @@
+#include "main.h"
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+//Round-trip benchmark: the host sends ReadWrite stress test commands
+//(FX_CMD_STRESS_TEST) to N devices and times every reply with a monotonic
+//clock. Devices are in-process (loopback: the stack on both sides, no I/O) or
+//serial ports and ptys, ex.: demo/pc_sim. Results are printed as JSON.
+//Replies are matched on their packet number (StressTestStructure.packet_number).
+//In-process devices echo the request's. The demo counts the replies it sends
+//instead: after a lost request its count lags behind, and we resync on it.
+//Usage: flexsea_bench [-n frames] [-r rate_hz] [-w window] [-t timeout_ms]
+//                     [-d devices] [-b baud] [-x request] [port ...]
+//  -n: requests per device (default 10000)
+//  -r: requests per second, per device. 0 (default): flat out.
+//  -w: requests in flight per device (default 1: ping-pong)
+//  -t: a request without a reply after this long is lost (default 100 ms)
+//  -d: number of in-process devices, when no port is given (default 1)
+//  -b: baud rate of the ports (default 115200, ignored by ptys)
+//  -x: don't send this request (0 to n-1), it should be reported as lost
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+static BenchDevice dev[BENCH_MAX_DEVICES];
+static uint8_t devices = 1;
+static BenchDevice *current = NULL;		//In-process device being served
+static uint32_t *rtt_ns = NULL;
+static uint32_t rtt_count = 0;
+static uint64_t timeout_ns = 100000000;
+static uint32_t drop = UINT32_MAX;		//Request that never makes it out
+
+//****************************************************************************
+// Private Function Prototype(s)
+//****************************************************************************
+
+static uint64_t bench_now_ns(void);
+static uint8_t bench_dev_rx(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
+		uint8_t *buf, uint8_t len);
+static uint8_t bench_dev_reply(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len);
+static uint8_t bench_dev_tx(uint8_t *bytes, uint16_t len);
+static uint8_t bench_send(BenchDevice *d, ReadWrite rw, uint8_t reset);
+static void bench_serve(BenchDevice *d);
+static void bench_read(BenchDevice *d);
+static void bench_decode(BenchDevice *d, uint64_t now);
+static void bench_reply(BenchDevice *d, int32_t seq, uint64_t now);
+static void bench_expire(BenchDevice *d, uint64_t now);
+static int bench_cmp(const void *a, const void *b);
+static double bench_percentile_us(double p);
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+int main(int argc, char *argv[])
+{
+	struct pollfd pfd[BENCH_MAX_DEVICES];
+	struct timespec ts;
+	uint32_t frames = 10000, rate_hz = 0, window = 1, baud = 115200;
+	uint32_t sent = 0, received = 0, lost = 0, out_of_order = 0;
+	uint64_t start = 0, now = 0, period_ns = 0, wait_ns = 0;
+	uint8_t loopback = 1, done = 0;
+	BenchDevice *d = NULL;
+	double duration = 0;
+	int opt = 0;
+
+	while((opt = getopt(argc, argv, "n:r:w:t:d:b:x:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n': frames = strtoul(optarg, NULL, 10); break;
+			case 'r': rate_hz = strtoul(optarg, NULL, 10); break;
+			case 'w': window = strtoul(optarg, NULL, 10); break;
+			case 't': timeout_ns = strtoull(optarg, NULL, 10) * 1000000; break;
+			case 'd': devices = strtoul(optarg, NULL, 10); break;
+			case 'b': baud = strtoul(optarg, NULL, 10); break;
+			case 'x': drop = strtoul(optarg, NULL, 10); break;
+			default:
+				fprintf(stderr, "Usage: %s [-n frames] [-r rate_hz] [-w window] "
+						"[-t timeout_ms] [-d devices] [-b baud] [-x request] "
+						"[port ...]\n", argv[0]);
+				return 1;
+		}
+	}
+	if(optind < argc)
+	{
+		loopback = 0;
+		devices = argc - optind;
+	}
+	if(!devices || (devices > BENCH_MAX_DEVICES) || !window ||
+			(window > BENCH_RING) || !frames)
+	{
+		fprintf(stderr, "Invalid parameters (1 to %u devices, window of 1 to "
+				"%u).\n", BENCH_MAX_DEVICES, BENCH_RING);
+		return 1;
+	}
+	period_ns = rate_hz ? (1000000000ULL / rate_hz) : 0;
+
+	//In-process devices run the stack's dispatch with these; the host side
+	//only decodes, it never calls a handler
+	fx_rx_cmd_init();
+	fx_register_rx_cmd_handler(BENCH_CMD_STRESS_TEST, &bench_dev_rx);
+	fx_register_tx_reply_builder(BENCH_CMD_STRESS_TEST, &bench_dev_reply);
+
+	for(uint8_t i = 0; i < devices; i++)
+	{
+		d = &dev[i];
+		circ_buf_init(&d->rx);
+		d->fd = -1;
+		if(loopback)
+		{
+			circ_buf_init(&d->port_cb);
+			fx_comm_port_init(&d->port, i, &d->port_cb, &bench_dev_tx);
+		}
+		else if(fx_serial_open(argv[optind + i], baud, &d->fd))
+		{
+			fprintf(stderr, "Could not open %s.\n", argv[optind + i]);
+			return 1;
+		}
+		pfd[i].fd = d->fd;
+		pfd[i].events = POLLIN;
+
+		//Reset the device's reply counter
+		bench_send(d, CmdWrite, 1);
+		bench_serve(d);
+	}
+
+	rtt_ns = malloc((size_t)devices * frames * sizeof(uint32_t));
+	if(rtt_ns == NULL)
+	{
+		return 1;
+	}
+
+	start = bench_now_ns();
+	for(uint8_t i = 0; i < devices; i++)
+	{
+		dev[i].next_tx_ns = start;
+	}
+
+	while(!done)
+	{
+		//Send what's due, as long as the window is open
+		now = bench_now_ns();
+		wait_ns = 1000000;
+		for(uint8_t i = 0; i < devices; i++)
+		{
+			d = &dev[i];
+			while((d->sent < frames) && ((d->sent - d->oldest) < window) &&
+					(now >= d->next_tx_ns))
+			{
+				d->t_sent[d->sent % BENCH_RING] = bench_now_ns();
+				if(d->sent != drop)
+				{
+					bench_send(d, CmdReadWrite, 0);
+				}
+				d->sent++;
+				d->next_tx_ns += period_ns;
+			}
+			if((d->sent < frames) && (d->next_tx_ns > now) &&
+					(d->next_tx_ns - now < wait_ns))
+			{
+				wait_ns = d->next_tx_ns - now;
+			}
+			bench_serve(d);
+		}
+
+		//Wait for the replies
+		if(!loopback)
+		{
+			ts.tv_sec = 0;
+			ts.tv_nsec = wait_ns;
+			ppoll(pfd, devices, &ts, NULL);
+			for(uint8_t i = 0; i < devices; i++)
+			{
+				if(pfd[i].revents & POLLIN)
+				{
+					bench_read(&dev[i]);
+				}
+			}
+		}
+
+		now = bench_now_ns();
+		done = 1;
+		for(uint8_t i = 0; i < devices; i++)
+		{
+			d = &dev[i];
+			bench_decode(d, now);
+			bench_expire(d, now);
+			if((d->sent < frames) || (d->oldest < d->sent))
+			{
+				done = 0;
+			}
+		}
+	}
+	duration = (now - start) / 1e9;
+
+	for(uint8_t i = 0; i < devices; i++)
+	{
+		sent += dev[i].sent;
+		received += dev[i].received;
+		lost += dev[i].lost;
+		out_of_order += dev[i].out_of_order;
+		fx_serial_close(dev[i].fd);
+	}
+	qsort(rtt_ns, rtt_count, sizeof(uint32_t), bench_cmp);
+
+	printf("{\n");
+	printf("  \"mode\": \"%s\",\n", loopback ? "loopback" : "serial");
+	printf("  \"devices\": %u,\n", devices);
+	printf("  \"rate_hz\": %u,\n", rate_hz);
+	printf("  \"window\": %u,\n", window);
+	printf("  \"sent\": %u,\n", sent);
+	printf("  \"received\": %u,\n", received);
+	printf("  \"lost\": %u,\n", lost);
+	printf("  \"out_of_order\": %u,\n", out_of_order);
+	printf("  \"duration_s\": %.6f,\n", duration);
+	printf("  \"throughput_fps\": %.1f,\n", duration > 0 ? received / duration : 0);
+	printf("  \"rtt_us\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+			"\"p99.9\": %.3f, \"max\": %.3f}\n", bench_percentile_us(0.5),
+			bench_percentile_us(0.9), bench_percentile_us(0.99),
+			bench_percentile_us(0.999), bench_percentile_us(1.0));
+	printf("}\n");
+
+	free(rtt_ns);
+	return 0;
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+static uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//In-process device: like the demo's fx_rx_cmd_stress_test(), but the reply
+//answers with the request's packet number instead of a count
+static uint8_t bench_dev_rx(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
+		uint8_t *buf, uint8_t len)
+{
+	uint16_t index = CMD_OVERHEAD;
+
+	if(len >= CMD_OVERHEAD + BENCH_PAYLOAD_BYTES)
+	{
+		current->seq = (int32_t)REBUILD_UINT32(buf, &index);
+	}
+
+	return FX_SUCCESS;
+}
+
+//[PACKET NUMBER (int32)][RAMP (int16)][RESET]
+static uint8_t bench_dev_reply(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len)
+{
+	uint16_t index = 0;
+
+	SPLIT_32((uint32_t)current->seq, buf, &index);
+	SPLIT_16(0, buf, &index);
+	buf[index++] = 0;
+	*len = index;
+
+	return FX_SUCCESS;
+}
+
+//In-process device -> host
+static uint8_t bench_dev_tx(uint8_t *bytes, uint16_t len)
+{
+	return fx_feed(&current->rx, bytes, len) ? FX_PROBLEM : FX_SUCCESS;
+}
+
+static uint8_t bench_send(BenchDevice *d, ReadWrite rw, uint8_t reset)
+{
+	uint8_t payload[BENCH_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint16_t index = 0;
+
+	SPLIT_32(d->sent, payload, &index);
+	payload[6] = reset;
+	if(fx_create_bytestream_from_cmd(BENCH_CMD_STRESS_TEST, rw, Nack, payload,
+			BENCH_PAYLOAD_BYTES, bytestream, &bytestream_len))
+	{
+		return FX_PROBLEM;
+	}
+
+	if(d->fd >= 0)
+	{
+		return fx_serial_write(d->fd, bytestream, bytestream_len);
+	}
+	return fx_feed(&d->port_cb, bytestream, bytestream_len) ? FX_PROBLEM :
+			FX_SUCCESS;
+}
+
+//Let an in-process device receive and answer
+static void bench_serve(BenchDevice *d)
+{
+	uint32_t count = 0;
+	uint16_t length = 0;
+
+	if(d->fd >= 0)
+	{
+		return;
+	}
+
+	//Reply after every frame: a window larger than the reply queue
+	//(FX_REPLYQ_DEPTH) would overflow it, and we'd count drops as losses
+	current = d;
+	do
+	{
+		count = d->port.rx_last.count;
+		length = d->port.cb->length;
+		fx_receive(&d->port);
+		fx_comm_process_replies(&d->port);
+		while(!fx_comm_process_tx_queue(&d->port));
+	}while((d->port.rx_last.count != count) || (d->port.cb->length != length));
+}
+
+static void bench_read(BenchDevice *d)
+{
+	uint8_t chunk[FX_SERIAL_READ_CHUNK];
+	uint16_t room = 0;
+	ssize_t n = 0;
+
+	do
+	{
+		room = CIRC_BUF_SIZE - d->rx.length;
+		if(room > FX_SERIAL_READ_CHUNK)
+		{
+			room = FX_SERIAL_READ_CHUNK;
+		}
+		n = room ? read(d->fd, chunk, room) : 0;
+		if(n > 0)
+		{
+			fx_feed(&d->rx, chunk, n);
+		}
+	}while(n > 0);
+}
+
+static void bench_decode(BenchDevice *d, uint64_t now)
+{
+	uint8_t cmd_6bits = 0, buf[MAX_ENCODED_PAYLOAD_BYTES] = {0}, buf_len = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+	uint16_t length = 0, index = CMD_OVERHEAD;
+
+	while(d->rx.length > MIN_OVERHEAD)
+	{
+		length = d->rx.length;
+		if(!fx_get_cmd_handler_from_bytestream(&d->rx, &cmd_6bits, &rw, &ack,
+				buf, &buf_len))
+		{
+			if((cmd_6bits == BENCH_CMD_STRESS_TEST) &&
+					(buf_len >= CMD_OVERHEAD + 4))
+			{
+				index = CMD_OVERHEAD;
+				bench_reply(d, (int32_t)REBUILD_UINT32(buf, &index), now);
+			}
+			fx_cleanup(&d->rx);
+		}
+		else if(d->rx.length == length)
+		{
+			break;	//Incomplete frame
+		}
+	}
+}
+
+//Reply 'seq' received at 'now'. Requests before it that are still waiting
+//are lost; replies to requests we already gave up on are out of order.
+static void bench_reply(BenchDevice *d, int32_t seq, uint64_t now)
+{
+	//Serial devices count their replies: once a request is lost, reply n
+	//answers request n + 1. Resync on the requests still waiting.
+	seq += d->offset;
+	if((d->fd >= 0) && (d->oldest < d->sent))
+	{
+		if((seq < 0) || ((uint32_t)seq < d->oldest))
+		{
+			d->offset += (int32_t)d->oldest - seq;
+			seq = d->oldest;
+		}
+		else if((uint32_t)seq >= d->sent)
+		{
+			d->offset -= seq - (int32_t)(d->sent - 1);
+			seq = d->sent - 1;
+		}
+	}
+
+	if((seq < 0) || ((uint32_t)seq < d->oldest) || ((uint32_t)seq >= d->sent))
+	{
+		d->out_of_order++;
+		return;
+	}
+
+	d->lost += seq - d->oldest;
+	d->oldest = seq + 1;
+	d->received++;
+	rtt_ns[rtt_count++] = (uint32_t)(now - d->t_sent[seq % BENCH_RING]);
+}
+
+static void bench_expire(BenchDevice *d, uint64_t now)
+{
+	while((d->oldest < d->sent) &&
+			(now - d->t_sent[d->oldest % BENCH_RING] > timeout_ns))
+	{
+		d->lost++;
+		d->oldest++;
+	}
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+//Nearest rank, on the sorted RTTs
+static double bench_percentile_us(double p)
+{
+	if(!rtt_count)
+	{
+		return 0;
+	}
+
+	return rtt_ns[(uint32_t)(p * (rtt_count - 1) + 0.5)] / 1000.0;
+}
@@ -0,0 +1,56 @@
+#ifndef INC_MAIN_H_
+#define INC_MAIN_H_
+
+#define _GNU_SOURCE
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <flexsea.h>
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+#define BENCH_CMD_STRESS_TEST	3		//FX_CMD_STRESS_TEST, demo/stm32_c/Core/Inc/fx_def.h
+#define BENCH_MAX_DEVICES		16
+#define BENCH_RING				1024	//Send times kept per device (max. window)
+#define BENCH_PAYLOAD_BYTES		7		//StressTestStructure
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+typedef struct BenchDevice
+{
+	int fd;						//pty / serial port, -1 for an in-process device
+	circ_buf_t rx;				//Host side: replies from this device
+	//In-process device (loopback)
+	CommPort port;
+	circ_buf_t port_cb;
+	int32_t seq;				//PACKET NUMBER of the request being answered
+	//Requests and replies
+	int32_t offset;				//Serial: our request number - the device's count
+	uint32_t sent;
+	uint32_t oldest;			//Oldest request still waiting for its reply
+	uint32_t received;
+	uint32_t lost;
+	uint32_t out_of_order;
+	uint64_t next_tx_ns;
+	uint64_t t_sent[BENCH_RING];
+}BenchDevice;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#endif // INC_MAIN_H_
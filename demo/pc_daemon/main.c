@@ -0,0 +1,226 @@
+#include "main.h"
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+//Host daemon: owns the serial ports, so that several processes (a controller,
+//a logger, a GUI) can use the same devices. Every frame it decodes is
+//published in shared memory (flexsea_shm), in the ring of its port and
+//command; clients map it and read them, no socket or pipe in between. Frames
+//the clients push are written to their port by a second thread.
+//The daemon doesn't run any handler and doesn't answer anything: it's a
+//transparent hub between the devices and the clients.
+//Usage: flexsea_daemon [-s name] [-b baud] port [port ...]
+//  -s: shared memory object (default /flexsea, see shm_open())
+//  -b: baud rate of the ports (default 115200, ignored by ptys)
+//Port n in the shared memory is the nth port on the command line.
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+static DaemonPort port[FX_SHM_MAX_PORTS];
+static uint8_t ports = 0;
+static FxShm shm;
+static volatile sig_atomic_t running = 1;
+
+//****************************************************************************
+// Private Function Prototype(s)
+//****************************************************************************
+
+static void daemon_stop(int sig);
+static void *daemon_tx(void *arg);
+static void daemon_read(DaemonPort *p);
+static void daemon_decode(uint8_t index);
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+int main(int argc, char *argv[])
+{
+	struct pollfd pfd[FX_SHM_MAX_PORTS];
+	struct timespec ts = {.tv_sec = 0, .tv_nsec = DAEMON_POLL_US * 1000};
+	struct sigaction sa;
+	const char *name = DAEMON_SHM_NAME;
+	uint32_t baud = 115200;
+	pthread_t tx_thread;
+	int opt = 0;
+
+	while((opt = getopt(argc, argv, "s:b:")) != -1)
+	{
+		switch(opt)
+		{
+			case 's': name = optarg; break;
+			case 'b': baud = strtoul(optarg, NULL, 10); break;
+			default:
+				fprintf(stderr, "Usage: %s [-s name] [-b baud] port [port ...]\n",
+						argv[0]);
+				return 1;
+		}
+	}
+	if((optind >= argc) || (argc - optind > FX_SHM_MAX_PORTS))
+	{
+		fprintf(stderr, "Give 1 to %u ports.\n", FX_SHM_MAX_PORTS);
+		return 1;
+	}
+	ports = argc - optind;
+
+	for(uint8_t i = 0; i < ports; i++)
+	{
+		port[i].path = argv[optind + i];
+		circ_buf_init(&port[i].rx);
+		if(fx_serial_open(port[i].path, baud, &port[i].fd))
+		{
+			fprintf(stderr, "Could not open %s.\n", port[i].path);
+			return 1;
+		}
+		pfd[i].fd = port[i].fd;
+		pfd[i].events = POLLIN;
+	}
+
+	if(fx_shm_create(&shm, name, ports))
+	{
+		fprintf(stderr, "Could not create %s (is another daemon serving it?)\n",
+				name);
+		return 1;
+	}
+
+	//No SA_RESTART: ppoll() returns, and we exit cleanly
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = &daemon_stop;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if(pthread_create(&tx_thread, NULL, &daemon_tx, NULL))
+	{
+		fx_shm_destroy(&shm);
+		return 1;
+	}
+
+	printf("Serving %u port(s) on %s\n", ports, name);
+	fflush(stdout);
+
+	while(running)
+	{
+		if(ppoll(pfd, ports, &ts, NULL) <= 0)
+		{
+			continue;
+		}
+
+		for(uint8_t i = 0; i < ports; i++)
+		{
+			if(pfd[i].revents & POLLIN)
+			{
+				daemon_read(&port[i]);
+				daemon_decode(i);
+			}
+			else if(pfd[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+			{
+				fprintf(stderr, "%s was closed.\n", port[i].path);
+				running = 0;
+			}
+		}
+	}
+
+	pthread_join(tx_thread, NULL);
+	fx_shm_destroy(&shm);
+
+	for(uint8_t i = 0; i < ports; i++)
+	{
+		printf("%s: %u frames received, %u sent, %u write errors\n",
+				port[i].path, port[i].frames_rx, port[i].frames_tx,
+				port[i].tx_errors);
+		fx_serial_close(port[i].fd);
+	}
+
+	return 0;
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+static void daemon_stop(int sig)
+{
+	running = 0;
+}
+
+//Clients -> devices. Only this thread writes to the ports.
+static void *daemon_tx(void *arg)
+{
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES] = {0}, len = 0, index = 0;
+
+	while(running)
+	{
+		if(fx_shm_tx_wait(&shm, DAEMON_POLL_US))
+		{
+			continue;
+		}
+
+		while(!fx_shm_tx_pop(&shm, &index, frame, &len))
+		{
+			if(fx_serial_write(port[index].fd, frame, len))
+			{
+				port[index].tx_errors++;
+			}
+			else
+			{
+				port[index].frames_tx++;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void daemon_read(DaemonPort *p)
+{
+	uint8_t chunk[FX_SERIAL_READ_CHUNK];
+	uint16_t room = 0;
+	ssize_t n = 0;
+
+	do
+	{
+		room = CIRC_BUF_SIZE - p->rx.length;
+		if(room > FX_SERIAL_READ_CHUNK)
+		{
+			room = FX_SERIAL_READ_CHUNK;
+		}
+		n = room ? read(p->fd, chunk, room) : 0;
+		if(n > 0)
+		{
+			fx_feed(&p->rx, chunk, n);
+		}
+	}while(n > 0);
+}
+
+//Devices -> clients: every complete frame, as decoded
+static void daemon_decode(uint8_t index)
+{
+	DaemonPort *p = &port[index];
+	uint8_t cmd_6bits = 0, buf[MAX_ENCODED_PAYLOAD_BYTES] = {0}, buf_len = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+	uint16_t length = 0;
+
+	while(p->rx.length > MIN_OVERHEAD)
+	{
+		length = p->rx.length;
+		if(!fx_get_cmd_handler_from_bytestream(&p->rx, &cmd_6bits, &rw, &ack,
+				buf, &buf_len))
+		{
+			if(!fx_shm_publish(&shm, index, buf, buf_len))
+			{
+				p->frames_rx++;
+			}
+			fx_cleanup(&p->rx);
+		}
+		else if(p->rx.length == length)
+		{
+			break;	//Incomplete frame
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef INC_MAIN_H_
+#define INC_MAIN_H_
+
+#define _GNU_SOURCE
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <flexsea.h>
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+#define DAEMON_SHM_NAME			"/flexsea"
+#define DAEMON_POLL_US			100000	//Checks for a stop request this often
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+typedef struct DaemonPort
+{
+	const char *path;
+	int fd;
+	circ_buf_t rx;
+	uint32_t frames_rx;			//Published
+	uint32_t frames_tx;			//Written for the clients (TX thread)
+	uint32_t tx_errors;
+}DaemonPort;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#endif // INC_MAIN_H_
@@ -24,7 +24,13 @@ else:
     dll_filename = '../..//projects/eclipse_pc/DynamicLib/libflexsea-v2.so'
     com_port = '/dev/ttyAMA0'  # Default, can be over-ridden by CLI argument
 
+if len(sys.argv) > 1:
+    com_port = sys.argv[1]  # Ex.: the device simulator's link (demo/pc_sim)
+
 new_tx_delay_ms = 40
+CMD_DEMO_DELTA = 10  # DemoStructure, delta-encoded (see fx_def.h)
+DELTA_STREAM_PERIOD_MS = 10
+DELTA_STREAM_FRAMES = 200
 
 
 # C-style data structure
@@ -80,8 +86,7 @@ def fx_rx_cmd_handler_2(cmd_6bits, rw, ack, buf):
     # Re-create the data that was sent. It does not matter if it was sent as a struct or manually; same byte stream.
     tx_data = FxDemoStruct(var0_int8=-1, var1_uint32=123456, var2_uint8=150, var3_int32=-1234567, var4_int8=-125,
                            var5_uint16=4567, var6_uint8=123, var7_int16=-4567, var8_float=12.37)
-    rx_data = FxDemoStruct()
-    ctypes.memmove(pointer(rx_data), buf[flexsea_python.CMD_OVERHEAD:], sizeof(rx_data))
+    rx_data = FxDemoStruct.from_buffer_copy(buf, flexsea_python.CMD_OVERHEAD)
     if identical_ctype_structs(tx_data, rx_data):
         print('All decoded values match what our demo code is sending! Successful PC Python <> Embedded C interface, '
               'Structure decoding mode.\n')
@@ -90,6 +95,28 @@ def fx_rx_cmd_handler_2(cmd_6bits, rw, ack, buf):
               'PC Python <> Embedded C in Structure mode...\n')
 
 
+# Delta-encoded demo structure: keyframes, then only the fields that changed. The decoder keeps the keyframes it
+# received, we send its ack back so the device knows which one it can refer to.
+demo_delta = DeltaDecoder.from_structure(FxDemoStruct)
+demo_delta_stats = {'frames': 0, 'bytes': 0, 'errors': 0}
+
+
+def fx_rx_cmd_handler_demo_delta(cmd_6bits, rw, ack, buf):
+    data = bytes(buf[flexsea_python.CMD_OVERHEAD:])
+    obj = demo_delta.decode(data)
+    if obj is None:
+        # Refers to a keyframe we didn't receive: the next keyframe fixes it
+        demo_delta_stats['errors'] += 1
+        return
+
+    demo_delta_stats['frames'] += 1
+    demo_delta_stats['bytes'] += len(data)
+    tx_data = FxDemoStruct(var0_int8=-1, var1_uint32=123456, var2_uint8=150, var3_int32=-1234567, var4_int8=-125,
+                           var5_uint16=4567, var6_uint8=123, var7_int16=-4567, var8_float=12.37)
+    if not identical_ctype_structs(tx_data, FxDemoStruct.from_buffer_copy(obj)):
+        demo_delta_stats['errors'] += 1
+
+
 # We create and serialize the same payload the embedded system sends (see fx_transmit.c)
 def gen_test_code_payload(mode):
     # Here we show two ways of packing data into a byte string
@@ -139,7 +166,7 @@ def flexsea_demo_local_loopback():
     if not ret_val:
         print("We successfully created a bytestream.")
         print(f'This will be a HEADER: {bytestream[0]}')
-        print(f'This is our input payload: {bytestream[3:10]}')
+        print(f'This is our input payload: {bytes(bytestream[3:10])}')
     else:
         print("We did not successfully create a bytestream. Quit.")
         exit()
@@ -219,12 +246,9 @@ def flexsea_demo_serial():
             bytes_to_read = fx.serial.bytes_available()
             if bytes_to_read > 0:
                 print(f'Bytes to read: {bytes_to_read}.')
-                for i in range(bytes_to_read):
-                    new_rx_byte = fx.serial.read_byte()
-                    ret_val = fx.write_to_circular_buffer(new_rx_byte[0], 1)
-                    if ret_val:
-                        print("circ_buf_write_byte() problem!")
-                        exit()
+                if fx.feed(fx.serial.read_bytes(bytes_to_read)) < bytes_to_read:
+                    print("fx_feed() problem!")
+                    exit()
 
             # At this point received commands are in the circular buffer. Can we decode them?
             ret_val, cmd_6bits_out, rw_out, ack_out, buf, buf_len = fx.get_cmd_handler_from_bytestream()
@@ -245,8 +269,50 @@ def flexsea_demo_serial():
         fx.serial.close()
 
 
+# Delta stream demo: the peripheral streams its demo structure, delta-encoded. Unchanged fields aren't sent.
+def flexsea_demo_delta_stream():
+
+    print('Demo code - Python project with FlexSEA v2.0 DLL')
+    print('Delta-encoded stream - Connect a Nucleo (or demo/pc_sim) first!\n')
+
+    fx = FlexSEAPython(dll_filename, com_port_name=com_port)
+    if not fx.serial.valid_port():
+        print("We did not successfully open a serial port. Quit.")
+        exit()
+
+    fx.register_cmd_handler(CMD_DEMO_DELTA, fx_rx_cmd_handler_demo_delta)
+    fx.serial.reset_buffers()
+    fx.subscribe(CMD_DEMO_DELTA, DELTA_STREAM_PERIOD_MS)
+
+    last_ack = None
+    timeout = time.time() + 5 + DELTA_STREAM_FRAMES * DELTA_STREAM_PERIOD_MS / 1000
+    while demo_delta_stats['frames'] < DELTA_STREAM_FRAMES and time.time() < timeout:
+        fx.grab_new_bytes()
+        fx.receive()
+        # New keyframe: acknowledge it, the next deltas will refer to it
+        if demo_delta.ack() is not None and demo_delta.ack() != last_ack:
+            last_ack = demo_delta.ack()
+            ret_val, bytestream, bytestream_len = fx.create_bytestream_from_cmd(cmd=CMD_DEMO_DELTA, rw="CmdWrite",
+                                                                                ack="Nack",
+                                                                                payload_string=bytes([last_ack]))
+            if not ret_val:
+                fx.serial.write(bytestream, bytestream_len)
+        time.sleep(0.001)
+
+    fx.unsubscribe(CMD_DEMO_DELTA)
+    frames = demo_delta_stats['frames']
+    full = frames * sizeof(FxDemoStruct)
+    print(f'Received {frames} structures, {demo_delta_stats["errors"]} errors.')
+    if frames:
+        print(f'Payload: {demo_delta_stats["bytes"]} bytes instead of {full} '
+              f'({100 * demo_delta_stats["bytes"] / full:.0f}%).\n')
+    fx.serial.close()
+
+
 if __name__ == "__main__":
     # Available demos, select one or more:
     flexsea_demo_local_loopback()
     print('\n=-=-=-=-=\n')
+    flexsea_demo_delta_stream()
+    print('\n=-=-=-=-=\n')
     flexsea_demo_serial()
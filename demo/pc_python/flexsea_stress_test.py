@@ -27,6 +27,9 @@ else:
     dll_filename = '../../projects/eclipse_pc/DynamicLib/libflexsea-v2.so'
     com_port = '/dev/ttyAMA0'  # Default, can be over-ridden by CLI argument
 
+if len(sys.argv) > 1:
+    com_port = sys.argv[1]  # Ex.: the device simulator's link (demo/pc_sim)
+
 new_tx_delay_ms = 20  # 10 ms = 100 Hz
 
 FX_CMD_STRESS_TEST_PERIPH_1 = 3
@@ -84,8 +87,7 @@ class FxStressTestStruct(Structure):
 # Custom command handler used by the stress test code - PC side
 def fx_rx_cmd_handler_3_pc(cmd_6bits, rw, ack, buf):
     # print(f'PC RX cmd handler()')
-    rx_data = FxStressTestStruct()
-    ctypes.memmove(pointer(rx_data), buf[flexsea_python.CMD_OVERHEAD:], sizeof(rx_data))
+    rx_data = FxStressTestStruct.from_buffer_copy(buf, flexsea_python.CMD_OVERHEAD)
     global stress_test_data
     global pc_packet_number, pc_ramp_value, tx_timestamp, start_time
 
@@ -98,8 +100,7 @@ def fx_rx_cmd_handler_3_pc(cmd_6bits, rw, ack, buf):
 # Custom command handler used by the stress test code - DUT side
 def fx_rx_cmd_handler_3_dut(cmd_6bits, rw, ack, buf):
     # print(f'DUT RX cmd handler()')
-    rx_data = FxStressTestStruct()
-    ctypes.memmove(pointer(rx_data), buf[flexsea_python.CMD_OVERHEAD:], sizeof(rx_data))
+    rx_data = FxStressTestStruct.from_buffer_copy(buf, flexsea_python.CMD_OVERHEAD)
     global dut_packet_number, dut_ramp_value
     dut_packet_number, dut_ramp_value = counter_and_ramp(dut_packet_number, dut_ramp_value)
     # Ready to TX
@@ -253,6 +254,12 @@ def flexsea_stress_test_serial():
     fx.serial.write(bytestream, bytestream_len)
     time.sleep(0.01)
 
+    # Clock synchronisation. The round trip measured here excludes Python scheduling on our side and processing
+    # on the device's side.
+    round_trip = fx.time_sync()
+    if round_trip is not None:
+        print(f'Time sync: best round trip {round_trip * 1e3:0.3f} ms (one way ~{round_trip * 5e2:0.3f} ms)')
+
     for i in range(STRESS_TEST_CYCLES):
 
         # PC generates bytestream:
@@ -277,13 +284,10 @@ def flexsea_stress_test_serial():
                 # Feed any received bytes into the circular buffer
                 bytes_to_read = fx.serial.bytes_available()
                 if bytes_to_read > 0:
-                    for i in range(bytes_to_read):
-                        new_rx_byte = fx.serial.read_byte()
-                        ret_val = fx.write_to_circular_buffer(new_rx_byte[0], 1)
-                        bytes_received = bytes_received + 1
-                        if ret_val:
-                            print("circ_buf_write_byte() problem!")
-                            exit()
+                    bytes_received = bytes_received + bytes_to_read
+                    if fx.feed(fx.serial.read_bytes(bytes_to_read)) < bytes_to_read:
+                        print("fx_feed() problem!")
+                        exit()
 
                 # Final step, PC reception
                 fx.receive()
@@ -302,13 +306,10 @@ def flexsea_stress_test_serial():
         # Feed any received bytes into the circular buffer
         bytes_to_read = fx.serial.bytes_available()
         if bytes_to_read > 0:
-            for i in range(bytes_to_read):
-                new_rx_byte = fx.serial.read_byte()
-                ret_val = fx.write_to_circular_buffer(new_rx_byte[0], 1)
-                bytes_received = bytes_received + 1
-                if ret_val:
-                    print("circ_buf_write_byte() problem!")
-                    exit()
+            bytes_received = bytes_received + bytes_to_read
+            if fx.feed(fx.serial.read_bytes(bytes_to_read)) < bytes_to_read:
+                print("fx_feed() problem!")
+                exit()
 
         # Final step, PC reception
         fx.receive()
@@ -319,6 +320,8 @@ def flexsea_stress_test_serial():
     test_time_s = (end_time - start_time) / 1000
     print(f'Test time: {test_time_s:0.2f} s')
     print(f'Bytes received: {bytes_received} ({bytes_received/len(stress_test_data)} / packet)')
+    if fx.time_sync() is not None:
+        print(f'Device clock drift: {fx.clock.drift_ppm:0.1f} ppm')
 
     plot_results()
     save_csv_results()
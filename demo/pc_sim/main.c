@@ -0,0 +1,342 @@
+#include "main.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+//FlexSEA device simulator: the STM32 demo's handlers and reply builders
+//(fx_receive.c, fx_transmit.c) running on a Linux pseudo-terminal. Clients
+//(flexsea_stress_test.py, fx_serial_open(), etc.) open the pty like they
+//would open the board's serial port. See README.md for the build command.
+//Usage: flexsea_sim [-b baud] [-d delay_us] [-l link]
+//  -b: UART emulation. Bytes cross the "wire" one at a time, 10 bits per byte
+//      (8N1), in both directions. 0 (default): as fast as the pty goes.
+//  -d: processing delay. Every frame received keeps the device busy (no
+//      reception, no transmission) for this long.
+//  -l: symlink to the pty (ex.: /tmp/flexsea_sim), its name changes every run
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+//One direction of the emulated UART
+typedef struct SimLine
+{
+	circ_buf_t wire;			//Bytes sent, not delivered yet
+	uint8_t busy;
+	uint64_t next_ns;			//Delivery time of the next byte
+}SimLine;
+
+static int master_fd = -1;
+static uint64_t byte_ns = 0;	//0: no baud rate emulation
+static uint64_t delay_ns = 0;
+static uint64_t start_ns = 0;
+static volatile sig_atomic_t running = 1;
+static circ_buf_t cb;
+static CommPort sim_port;
+static SimLine rx_line, tx_line;
+
+//****************************************************************************
+// Private Function Prototype(s)
+//****************************************************************************
+
+static uint64_t sim_now_ns(void);
+static void sim_stop(int sig);
+static uint8_t sim_tx(uint8_t *bytes, uint16_t len);
+static uint16_t sim_line_budget(SimLine *line, uint64_t now, uint16_t waiting);
+static void sim_receive(uint64_t now);
+static void sim_transmit(uint64_t now);
+static void sim_sleep(uint64_t now, uint64_t busy_until);
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+int main(int argc, char *argv[])
+{
+	char slave[64] = {0};
+	char *link_path = NULL;
+	uint32_t baud = 0, delay_us = 0, count = 0;
+	uint64_t now = 0, busy_until = 0;
+	int slave_fd = -1, opt = 0;
+
+	while((opt = getopt(argc, argv, "b:d:l:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'b':
+				baud = strtoul(optarg, NULL, 10);
+				break;
+			case 'd':
+				delay_us = strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				link_path = optarg;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-b baud] [-d delay_us] [-l link]\n",
+						argv[0]);
+				return 1;
+		}
+	}
+	byte_ns = baud ? (10000000000ULL / baud) : 0;
+	delay_ns = (uint64_t)delay_us * 1000;
+
+	//We keep the slave side open too: the master doesn't see a hang-up
+	//when a client disconnects
+	if(fx_serial_open_pty(&master_fd, slave, sizeof(slave)) ||
+			fx_serial_open(slave, 0, &slave_fd))
+	{
+		fprintf(stderr, "Could not create a pseudo-terminal.\n");
+		return 1;
+	}
+	if(link_path)
+	{
+		unlink(link_path);
+		if(symlink(slave, link_path))
+		{
+			fprintf(stderr, "Could not create %s.\n", link_path);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, sim_stop);
+	signal(SIGTERM, sim_stop);
+	start_ns = sim_now_ns();
+
+	//Same setup as the board: stack, demo handlers, one port. The emulated
+	//UART transmits in the background, like HAL_UART_Transmit_IT().
+	fx_rx_cmd_init();
+	fx_init_stress_test();
+	circ_buf_init(&cb);
+	circ_buf_init(&rx_line.wire);
+	circ_buf_init(&tx_line.wire);
+	fx_comm_port_init(&sim_port, 0, &cb, &sim_tx);
+	sim_port.txq.async = (byte_ns > 0);
+
+	printf("FlexSEA device simulator on %s%s%s (%u baud%s, %u us processing "
+			"delay)\n", link_path ? link_path : slave, link_path ? " -> " : "",
+			link_path ? slave : "", baud, baud ? "" : ": no emulation", delay_us);
+	fflush(stdout);
+
+	while(running)
+	{
+		now = sim_now_ns();
+		sim_receive(now);
+
+		//Board main loop, unless we are still busy with the last frame
+		if(now >= busy_until)
+		{
+			count = sim_port.rx_last.count;
+			fx_receive(&sim_port);
+			if(sim_port.rx_last.count != count)
+			{
+				busy_until = now + delay_ns;
+			}
+		}
+		if(now >= busy_until)
+		{
+			fx_comm_process_schedule(&sim_port);
+			fx_transmit(&sim_port);
+		}
+
+		sim_transmit(now);
+
+		//Back to back frames are decoded without sleeping
+		if((sim_port.rx_last.count == count) || (busy_until > now))
+		{
+			sim_sleep(now, busy_until);
+		}
+	}
+
+	printf("\nFrames decoded: %u, frames sent: %u\n", sim_port.rx_last.count,
+			sim_port.stats.frames_sent);
+	if(link_path)
+	{
+		unlink(link_path);
+	}
+	fx_serial_close(slave_fd);
+	fx_serial_close(master_fd);
+	return 0;
+}
+
+//Board clock: ms since start (streams)
+uint32_t HAL_GetTick(void)
+{
+	return (uint32_t)((sim_now_ns() - start_ns) / 1000000);
+}
+
+//Stack timestamps: us since start
+uint32_t fx_timestamp(void)
+{
+	return (uint32_t)((sim_now_ns() - start_ns) / 1000);
+}
+
+uint32_t fx_timestamp_hz(void)
+{
+	return 1000000;
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+static uint64_t sim_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sim_stop(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+//CommPort TX function. With UART emulation the frame goes on the wire, and
+//fx_comm_tx_done() is called once its last byte is delivered.
+static uint8_t sim_tx(uint8_t *bytes, uint16_t len)
+{
+	if(!byte_ns)
+	{
+		return fx_serial_write(master_fd, bytes, len);
+	}
+
+	return circ_buf_write(&tx_line.wire, bytes, len) ? FX_PROBLEM : FX_SUCCESS;
+}
+
+//How many of the 'waiting' bytes have crossed the wire by 'now'? The first
+//byte sent on an idle line takes one byte time.
+static uint16_t sim_line_budget(SimLine *line, uint64_t now, uint16_t waiting)
+{
+	uint16_t n = 0;
+
+	if(!waiting)
+	{
+		line->busy = 0;
+		return 0;
+	}
+	if(!byte_ns)
+	{
+		return waiting;
+	}
+
+	if(!line->busy)
+	{
+		line->busy = 1;
+		line->next_ns = now + byte_ns;
+	}
+	while((n < waiting) && (line->next_ns <= now))
+	{
+		n++;
+		line->next_ns += byte_ns;
+	}
+
+	return n;
+}
+
+//pty -> wire -> circular buffer
+static void sim_receive(uint64_t now)
+{
+	uint8_t chunk[SIM_READ_CHUNK];
+	circ_buf_t *in = byte_ns ? &rx_line.wire : &cb;
+	uint16_t room = CIRC_BUF_SIZE - in->length, n = 0;
+	ssize_t ret = 0;
+
+	if(room > SIM_READ_CHUNK)
+	{
+		room = SIM_READ_CHUNK;
+	}
+	ret = (room > 0) ? read(master_fd, chunk, room) : 0;
+	if(ret > 0)
+	{
+		circ_buf_write(in, chunk, ret);
+		if(!byte_ns)
+		{
+			sim_port.stats.bytes_received += ret;
+			return;
+		}
+	}
+	if(!byte_ns)
+	{
+		return;
+	}
+
+	//What made it across the wire
+	n = sim_line_budget(&rx_line, now, SIM_MIN(rx_line.wire.length,
+			SIM_READ_CHUNK));
+	for(uint16_t i = 0; i < n; i++)
+	{
+		circ_buf_read_byte(&rx_line.wire, &chunk[i]);
+	}
+	sim_port.stats.rx_overflows += circ_buf_write(&cb, chunk, n);
+	sim_port.stats.bytes_received += n;
+}
+
+//Wire -> pty
+static void sim_transmit(uint64_t now)
+{
+	uint8_t chunk[CIRC_BUF_SIZE];
+	uint16_t n = sim_line_budget(&tx_line, now, tx_line.wire.length);
+
+	if(!n)
+	{
+		return;
+	}
+
+	for(uint16_t i = 0; i < n; i++)
+	{
+		circ_buf_read_byte(&tx_line.wire, &chunk[i]);
+	}
+	fx_serial_write(master_fd, chunk, n);
+
+	//Last byte of the frame is out
+	if(!tx_line.wire.length)
+	{
+		fx_comm_tx_done(&sim_port);
+	}
+}
+
+//Sleep until the pty has data, or until the next byte, tick or end of the
+//processing delay. Doesn't sleep if there is something to send.
+static void sim_sleep(uint64_t now, uint64_t busy_until)
+{
+	struct pollfd pfd = {.fd = master_fd, .events = POLLIN};
+	circ_buf_t *in = byte_ns ? &rx_line.wire : &cb;
+	uint64_t wait_ns = SIM_TICK_NS;
+	struct timespec ts;
+
+	//Replies or frames the main loop can send right away: no sleep. While a
+	//frame is on the wire, its next byte is the next event.
+	if((now >= busy_until) && !sim_port.txq.busy &&
+			(fx_reply_queue_length(&sim_port) || fx_tx_queue_pending(&sim_port)))
+	{
+		return;
+	}
+
+	if(rx_line.busy)
+	{
+		wait_ns = SIM_MIN(wait_ns, SIM_UNTIL(rx_line.next_ns, now));
+	}
+	if(tx_line.busy)
+	{
+		wait_ns = SIM_MIN(wait_ns, SIM_UNTIL(tx_line.next_ns, now));
+	}
+	if(busy_until > now)
+	{
+		wait_ns = SIM_MIN(wait_ns, busy_until - now);
+	}
+
+	//No room: leave the bytes in the kernel
+	if(in->length >= CIRC_BUF_SIZE)
+	{
+		pfd.events = 0;
+	}
+
+	ts.tv_sec = wait_ns / 1000000000;
+	ts.tv_nsec = wait_ns % 1000000000;
+	ppoll(&pfd, 1, &ts, NULL);
+}
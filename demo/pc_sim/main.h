@@ -0,0 +1,41 @@
+//Stands in for the STM32 demo's main.h: the demo's fx_receive.c and
+//fx_transmit.c include "main.h" from their own folder, so this file is forced
+//in first (gcc -include) and uses the same include guard.
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#define _GNU_SOURCE		//ppoll(), before the first system header
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <flexsea.h>
+#include <fx_def.h>
+#include <fx_receive.h>
+#include <fx_transmit.h>
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+#define SIM_READ_CHUNK		256			//Bytes per read() from the pty
+#define SIM_TICK_NS			1000000		//Longest sleep: HAL_GetTick() resolution
+#define SIM_MIN(a, b)		(((a) < (b)) ? (a) : (b))
+#define SIM_UNTIL(t, now)	(((t) > (now)) ? ((t) - (now)) : 0)
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+uint32_t HAL_GetTick(void);
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#endif // __MAIN_H
@@ -14,12 +14,15 @@
 //Define your command codes here. Start your custom commands at 10 to ease
 //stack upgrades over time.
 
-//Stack commands:
-#define FX_CMD_WHO_AM_I				0
-#define FX_CMD_ACK					1
+//Stack commands (FX_CMD_WHO_AM_I, FX_CMD_ACK, FX_CMD_STREAM, etc.) are
+//defined in flexsea_command.h. The demo uses the two codes the stack leaves
+//free:
 #define FX_CMD_DEMO					2
 #define FX_CMD_STRESS_TEST			3
 
+//Demo commands:
+#define FX_CMD_DEMO_DELTA			10	//DemoStructure, delta-encoded (flexsea_delta)
+
 //****************************************************************************
 // Public Function Prototype(s):
 //****************************************************************************
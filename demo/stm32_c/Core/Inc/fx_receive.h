@@ -21,6 +21,8 @@ uint8_t fx_rx_cmd_demo(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
 		uint8_t *buf, uint8_t len);
 uint8_t fx_rx_cmd_stress_test(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
 		uint8_t *buf, uint8_t len);
+uint8_t fx_rx_cmd_demo_delta(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
+		uint8_t *buf, uint8_t len);
 
 //****************************************************************************
 // Shared variable(s)
@@ -39,6 +39,7 @@ typedef struct StressTestStructure
 // Public Function Prototype(s):
 //****************************************************************************
 
+uint8_t fx_register_tx_reply_builders(void);
 uint8_t fx_transmit(CommPort *cp);
 void fx_init_stress_test(void);
 
@@ -47,5 +48,6 @@ void fx_init_stress_test(void);
 //****************************************************************************
 
 extern DemoStructure my_demo_structure;
+extern DeltaCodec demo_delta;
 
 #endif //INC_FX_TRANSMIT_H_
@@ -36,26 +36,15 @@ void comm_init(void)
 {
 	//FlexSEA Comm Ports:
 	//USB Serial
-	comm_port[CP_USB].id = 0;
-	comm_port[CP_USB].send_reply = 0;
-	comm_port[CP_USB].reply_cmd = 0;
-	comm_port[CP_USB].cb = &cb;
-	comm_port[CP_USB].tx_fct_prt = &usb_serial_tx_string;
-	comm_port[CP_USB].use_dbuf = 0;
-	memset(comm_port[CP_USB].dbuf[0], 0x00, DBUF_MAX_LEN);
-	memset(comm_port[CP_USB].dbuf[1], 0x00, DBUF_MAX_LEN);
-	comm_port[CP_USB].dbuf_lock[0] = 0;
-	comm_port[CP_USB].dbuf_lock[1] = 0;
-	comm_port[CP_USB].dbuf_len[0] = 0;
-	comm_port[CP_USB].dbuf_len[1] = 0;
-	comm_port[CP_USB].dbuf_selected = 0;
+	fx_comm_port_init(&comm_port[CP_USB], 0, &cb, &usb_serial_tx_string);
+	comm_port[CP_USB].txq.async = 1;	//HAL_UART_Transmit_IT() returns right away
 }
 
-//Send a string
+//Send a string. Returns the HAL status: anything but HAL_OK means that no TX
+//complete interrupt is coming, and the stack will try again.
 uint8_t usb_serial_tx_string(uint8_t *bytes_to_send, uint16_t length)
 {
-	HAL_UART_Transmit_IT(&huart2, bytes_to_send, length);
-	return 0;
+	return (uint8_t)HAL_UART_Transmit_IT(&huart2, bytes_to_send, length);
 }
 
 void usb_serial_rx(void)
@@ -78,3 +67,12 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 		HAL_UART_Receive_IT(&huart2, &pc_rx_data, 1);
 	}
 }
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if(huart->Instance == USART2)
+	{
+		//Frame is out, the TX queue can send the next one
+		fx_comm_tx_done(&comm_port[CP_USB]);
+	}
+}
@@ -3,6 +3,7 @@
 //****************************************************************************
 
 #include <fx_receive.h>
+#include <fx_transmit.h>
 #include "main.h"
 #include "circ_buf.h"
 
@@ -25,6 +26,10 @@ uint8_t fx_register_rx_cmd_handlers(void)
 {
 	fx_register_rx_cmd_handler(FX_CMD_DEMO, &fx_rx_cmd_demo);
 	fx_register_rx_cmd_handler(FX_CMD_STRESS_TEST, &fx_rx_cmd_stress_test);
+	fx_register_rx_cmd_handler(FX_CMD_DEMO_DELTA, &fx_rx_cmd_demo_delta);
+
+	//Replies
+	fx_register_tx_reply_builders();
 
 	return FX_SUCCESS;
 }
@@ -123,6 +128,25 @@ uint8_t fx_rx_cmd_stress_test(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
 	}
 }
 
+//Delta-encoded demo structure. Reads get a reply, and the first data byte (if
+//any) acknowledges a keyframe: the host sends DeltaDecoder.ack() back.
+uint8_t fx_rx_cmd_demo_delta(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
+		uint8_t *buf, uint8_t len)
+{
+	if(cmd_6bits != FX_CMD_DEMO_DELTA)
+	{
+		//Problem
+		return FX_PROBLEM;
+	}
+
+	if(len > CMD_OVERHEAD)
+	{
+		fx_delta_ack(&demo_delta, buf[CMD_OVERHEAD]);
+	}
+
+	return FX_SUCCESS;
+}
+
 //****************************************************************************
 // Private Function(s)
 //****************************************************************************
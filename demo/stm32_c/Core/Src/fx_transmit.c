@@ -9,15 +9,26 @@
 // Variable(s)
 //****************************************************************************
 
-//UART transmission
-uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
-uint8_t bytestream_len = 0;
-
 DemoStructure my_demo_structure = {.var0_int8 = -1, .var1_uint32 = 123456,
 		.var2_uint8 = 150, .var3_int32 = -1234567, .var4_int8 = -125,
 		.var5_uint16 = 4567, .var6_uint8 = 123, .var7_int16 = -4567,
 		.var8_float = 12.37};
 
+//Delta-encoded demo structure (FX_CMD_DEMO_DELTA). The host acknowledges
+//keyframes, see fx_rx_cmd_demo_delta().
+#define DEMO_DELTA_KEYFRAME_INTERVAL	50
+static const uint8_t demo_delta_fields[] = {
+		FX_DELTA_FIELD(DemoStructure, var0_int8),
+		FX_DELTA_FIELD(DemoStructure, var1_uint32),
+		FX_DELTA_FIELD(DemoStructure, var2_uint8),
+		FX_DELTA_FIELD(DemoStructure, var3_int32),
+		FX_DELTA_FIELD(DemoStructure, var4_int8),
+		FX_DELTA_FIELD(DemoStructure, var5_uint16),
+		FX_DELTA_FIELD(DemoStructure, var6_uint8),
+		FX_DELTA_FIELD(DemoStructure, var7_int16),
+		FX_DELTA_FIELD(DemoStructure, var8_float)};
+DeltaCodec demo_delta;
+
 //Stress test:
 #define RAMP_MAX	1000
 StressTestStructure stress_test;
@@ -26,45 +37,38 @@ StressTestStructure stress_test;
 // Private Function Prototype(s)
 //****************************************************************************
 
-static uint8_t fx_tx_demo(uint8_t (*tx_fct_prt) (uint8_t *, uint16_t));
-static uint8_t fx_tx_stress_test(uint8_t (*tx_fct_prt) (uint8_t *, uint16_t));
-static uint8_t fx_tx_ack(CommPort *cp);
+static uint8_t fx_tx_demo(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len);
+static uint8_t fx_tx_stress_test(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len);
+static uint8_t fx_tx_demo_delta(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len);
 
 //****************************************************************************
 // Public Function(s)
 //****************************************************************************
 
-uint8_t fx_transmit(CommPort *cp)
+//Register all your reply builders here (called from
+//fx_register_rx_cmd_handlers())
+uint8_t fx_register_tx_reply_builders(void)
 {
-	if(cp->send_reply)
-	{
-		//Note: we might use a function pointer array here, just like in the
-		//reception
+	fx_register_tx_reply_builder(FX_CMD_DEMO, &fx_tx_demo);
+	fx_register_tx_reply_builder(FX_CMD_STRESS_TEST, &fx_tx_stress_test);
+	fx_register_tx_reply_builder(FX_CMD_DEMO_DELTA, &fx_tx_demo_delta);
 
-		switch(cp->reply_cmd)
-		{
-			//case FX_CMD_WHO_AM_I:
-			//	fx_tx_who_am_i(cp->tx_fct_prt);
-			//	break;
+	fx_delta_init(&demo_delta, demo_delta_fields, sizeof(demo_delta_fields),
+			DEMO_DELTA_KEYFRAME_INTERVAL, 0);
 
-			case FX_CMD_DEMO:
-				fx_tx_demo(cp->tx_fct_prt);
-				break;
+	return FX_SUCCESS;
+}
 
-			case FX_CMD_STRESS_TEST:
-				fx_tx_stress_test(cp->tx_fct_prt);
-				break;
-		}
+uint8_t fx_transmit(CommPort *cp)
+{
+	//Pending replies and acks, then periodic streams requested by the host
+	//(FX_CMD_STREAM). The stack calls the builders registered above.
+	fx_comm_process_replies(cp);
+	fx_comm_process_streams(cp, HAL_GetTick());
 
-		cp->send_reply = 0;
-	}
-	else
-	{
-		if(cp->send_ack)
-		{
-			fx_tx_ack(cp);
-		}
-	}
+	//One frame per call (the UART transmits in the background), highest
+	//priority first
+	fx_comm_process_tx_queue(cp);
 
 	return FX_SUCCESS;
 }
@@ -80,23 +84,15 @@ void fx_init_stress_test(void)
 //****************************************************************************
 
 //This is the default FlexSEA stack test command.
-static uint8_t fx_tx_demo(uint8_t (*tx_fct_prt) (uint8_t *, uint16_t))
+static uint8_t fx_tx_demo(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len)
 {
-	uint8_t ret_val = 0;
-
 	//Send known, fixed values
-	uint8_t payload_len = sizeof(my_demo_structure);
-	uint8_t* payload = (uint8_t*)&my_demo_structure;
-
-	ret_val = fx_create_bytestream_from_cmd(FX_CMD_DEMO, CmdWrite,
-			Nack, payload, payload_len, bytestream, &bytestream_len);
+	memcpy(buf, &my_demo_structure, sizeof(my_demo_structure));
+	*len = sizeof(my_demo_structure);
 
-	tx_fct_prt(bytestream, bytestream_len);
-
-	return ret_val;
+	return FX_SUCCESS;
 }
 
-
 //Increment and ceil counter and ramp
 void counter_and_ramp(void)
 {
@@ -110,40 +106,25 @@ void counter_and_ramp(void)
 }
 
 //FlexSEA Stress Test Command
-static uint8_t fx_tx_stress_test(uint8_t (*tx_fct_prt) (uint8_t *, uint16_t))
+static uint8_t fx_tx_stress_test(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len)
 {
-	uint8_t ret_val = 0;
-
 	//Send incrementing values
 	counter_and_ramp();
 
-	uint8_t payload_len = sizeof(stress_test);
-	uint8_t* payload = (uint8_t*)&stress_test;
+	memcpy(buf, &stress_test, sizeof(stress_test));
+	*len = sizeof(stress_test);
 
-	ret_val = fx_create_bytestream_from_cmd(FX_CMD_STRESS_TEST, CmdWrite,
-			Nack, payload, payload_len, bytestream, &bytestream_len);
-
-	tx_fct_prt(bytestream, bytestream_len);
-
-	return ret_val;
+	return FX_SUCCESS;
 }
 
-//FlexSEA Write Acknowledge. This is used for pure Writes that require an Ack.
-//Reads and ReadWrite will Ack as part of the existing reply.
-static uint8_t fx_tx_ack(CommPort *cp)
+//Same structure, delta-encoded: typically streamed (FX_CMD_STREAM). Fields
+//that didn't change since the last acknowledged keyframe aren't sent.
+static uint8_t fx_tx_demo_delta(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len)
 {
-	uint8_t ret_val = 0;
-
-	uint8_t payload_len = 3;
-	uint8_t payload[3] = {0};
-	payload[0] = cp->ack_cmd;
-	payload[1] = CMD_ACK_PNUM_LSB(cp->ack_packet_num);
-	payload[2] = CMD_ACK_PNUM_MSB(1, cp->ack_packet_num);
-
-	ret_val = fx_create_bytestream_from_cmd(FX_CMD_ACK, CmdWrite,
-			Ack, payload, payload_len, bytestream, &bytestream_len);
-
-	cp->tx_fct_prt(bytestream, bytestream_len);
+	if(fx_delta_encode(&demo_delta, (uint8_t *)&my_demo_structure, buf, len))
+	{
+		return FX_PROBLEM;
+	}
 
-	return ret_val;
+	return FX_SUCCESS;
 }
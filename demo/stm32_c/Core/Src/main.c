@@ -116,6 +116,11 @@ int main(void)
   fx_rx_cmd_init();
   comm_init();
 
+  //Cycle counter, used for the stack's timestamps (trace, profile)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
   //Start UART reception
   usb_serial_rx();
 
@@ -148,6 +153,9 @@ int main(void)
       //Receive commands
       fx_receive(&comm_port[0]);
 
+      //Commands scheduled by the host (FX_CMD_SCHEDULE)
+      fx_comm_process_schedule(&comm_port[0]);
+
       //Send commands
       fx_transmit(&comm_port[0]);
 
@@ -325,6 +333,17 @@ static void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 4 */
 
+//Stack timestamps: CPU cycles
+uint32_t fx_timestamp(void)
+{
+	return DWT->CYCCNT;
+}
+
+uint32_t fx_timestamp_hz(void)
+{
+	return SystemCoreClock;
+}
+
 /* USER CODE END 4 */
 
 /**
@@ -0,0 +1,399 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jf at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] _flexsea: CPython extension module (native Python binding)
+ ****************************************************************************/
+
+//The ctypes binding (flexsea_python.py + the DLL) pays for a foreign call, a
+//few ctypes objects and a 200-byte copy on every operation. This module is
+//the same stack, compiled into Python:
+//- Port: a circular buffer. feed() takes anything that supports the buffer
+//  protocol, decode() returns the payload as a memoryview (no copy), and
+//  releases the GIL while it decodes.
+//- encode() / encode_into(): command to frame.
+//The stack has some global state (packet numbers, codec settings): every call
+//that uses it holds one module lock.
+//Build: python3 setup.py build_ext --inplace (in flexsea_python/)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <pythread.h>
+#include "flexsea.h"
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+static PyThread_type_lock fx_lock = NULL;
+
+//A port: its circular buffer, and the last payload it decoded
+typedef struct
+{
+	PyObject_HEAD
+	circ_buf_t cb;
+	unsigned char address;		//Multi-drop: frames we accept, FX_ADDR_NONE for all
+	unsigned char last_address;	//Destination of the last frame decoded
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t buf_len;
+}FxPortObject;
+
+//****************************************************************************
+// Private Function(s) - Port
+//****************************************************************************
+
+static int fx_port_init(FxPortObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"address", NULL};
+	int address = FX_ADDR_NONE;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &address))
+	{
+		return -1;
+	}
+
+	circ_buf_init(&self->cb);
+	self->address = (unsigned char)address;
+	self->last_address = FX_ADDR_NONE;
+	self->buf_len = 0;
+
+	return 0;
+}
+
+//feed(data): copy received bytes to the circular buffer. Returns the number
+//of bytes accepted.
+static PyObject *fx_port_feed(FxPortObject *self, PyObject *arg)
+{
+	Py_buffer view;
+	Py_ssize_t len = 0;
+	uint16_t refused = 0;
+
+	if(PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) < 0)
+	{
+		return NULL;
+	}
+
+	len = (view.len > CIRC_BUF_SIZE) ? CIRC_BUF_SIZE : view.len;
+	PyThread_acquire_lock(fx_lock, WAIT_LOCK);
+	refused = fx_feed(&self->cb, (const uint8_t *)view.buf, (uint16_t)len);
+	PyThread_release_lock(fx_lock);
+	PyBuffer_Release(&view);
+
+	return PyLong_FromSsize_t(len - refused);
+}
+
+//decode(): next command in the buffer. Returns None, or (cmd, rw, ack,
+//payload). 'payload' is a read-only memoryview on the port: it's only valid
+//until the next decode(), copy (bytes()) what you keep.
+static PyObject *fx_port_decode(FxPortObject *self, PyObject *Py_UNUSED(ignored))
+{
+	uint8_t cmd_6bits = 0, ret_val = 1;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+	uint8_t len = 0;
+	uint16_t before = 0;
+	PyObject *payload = NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(fx_lock, WAIT_LOCK);
+	fx_codec_set_rx_address(self->address);
+	//Keep going while bytes get flushed (noise, frames for other nodes)
+	while(ret_val && (self->cb.length > MIN_OVERHEAD) &&
+			(self->cb.length != before))
+	{
+		before = self->cb.length;
+		ret_val = fx_get_cmd_handler_from_bytestream(&self->cb, &cmd_6bits,
+				&rw, &ack, self->buf, &len);
+	}
+	if(!ret_val)
+	{
+		self->buf_len = len;
+		self->last_address = fx_codec_get_last_rx_address();
+	}
+	fx_codec_set_rx_address(FX_ADDR_NONE);
+	PyThread_release_lock(fx_lock);
+	Py_END_ALLOW_THREADS
+
+	if(ret_val)
+	{
+		Py_RETURN_NONE;
+	}
+
+	payload = PyMemoryView_FromObject((PyObject *)self);
+	if(payload == NULL)
+	{
+		return NULL;
+	}
+
+	return Py_BuildValue("(iiiN)", cmd_6bits, (int)rw, (int)ack, payload);
+}
+
+//cleanup(): drop what's before the next header
+static PyObject *fx_port_cleanup(FxPortObject *self, PyObject *Py_UNUSED(ignored))
+{
+	PyThread_acquire_lock(fx_lock, WAIT_LOCK);
+	fx_cleanup(&self->cb);
+	PyThread_release_lock(fx_lock);
+	Py_RETURN_NONE;
+}
+
+//reset(): empty the circular buffer
+static PyObject *fx_port_reset(FxPortObject *self, PyObject *Py_UNUSED(ignored))
+{
+	PyThread_acquire_lock(fx_lock, WAIT_LOCK);
+	circ_buf_init(&self->cb);
+	PyThread_release_lock(fx_lock);
+	Py_RETURN_NONE;
+}
+
+//read_byte(): take one byte out of the buffer, bypassing the stack (debugging)
+static PyObject *fx_port_read_byte(FxPortObject *self, PyObject *Py_UNUSED(ignored))
+{
+	uint8_t value = 0;
+
+	PyThread_acquire_lock(fx_lock, WAIT_LOCK);
+	circ_buf_read_byte(&self->cb, &value);
+	PyThread_release_lock(fx_lock);
+	return PyLong_FromLong(value);
+}
+
+static PyObject *fx_port_get_length(FxPortObject *self, void *closure)
+{
+	return PyLong_FromLong(self->cb.length);
+}
+
+//The buffer protocol exports the last decoded payload
+static int fx_port_getbuffer(FxPortObject *self, Py_buffer *view, int flags)
+{
+	return PyBuffer_FillInfo(view, (PyObject *)self, self->buf, self->buf_len,
+			1, flags);
+}
+
+static PyMethodDef fx_port_methods[] = {
+	{"feed", (PyCFunction)fx_port_feed, METH_O,
+			"feed(data): add received bytes, returns how many were accepted"},
+	{"decode", (PyCFunction)fx_port_decode, METH_NOARGS,
+			"decode(): None, or (cmd, rw, ack, payload memoryview)"},
+	{"cleanup", (PyCFunction)fx_port_cleanup, METH_NOARGS,
+			"cleanup(): drop the bytes before the next header"},
+	{"reset", (PyCFunction)fx_port_reset, METH_NOARGS,
+			"reset(): empty the circular buffer"},
+	{"read_byte", (PyCFunction)fx_port_read_byte, METH_NOARGS,
+			"read_byte(): take one byte out of the buffer (debugging)"},
+	{NULL}
+};
+
+static PyMemberDef fx_port_members[] = {
+	{"address", T_UBYTE, offsetof(FxPortObject, address), 0,
+			"Multi-drop: frames we decode (0 for a host), 0xFF for a point-to-point link"},
+	{"last_address", T_UBYTE, offsetof(FxPortObject, last_address), READONLY,
+			"Destination of the last frame decoded"},
+	{NULL}
+};
+
+static PyGetSetDef fx_port_getset[] = {
+	{"length", (getter)fx_port_get_length, NULL,
+			"Bytes in the circular buffer", NULL},
+	{NULL}
+};
+
+static PyBufferProcs fx_port_as_buffer = {
+	.bf_getbuffer = (getbufferproc)fx_port_getbuffer,
+	.bf_releasebuffer = NULL,
+};
+
+static PyTypeObject FxPortType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_flexsea.Port",
+	.tp_doc = "Port(address=0xFF): circular buffer and decoder",
+	.tp_basicsize = sizeof(FxPortObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_new = PyType_GenericNew,
+	.tp_init = (initproc)fx_port_init,
+	.tp_methods = fx_port_methods,
+	.tp_members = fx_port_members,
+	.tp_getset = fx_port_getset,
+	.tp_as_buffer = &fx_port_as_buffer,
+};
+
+//****************************************************************************
+// Private Function(s) - module
+//****************************************************************************
+
+//Common to encode() and encode_into()
+static int fx_py_encode(int cmd, int rw, int ack, Py_buffer *payload, int addr,
+		uint8_t *frame, uint8_t *frame_len)
+{
+	uint8_t ret_val = 0;
+
+	if((cmd < MIN_CMD_CODE) || (cmd > MAX_CMD_CODE) ||
+			(payload->len > MAX_ENCODED_PAYLOAD_BYTES))
+	{
+		PyErr_SetString(PyExc_ValueError, "invalid command code or payload");
+		return -1;
+	}
+
+	PyThread_acquire_lock(fx_lock, WAIT_LOCK);
+	ret_val = fx_create_bytestream_from_cmd_addr((uint8_t)addr, (uint8_t)cmd,
+			(ReadWrite)rw, (AckNack)ack, (uint8_t *)payload->buf,
+			(uint8_t)payload->len, frame, frame_len);
+	PyThread_release_lock(fx_lock);
+	if(ret_val)
+	{
+		PyErr_SetString(PyExc_ValueError, "payload too long to be encoded");
+		return -1;
+	}
+
+	return 0;
+}
+
+//encode(cmd, rw, ack, payload, addr=0xFF): returns the frame (bytes)
+static PyObject *fx_py_encode_bytes(PyObject *module, PyObject *args,
+		PyObject *kwds)
+{
+	static char *kwlist[] = {"cmd", "rw", "ack", "payload", "addr", NULL};
+	int cmd = 0, rw = 0, ack = 0, addr = FX_ADDR_NONE;
+	Py_buffer payload;
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t frame_len = 0;
+	int ret_val = 0;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "iiiy*|i", kwlist, &cmd, &rw,
+			&ack, &payload, &addr))
+	{
+		return NULL;
+	}
+
+	ret_val = fx_py_encode(cmd, rw, ack, &payload, addr, frame, &frame_len);
+	PyBuffer_Release(&payload);
+	if(ret_val)
+	{
+		return NULL;
+	}
+
+	return PyBytes_FromStringAndSize((const char *)frame, frame_len);
+}
+
+//encode_into(buffer, cmd, rw, ack, payload, addr=0xFF): writes the frame in a
+//buffer you own (bytearray, ctypes array...), returns its length
+static PyObject *fx_py_encode_into(PyObject *module, PyObject *args,
+		PyObject *kwds)
+{
+	static char *kwlist[] = {"buffer", "cmd", "rw", "ack", "payload", "addr",
+			NULL};
+	int cmd = 0, rw = 0, ack = 0, addr = FX_ADDR_NONE;
+	Py_buffer out, payload;
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t frame_len = 0;
+	int ret_val = 0;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "w*iiiy*|i", kwlist, &out, &cmd,
+			&rw, &ack, &payload, &addr))
+	{
+		return NULL;
+	}
+
+	ret_val = fx_py_encode(cmd, rw, ack, &payload, addr, frame, &frame_len);
+	if(!ret_val && (out.len < frame_len))
+	{
+		PyErr_SetString(PyExc_ValueError, "buffer too small");
+		ret_val = -1;
+	}
+	if(!ret_val)
+	{
+		memcpy(out.buf, frame, frame_len);
+	}
+	PyBuffer_Release(&payload);
+	PyBuffer_Release(&out);
+
+	return ret_val ? NULL : PyLong_FromLong(frame_len);
+}
+
+//Same names as the DLL functions that flexsea_python.py calls directly
+static PyObject *fx_py_rx_cmd_init(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+	return PyLong_FromLong(fx_rx_cmd_init());
+}
+
+static PyObject *fx_py_last_tx_packet_num(PyObject *module,
+		PyObject *Py_UNUSED(ignored))
+{
+	return PyLong_FromLong(get_last_tx_packet_num());
+}
+
+static PyMethodDef fx_module_methods[] = {
+	{"encode", (PyCFunction)(void(*)(void))fx_py_encode_bytes,
+			METH_VARARGS | METH_KEYWORDS,
+			"encode(cmd, rw, ack, payload, addr=0xFF): frame as bytes"},
+	{"encode_into", (PyCFunction)(void(*)(void))fx_py_encode_into,
+			METH_VARARGS | METH_KEYWORDS,
+			"encode_into(buffer, cmd, rw, ack, payload, addr=0xFF): frame length"},
+	{"fx_rx_cmd_init", fx_py_rx_cmd_init, METH_NOARGS,
+			"Initialize the stack (returns 0)"},
+	{"get_last_tx_packet_num", fx_py_last_tx_packet_num, METH_NOARGS,
+			"Packet number of the last frame encoded"},
+	{NULL}
+};
+
+static struct PyModuleDef fx_module = {
+	PyModuleDef_HEAD_INIT,
+	.m_name = "_flexsea",
+	.m_doc = "FlexSEA v2 communication stack, native binding",
+	.m_size = -1,
+	.m_methods = fx_module_methods,
+};
+
+PyMODINIT_FUNC PyInit__flexsea(void)
+{
+	PyObject *m = NULL;
+
+	if(PyType_Ready(&FxPortType) < 0)
+	{
+		return NULL;
+	}
+
+	fx_lock = PyThread_allocate_lock();
+	if(fx_lock == NULL)
+	{
+		return PyErr_NoMemory();
+	}
+
+	m = PyModule_Create(&fx_module);
+	if(m == NULL)
+	{
+		return NULL;
+	}
+
+	Py_INCREF(&FxPortType);
+	if(PyModule_AddObject(m, "Port", (PyObject *)&FxPortType) < 0)
+	{
+		Py_DECREF(&FxPortType);
+		Py_DECREF(m);
+		return NULL;
+	}
+	PyModule_AddIntConstant(m, "MAX_ENCODED_PAYLOAD_BYTES", MAX_ENCODED_PAYLOAD_BYTES);
+	PyModule_AddIntConstant(m, "CIRC_BUF_SIZE", CIRC_BUF_SIZE);
+	PyModule_AddIntConstant(m, "ADDR_NONE", FX_ADDR_NONE);
+
+	return m;
+}
@@ -5,7 +5,13 @@ import serial
 from serial import SerialException
 import time
 import platform
+import asyncio
+from collections import deque
 from flexsea_tools import *
+try:
+    import _flexsea  # Native binding, see setup.py and FlexSEANative
+except ImportError:
+    _flexsea = None
 
 # The variables found before the FlexSEAPython class need to match the C code.
 # Only edit if you have changed the code used to generate the DLL!
@@ -19,6 +25,30 @@ MAX_CMD_CODE = 63
 CMD_WHO_AM_I = 0
 CMD_ACK = 1
 CMD_DEMO = 2
+CMD_STREAM = 4
+CMD_DIAG = 5
+CMD_TIME_SYNC = 6
+CMD_SCHEDULE = 7
+CMD_TDMA = 8
+SCHED_MAX_BYTES = 32
+# FX_CMD_DIAG selectors and reply formats (flexsea_comm.h)
+DIAG_STATS = 0
+DIAG_TRACE = 1
+DIAG_PROFILE = 2
+TRACE_CTRL_STOP = 0
+TRACE_CTRL_START = 1
+TRACE_CTRL_CLEAR = 2
+TX_CLASSES = 3
+DIAG_STATS_FIELDS = ['bytes_received', 'rx_overflows', 'frames_decoded', 'checksum_errors', 'footer_errors',
+                     'bytes_discarded', 'escapes_encoded', 'frames_sent', 'replies_dropped'] + \
+                    [f'frames_dropped_{i}' for i in range(TX_CLASSES)] + ['frames_filtered']
+# Multi-drop addressing (flexsea_codec.h)
+ADDR_HOST = 0x00
+ADDR_NODE_MAX = 0xDF
+ADDR_GROUP_0 = 0xE0  # Groups 0 to 7: ADDR_GROUP_0 + n
+ADDR_BROADCAST = 0xE8
+ADDR_MAX = 0xE8
+ADDR_NONE = 0xFF  # Point-to-point link
 
 # This structure holds all the info about a given circular buffer
 # This needs to match circ_buf.h!
@@ -109,6 +139,15 @@ class FlexSEASerial:
             b = self.serial_port.read(1)
         return b
 
+    def read_bytes(self, count):
+        """
+        Read up to 'count' bytes from the serial port, without waiting
+        :return: bytes
+        """
+        if self.serial_port and count > 0:
+            return self.serial_port.read(count)
+        return b''
+
     def bytes_available(self):
         """
         Check for available bytes (rx)
@@ -141,7 +180,21 @@ class FlexSEAPython:
             # Re-use a port
             self.serial = existing_port
         self.cb = CircularBuffer()
-        self.fx = cdll.LoadLibrary(dll_filename)
+        self.fx = self.load_stack(dll_filename)
+        # Reusable ctypes objects: steady-state RX and TX do not allocate
+        self._cb_ptr = pointer(self.cb)
+        self._rx_cmd = c_uint8(0)
+        self._rx_rw = c_uint8(0)
+        self._rx_ack = c_uint8(0)
+        self._rx_len = c_uint8(0)
+        self._rx_buf = (c_uint8 * MAX_ENCODED_PAYLOAD_BYTES)()
+        self._rx_view = memoryview(self._rx_buf).cast('B')
+        self._rx_args = (self._cb_ptr, pointer(self._rx_cmd), pointer(self._rx_rw), pointer(self._rx_ack),
+                         self._rx_buf, pointer(self._rx_len))
+        self._tx_len = c_uint8(0)
+        self._tx_len_ptr = pointer(self._tx_len)
+        self._tx_buf = (c_uint8 * MAX_ENCODED_PAYLOAD_BYTES)()
+        self._tx_view = memoryview(self._tx_buf).cast('B')
         ret_val = self.fx.fx_rx_cmd_init()
         if ret_val:
             print("Problem initializing the FlexSEA stack - quit.")
@@ -159,6 +212,23 @@ class FlexSEAPython:
             "Ack": 1,
         }
         self.register_cmd_handler(CMD_ACK, self.fx_rx_cmd_handler_1)
+        self.register_cmd_handler(CMD_DIAG, self.fx_rx_cmd_handler_diag)
+        self.port_stats = {}  # Last link health counters received (FX_CMD_DIAG)
+        self.trace_page = None  # Last trace page received (FX_CMD_DIAG)
+        self.profile = {}  # Last stage latencies received (FX_CMD_DIAG)
+        self.register_cmd_handler(CMD_TIME_SYNC, self.fx_rx_cmd_handler_time_sync)
+        self.clock = ClockSync()  # Device to host time mapping (FX_CMD_TIME_SYNC)
+        self.address = None  # Destination on a multi-drop bus, None for point-to-point
+        self.time_sync_pending = None  # Last T1 sent
+
+    @staticmethod
+    def load_stack(dll_filename):
+        """
+        Load the C stack (shared library, called with ctypes)
+        :param dll_filename: path to the DLL / .so / .dylib
+        :return: library object
+        """
+        return cdll.LoadLibrary(dll_filename)
 
     def create_bytestream_from_cmd(self, cmd, rw, ack, payload_string):
         """
@@ -166,29 +236,78 @@ class FlexSEAPython:
         :param cmd: command code, between MIN_CMD_CODE and MAX_CMD_CODE
         :param rw: string from 'rw_dict' that describes the Read/Write command type
         :param payload_string: data to send, either as a string or a bytearray
-        :return: ret_val (0 if success), bytestream and its length in bytes
+        :return: ret_val (0 if success), bytestream and its length in bytes. The bytestream is a memoryview on a
+        buffer owned by this object: copy it (bytes()) if it has to outlive the next call.
         """
         if cmd < MIN_CMD_CODE or cmd > MAX_CMD_CODE:
             # Invalid command code
             return 1, [], 0
 
         if isinstance(payload_string, str):
-            payload_in = c_char_p(payload_string.encode())
+            payload_string = payload_string.encode()
+        elif not isinstance(payload_string, bytes):
+            # ctypes only passes bytes as a pointer without a copy
+            payload_string = bytes(payload_string)
+
+        if self.address is None:
+            ret_val = self.fx.fx_create_bytestream_from_cmd(cmd, self.rw_dict[rw], self.ack_dict[ack], payload_string,
+                                                            len(payload_string), self._tx_buf, self._tx_len_ptr)
         else:
-            # Data is already in the form of a byte array
-            payload_in = payload_string
-        payload_in_len = c_uint8(len(payload_string))
-        bytestream_ba = (c_uint8 * MAX_ENCODED_PAYLOAD_BYTES)()
-        bytestream_len = c_uint8(0)
-        cmd_6bits_in = c_uint8(cmd)
+            ret_val = self.fx.fx_create_bytestream_from_cmd_addr(self.address, cmd, self.rw_dict[rw],
+                                                                 self.ack_dict[ack], payload_string,
+                                                                 len(payload_string), self._tx_buf, self._tx_len_ptr)
 
-        rw_c = c_uint8(self.rw_dict[rw])
-        ack_c = c_uint8(self.ack_dict[ack])
+        # View on our own buffer: valid until the next call
+        bytestream_len = self._tx_len.value
+        return ret_val, self._tx_view[:bytestream_len], bytestream_len
 
-        ret_val = self.fx.fx_create_bytestream_from_cmd(cmd_6bits_in, rw_c, ack_c, payload_in, payload_in_len,
-                                                        bytestream_ba, byref(bytestream_len))
+    def use_address(self, address):
+        """
+        Multi-drop bus: send the next commands to 'address', and only decode frames sent to the host. Every device
+        shares the same transceiver; switch between them by changing the address.
+        :param address: device address (1 to ADDR_NODE_MAX, set 'addr' on the device's CommPort), None for
+        point-to-point
+        :return: N/A
+        """
+        self.address = address
+        self.fx.fx_codec_set_rx_address(c_uint8(0xFF if address is None else ADDR_HOST))
 
-        return ret_val, bytes(bytestream_ba), int(bytestream_len.value)
+    def multicast(self, cmd, payload_string, group=None, rw="CmdWrite"):
+        """
+        Multi-drop bus: one frame for every device (or for a group). They all execute it, and none of them replies;
+        poll them individually if you need data back. Combine with schedule() to make them act at the same time.
+        :param cmd: command code
+        :param payload_string: data (bytes)
+        :param group: 0 to 7 (set 'groups' on the device's CommPort), None for a broadcast
+        :param rw: string from 'rw_dict'
+        :return: 0 if the frame was sent
+        """
+        address = self.address
+        self.address = ADDR_BROADCAST if group is None else ADDR_GROUP_0 + group
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=cmd, rw=rw, ack="Nack",
+                                                                              payload_string=payload_string)
+        self.address = address
+        if not ret_val:
+            self.serial.write(bytestream, bytestream_len)
+        return ret_val
+
+    def tdma_beacon(self, slot_us, slots):
+        """
+        Start a TDMA cycle (FX_CMD_TDMA): every device that has a slot (fx_tdma_config()) sends its frame in it,
+        slot n starting n * slot_us after the beacon. Send one beacon per cycle, then receive the replies as usual.
+        Size the slots for one frame plus the transceiver turnaround.
+        :param slot_us: slot length in microseconds (up to 65535)
+        :param slots: number of slots in the cycle
+        :return: 0 if the beacon was sent
+        """
+        return self.multicast(CMD_TDMA, uint16_to_bytes(slot_us) + bytes([slots]))
+
+    def tdma_stop(self):
+        """
+        End TDMA mode: the devices transmit whenever they have something to send again
+        :return: 0 if the frame was sent
+        """
+        return self.multicast(CMD_TDMA, b'')
 
     def write_to_circular_buffer(self, bytestream, bytestream_len):
         """
@@ -199,7 +318,12 @@ class FlexSEAPython:
         :return: 0 if it succeeded
         """
         if bytestream_len > 0:
-            if bytestream_len == 1:
+            if isinstance(bytestream, (bytes, bytearray, memoryview)):
+                # One call for the whole array
+                if self.feed(bytestream[0:bytestream_len]) < bytestream_len:
+                    print("fx_feed(): buffer is full! Some bytes were dropped.")
+                    return 1    # Problem
+            elif bytestream_len == 1:
                 # One byte at the time
                 ret_val = self.fx.circ_buf_write_byte(byref(self.cb), bytestream)
                 if ret_val:
@@ -216,6 +340,22 @@ class FlexSEAPython:
         else:
             return 1    # Problem
 
+    def feed(self, data):
+        """
+        Hand received bytes to the C stack in one call (fx_feed()), instead of one call per byte
+        :param data: bytes, bytearray or memoryview
+        :return: number of bytes accepted (the rest didn't fit in the circular buffer)
+        """
+        length = len(data)
+        if length == 0:
+            return 0
+        if not isinstance(data, bytes):
+            view = memoryview(data).cast('B')
+            # Writable buffers are passed as they are, read-only views get copied
+            data = bytes(view) if view.readonly else (c_uint8 * length).from_buffer(view)
+        refused = self.fx.fx_feed(byref(self.cb), data, length)
+        return length - refused
+
     def read_byte_from_circular_buffer(self):
         """
         This should only be used for debugging! This takes bytes from the CB, bypassing the stack
@@ -243,16 +383,11 @@ class FlexSEAPython:
         return ret_val
 
     def get_cmd_handler_from_bytestream(self):
-        # At this point our encoded command is in the circular buffer
-        cmd_6bits_out = c_uint8(0)
-        rw_out = c_uint8(0)
-        ack_out = c_uint8(0)
-        buf = (c_uint8 * MAX_ENCODED_PAYLOAD_BYTES)()
-        buf_len = c_uint8(0)
-        # Can we decode it?
-        ret_val = self.fx.fx_get_cmd_handler_from_bytestream(byref(self.cb), byref(cmd_6bits_out), byref(rw_out),
-                                                             byref(ack_out), buf, byref(buf_len))
-        return ret_val, cmd_6bits_out.value, rw_out.value, ack_out.value, bytes(buf), buf_len.value
+        # At this point our encoded command is in the circular buffer. Can we decode it?
+        ret_val = self.fx.fx_get_cmd_handler_from_bytestream(*self._rx_args)
+        # View on our own buffer: valid until the next call
+        buf_len = self._rx_len.value
+        return ret_val, self._rx_cmd.value, self._rx_rw.value, self._rx_ack.value, self._rx_view[:buf_len], buf_len
 
     @staticmethod
     def cmd_handler_catchall(cmd_6bits, rw, ack, buf):
@@ -288,9 +423,7 @@ class FlexSEAPython:
         bytes_to_read = self.serial.bytes_available()
         if bytes_to_read > 0:
             # print(f'Bytes to read: {bytes_to_read}.')
-            for i in range(bytes_to_read):
-                new_rx_byte = self.serial.read_byte()
-                ret_val = self.write_to_circular_buffer(new_rx_byte[0], 1)
+            self.feed(self.serial.read_bytes(bytes_to_read))
 
 
     def receive(self, max_tries=5):
@@ -365,6 +498,203 @@ class FlexSEAPython:
                                                                               ack="Nack", payload_string='')
         self.rw_one_packet(bytestream, bytestream_len, start_time, None)
 
+    def subscribe(self, cmd, period_ms, ack="Nack"):
+        """
+        Ask the device to send 'cmd' every 'period_ms', without being polled. Use grab_new_bytes() and receive()
+        to consume the stream.
+        :param cmd: command code to stream
+        :param period_ms: period in ms (1 to 65535). 0 unsubscribes.
+        :param ack: "Ack" to get an acknowledgement
+        :return: 0 if the request was sent
+        """
+        payload = bytes([cmd]) + uint16_to_bytes(period_ms)
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=CMD_STREAM, rw="CmdWrite",
+                                                                              ack=ack, payload_string=payload)
+        if not ret_val:
+            self.serial.write(bytestream, bytestream_len)
+        return ret_val
+
+    def unsubscribe(self, cmd, ack="Nack"):
+        """
+        Stop a stream started with subscribe()
+        :param cmd: command code
+        :param ack: "Ack" to get an acknowledgement
+        :return: 0 if the request was sent
+        """
+        return self.subscribe(cmd, 0, ack)
+
+    def read_stats(self, comm_wait=100):
+        """
+        Read the device's link health counters (FX_CMD_DIAG). Poll less often when errors or drops go up.
+        :param comm_wait: how long we wait for the reply, in ms
+        :return: dictionary of counters (see DIAG_STATS_FIELDS), empty if we didn't get a reply
+        """
+        self.port_stats = {}
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=CMD_DIAG, rw="CmdRead", ack="Nack",
+                                                                              payload_string=bytes([DIAG_STATS]))
+        if not ret_val:
+            self.rw_one_packet(bytestream, bytestream_len, round(time.time() * 1000), None, comm_wait)
+        return self.port_stats
+
+    def reset_stats(self):
+        """
+        Reset the device's link health counters
+        :return: 0 if the request was sent
+        """
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=CMD_DIAG, rw="CmdWrite", ack="Nack",
+                                                                              payload_string=bytes([DIAG_STATS]))
+        if not ret_val:
+            self.serial.write(bytestream, bytestream_len)
+        return ret_val
+
+    def trace_control(self, ctrl):
+        """
+        Stop, start or clear the device's event trace ring
+        :param ctrl: TRACE_CTRL_STOP, TRACE_CTRL_START or TRACE_CTRL_CLEAR
+        :return: 0 if the request was sent
+        """
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=CMD_DIAG, rw="CmdWrite", ack="Nack",
+                                                                              payload_string=bytes([DIAG_TRACE, ctrl]))
+        if not ret_val:
+            self.serial.write(bytestream, bytestream_len)
+        return ret_val
+
+    def read_trace(self, comm_wait=100):
+        """
+        Dump the device's event trace. The ring is stopped during the dump, and restarted after.
+        Use flexsea_tools.format_trace() to print a timeline.
+        :param comm_wait: how long we wait for each page, in ms
+        :return: (timestamp_hz, events), events as returned by flexsea_tools.decode_trace()
+        """
+        self.trace_control(TRACE_CTRL_STOP)
+        events = []
+        timestamp_hz = 0
+        while True:
+            self.trace_page = None
+            payload = bytes([DIAG_TRACE]) + uint16_to_bytes(len(events))
+            ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=CMD_DIAG, rw="CmdRead",
+                                                                                  ack="Nack", payload_string=payload)
+            self.rw_one_packet(bytestream, bytestream_len, round(time.time() * 1000), None, comm_wait)
+            if self.trace_page is None:
+                break   # No reply
+            timestamp_hz, page = self.trace_page
+            if not page:
+                break   # Done
+            events.extend(page)
+        self.trace_control(TRACE_CTRL_START)
+        return timestamp_hz, events
+
+    def read_profile(self, comm_wait=100):
+        """
+        Read the device's stage latencies (decode, parse, handler, encode). The firmware needs FX_PROFILE_ENABLE.
+        :param comm_wait: how long we wait for the reply, in ms
+        :return: dictionary from flexsea_tools.decode_profile(), empty if we didn't get a reply
+        """
+        self.profile = {}
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=CMD_DIAG, rw="CmdRead", ack="Nack",
+                                                                              payload_string=bytes([DIAG_PROFILE]))
+        if not ret_val:
+            self.rw_one_packet(bytestream, bytestream_len, round(time.time() * 1000), None, comm_wait)
+        return self.profile
+
+    def reset_profile(self):
+        """
+        Reset the device's stage latencies
+        :return: 0 if the request was sent
+        """
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=CMD_DIAG, rw="CmdWrite", ack="Nack",
+                                                                              payload_string=bytes([DIAG_PROFILE]))
+        if not ret_val:
+            self.serial.write(bytestream, bytestream_len)
+        return ret_val
+
+    def time_sync(self, exchanges=8, comm_wait=50):
+        """
+        Exchange timestamps with the device and update self.clock. Call it periodically (every few seconds) to track
+        drift; use self.clock.device_to_host() to align device timestamps with the host's time.monotonic().
+        :param exchanges: number of requests
+        :param comm_wait: how long we wait for each reply, in ms
+        :return: best round trip time (s), None if we never got a reply
+        """
+        for i in range(exchanges):
+            self.time_sync_pending = time.monotonic_ns()
+            ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(
+                cmd=CMD_TIME_SYNC, rw="CmdRead", ack="Nack", payload_string=struct.pack('<Q', self.time_sync_pending))
+            if not ret_val:
+                self.rw_one_packet(bytestream, bytestream_len, round(time.time() * 1000), None, comm_wait)
+        self.time_sync_pending = None
+        return self.clock.min_round_trip
+
+    def schedule(self, at, cmd, rw, ack, payload_string, packet_num=0):
+        """
+        Ask the device to execute a command at a given time (FX_CMD_SCHEDULE). Send the same 'at' to several devices
+        to make them act together. Run time_sync() first, and schedule less than a few seconds ahead.
+        :param at: host time (time.monotonic(), s)
+        :param cmd: command code
+        :param rw: string from 'rw_dict'
+        :param ack: string from 'ack_dict'. Replies and acks are sent at execution time.
+        :param payload_string: data of the embedded command (bytes)
+        :param packet_num: packet number of the embedded command
+        :return: 0 if the request was sent
+        """
+        device_at = self.clock.host_to_device(at)
+        embedded = bytes([((cmd & 0x3F) << 2) | self.rw_dict[rw],
+                          (self.ack_dict[ack] << 7) | ((packet_num >> 8) & 0x7F),
+                          packet_num & 0xFF]) + bytes(payload_string)
+        if device_at is None or len(embedded) > SCHED_MAX_BYTES:
+            return 1
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(
+            cmd=CMD_SCHEDULE, rw="CmdWrite", ack="Nack", payload_string=uint32_to_bytes(device_at) + embedded)
+        if not ret_val:
+            self.serial.write(bytestream, bytestream_len)
+        return ret_val
+
+    def cancel_schedule(self):
+        """
+        Drop every command the device has scheduled
+        :return: 0 if the request was sent
+        """
+        ret_val, bytestream, bytestream_len = self.create_bytestream_from_cmd(cmd=CMD_SCHEDULE, rw="CmdWrite",
+                                                                              ack="Nack", payload_string=bytes())
+        if not ret_val:
+            self.serial.write(bytestream, bytestream_len)
+        return ret_val
+
+    def fx_rx_cmd_handler_time_sync(self, cmd_6bits, rw, ack, buf):
+        """
+        Time sync reception handler: [T1][T2][T3][TIMESTAMP_HZ]
+        :param cmd_6bits: 6-bits command code
+        :param rw: ReadWrite
+        :param ack: Ack or Nack
+        :param buf: buffer with data
+        :return: N/A
+        """
+        t4 = time.monotonic_ns()
+        t1, t2, t3, timestamp_hz = struct.unpack_from('<QIII', buf, CMD_OVERHEAD)
+        # Ignore late replies to an older request
+        if t1 == self.time_sync_pending and timestamp_hz:
+            self.clock.add_sample(t1 / 1e9, t2, t3, t4 / 1e9, timestamp_hz)
+
+    def fx_rx_cmd_handler_diag(self, cmd_6bits, rw, ack, buf):
+        """
+        Diagnostics reception handler. The first data byte is the selector.
+        :param cmd_6bits: 6-bits command code
+        :param rw: ReadWrite
+        :param ack: Ack or Nack
+        :param buf: buffer with data
+        :return: N/A
+        """
+        if buf[CMD_OVERHEAD] == DIAG_STATS:
+            values = struct.unpack_from(f'<{len(DIAG_STATS_FIELDS)}I', buf, CMD_OVERHEAD + 1)
+            self.port_stats = dict(zip(DIAG_STATS_FIELDS, values))
+        elif buf[CMD_OVERHEAD] == DIAG_TRACE:
+            # [TIMESTAMP_HZ][COUNT][FIRST][N][N x EVENT]
+            timestamp_hz, count, first, n = struct.unpack_from('<IIHB', buf, CMD_OVERHEAD + 1)
+            start = CMD_OVERHEAD + 12
+            self.trace_page = (timestamp_hz, decode_trace(buf[start:start + n * TRACE_EVENT_SIZE]))
+        elif buf[CMD_OVERHEAD] == DIAG_PROFILE:
+            self.profile = decode_profile(bytes(buf[CMD_OVERHEAD + 1:]))
+
     @staticmethod
     def identify_platform():
         # What computer hardware is this code running on?
@@ -405,8 +735,7 @@ class FlexSEAPython:
         :param buf: buffer with data
         :return: N/A
         """
-        rx_data = WhoAmIStruct()
-        ctypes.memmove(pointer(rx_data), buf[CMD_OVERHEAD:], sizeof(rx_data))
+        rx_data = WhoAmIStruct.from_buffer_copy(buf, CMD_OVERHEAD)
         uuid = rx_data.uuid[0] * 2 ** 64 + rx_data.uuid[1] * 2 ** 32 + rx_data.uuid[2]  # Rebuild UUID C-style
 
         board_str_as_bytes = [chr(rx_data.board[i]) for i in range(len(rx_data.board))]
@@ -429,6 +758,253 @@ class FlexSEAPython:
               f'{self.fx.get_last_tx_packet_num()}.')
 
 
+class FlexSEANative(FlexSEAPython):
+    """
+    Same interface as FlexSEAPython, but the stack is the _flexsea extension module (build it with setup.py) instead
+    of the DLL. No ctypes objects, no copies: received bytes are handed over with the buffer protocol, decoded
+    payloads come back as memoryviews, and decoding releases the GIL.
+    Handlers get 'buf' as a memoryview that is only valid until the next decode: copy (bytes(buf)) what you keep.
+    """
+
+    def __init__(self, open_new_port=True, com_port_name=None, channel=-1, existing_port=None):
+        if _flexsea is None:
+            raise ImportError('_flexsea is not built, run "python3 setup.py build_ext --inplace" in flexsea_python/')
+        self.port = _flexsea.Port()
+        super().__init__(None, open_new_port, com_port_name, channel, existing_port)
+
+    @staticmethod
+    def load_stack(dll_filename):
+        return _flexsea
+
+    def create_bytestream_from_cmd(self, cmd, rw, ack, payload_string):
+        if cmd < MIN_CMD_CODE or cmd > MAX_CMD_CODE:
+            return 1, [], 0
+        if isinstance(payload_string, str):
+            payload_string = payload_string.encode()
+        address = ADDR_NONE if self.address is None else self.address
+        try:
+            bytestream = _flexsea.encode(cmd, self.rw_dict[rw], self.ack_dict[ack], payload_string, address)
+        except ValueError:
+            return 1, [], 0
+        return 0, bytestream, len(bytestream)
+
+    def use_address(self, address):
+        self.address = address
+        self.port.address = ADDR_NONE if address is None else ADDR_HOST
+
+    def write_to_circular_buffer(self, bytestream, bytestream_len):
+        if bytestream_len <= 0:
+            return 1
+        if isinstance(bytestream, str):
+            bytestream = bytestream.encode()
+        elif isinstance(bytestream, int):
+            bytestream = bytes([bytestream])
+        if self.port.feed(bytestream[0:bytestream_len]) < bytestream_len:
+            print("feed(): buffer is full! Some bytes were dropped.")
+            return 1
+        return 0
+
+    def feed(self, data):
+        return self.port.feed(data)
+
+    def read_byte_from_circular_buffer(self):
+        return self.port.read_byte()
+
+    def get_circular_buffer_length(self):
+        return self.port.length
+
+    def reinit_circular_buffer(self):
+        self.port.reset()
+        return 0
+
+    def get_cmd_handler_from_bytestream(self):
+        decoded = self.port.decode()
+        if decoded is None:
+            return 1, 0, 0, 0, b'', 0
+        cmd_6bits, rw, ack, buf = decoded
+        return 0, cmd_6bits, rw, ack, buf, len(buf)
+
+    def cleanup(self):
+        self.port.cleanup()
+
+
+class AsyncFlexSEA:
+    """
+    asyncio front-end for a FlexSEAPython or FlexSEANative object. The serial port's fd is watched with
+    loop.add_reader(): bytes are fed and decoded as they arrive, and replies resolve the request() futures. One process
+    can keep many devices (one AsyncFlexSEA per port) in flight with asyncio.gather().
+    Needs a loop with add_reader() (any POSIX loop, or the SelectorEventLoop on Windows).
+    """
+
+    def __init__(self, fx, loop=None):
+        self.fx = fx
+        self.loop = loop or asyncio.get_event_loop()
+        self.pending = {}  # Futures waiting for a reply, by key (see request())
+        self.fd = fx.serial.serial_port.fileno()
+        self.loop.add_reader(self.fd, self.on_readable)
+
+    def close(self):
+        """
+        Stop watching the serial port. Pending requests are cancelled.
+        :return: N/A
+        """
+        self.loop.remove_reader(self.fd)
+        for futures in self.pending.values():
+            for future in futures:
+                future.cancel()
+        self.pending.clear()
+
+    async def request(self, cmd, rw="CmdRead", payload_string=b'', timeout=0.1, ack="Nack"):
+        """
+        Send a command and wait for the answer, without blocking the loop
+        :param cmd: command code
+        :param rw: string from 'rw_dict'. Reads wait for a reply with the same command code.
+        :param payload_string: data (bytes or string)
+        :param timeout: seconds, raises asyncio.TimeoutError when it expires
+        :param ack: "Ack" waits for the FX_CMD_ACK that matches this packet number instead
+        :return: decoded payload (bytes, data starts at CMD_OVERHEAD), None for a Write without Ack
+        """
+        ret_val, bytestream, bytestream_len = self.fx.create_bytestream_from_cmd(cmd=cmd, rw=rw, ack=ack,
+                                                                                 payload_string=payload_string)
+        if ret_val:
+            raise ValueError(f'Cannot encode command {cmd}')
+        if ack == "Ack":
+            key = (CMD_ACK, self.fx.fx.get_last_tx_packet_num() & 0x7FFF)
+        elif rw == "CmdRead" or rw == "CmdReadWrite":
+            key = (cmd, None)
+        else:
+            key = None
+        # No drain wait: the frame is short, the OS buffers it
+        self.fx.serial.serial_port.write(bytestream[0:bytestream_len])
+        if key is None:
+            return None
+        future = self.loop.create_future()
+        self.pending.setdefault(key, deque()).append(future)
+        return await asyncio.wait_for(future, timeout)
+
+    def on_readable(self):
+        """
+        add_reader() callback: feed the new bytes, then dispatch every complete frame
+        :return: N/A
+        """
+        self.fx.grab_new_bytes()
+        length = self.fx.get_circular_buffer_length()
+        while length > MIN_OVERHEAD:
+            ret_val, cmd_6bits_out, rw_out, ack_out, buf, buf_len = self.fx.get_cmd_handler_from_bytestream()
+            previous_length, length = length, self.fx.get_circular_buffer_length()
+            if ret_val:
+                if length < previous_length:
+                    continue    # Bytes were discarded, there could be a frame after them
+                break   # Incomplete frame, wait for more bytes
+            if cmd_6bits_out == CMD_ACK:
+                key = (CMD_ACK, bytes_to_uint16(buf[CMD_OVERHEAD + 1:CMD_OVERHEAD + 3]) & 0x7FFF)
+            else:
+                key = (cmd_6bits_out, None)
+            if not self.resolve(key, bytes(buf)):
+                # Nobody is waiting for it (streams, late replies): regular handler
+                self.fx.call_cmd_handler(cmd_6bits_out, rw_out, ack_out, buf)
+        self.fx.cleanup()
+
+    def resolve(self, key, payload):
+        """
+        Hand a reply to the oldest request waiting for it
+        :return: True if a request took it
+        """
+        futures = self.pending.get(key)
+        while futures:
+            future = futures.popleft()
+            if not future.done():  # Timed out requests are cancelled
+                future.set_result(payload)
+                return True
+        return False
+
+
+# Shared memory client, see flexsea_shm.h (Linux). This needs to match the C code!
+SHM_NAME_LEN = 64
+
+
+class FxShm(Structure):
+    _fields_ = [("region", c_void_p),
+                ("owner", c_uint8),
+                ("name", c_char * SHM_NAME_LEN)]
+
+
+class FxShmReader(Structure):
+    _fields_ = [("port", c_uint8),
+                ("cmd", c_uint8),
+                ("next", c_uint32),
+                ("lost", c_uint32),
+                ("t_rx_ns", c_uint64)]
+
+
+class FlexSEASharedMemory:
+    """
+    Client of the host daemon (demo/pc_daemon, Linux). The daemon owns the serial ports and publishes every frame it
+    decodes in shared memory, in one ring per port and command. Any number of processes (controller, logger, GUI) can
+    attach, follow the commands they care about and send frames, without opening a port. The C stack does the work:
+    load the same library as FlexSEAPython.
+    """
+
+    def __init__(self, dll_filename, name='/flexsea'):
+        self.fx = cdll.LoadLibrary(dll_filename)
+        self.shm = FxShm()
+        self.readers = {}  # Our position in each ring, by (port, cmd)
+        self._buf = (c_uint8 * MAX_ENCODED_PAYLOAD_BYTES)()
+        self._view = memoryview(self._buf).cast('B')
+        self._len = c_uint8(0)
+        if self.fx.fx_shm_attach(byref(self.shm), name.encode()):
+            raise ConnectionError(f'No FlexSEA daemon is serving {name}')
+
+    def close(self):
+        """
+        Unmap the shared memory
+        :return: N/A
+        """
+        self.fx.fx_shm_detach(byref(self.shm))
+
+    def follow(self, port, cmd):
+        """
+        Start following 'cmd' on 'port' (index on the daemon's command line). Only frames published from now on are
+        read. read() and wait() call it for you the first time.
+        :return: reader (FxShmReader). 'lost' counts the frames that were overwritten before we read them.
+        """
+        key = (port, cmd)
+        if key not in self.readers:
+            reader = FxShmReader()
+            if self.fx.fx_shm_reader_init(byref(self.shm), byref(reader), port, cmd):
+                raise ValueError(f'Invalid port ({port}) or command ({cmd})')
+            self.readers[key] = reader
+        return self.readers[key]
+
+    def read(self, port, cmd, latest=False):
+        """
+        Next frame, without blocking
+        :param latest: skip to the most recent frame (ex.: a GUI refresh)
+        :return: decoded payload (data starts at CMD_OVERHEAD), None if there is nothing new. It is a memoryview on a
+        buffer owned by this object: copy it (bytes()) if it has to outlive the next call.
+        """
+        fct = self.fx.fx_shm_read_latest if latest else self.fx.fx_shm_read
+        if fct(byref(self.shm), byref(self.follow(port, cmd)), self._buf, byref(self._len)):
+            return None
+        return self._view[:self._len.value]
+
+    def wait(self, port, cmd, timeout=0.1):
+        """
+        Sleep until a frame can be read (the GIL is released)
+        :param timeout: seconds
+        :return: True if a frame is waiting, False on timeout
+        """
+        return not self.fx.fx_shm_wait(byref(self.shm), byref(self.follow(port, cmd)), int(timeout * 1e6))
+
+    def write(self, port, bytestream, bytestream_len=None):
+        """
+        Queue a bytestream (create_bytestream_from_cmd()) for the daemon to send on 'port'
+        :return: True if it was queued, False if the queue is full
+        """
+        data = bytes(bytestream if bytestream_len is None else bytestream[0:bytestream_len])
+        return not self.fx.fx_shm_tx_push(byref(self.shm), port, data, len(data))
+
+
 class CommHardware:
     """
     Some applications have more than one channel per serial port.
@@ -493,6 +1069,7 @@ class CommHardware:
         self.configured = True
 
     def use_channel(self, desired_ch):
+        # With multi-drop addressing (FlexSEAPython.use_address()), devices can share one channel
         if self.configured:
             if desired_ch == 0:
                 self.rs485_de[0].set_value(self.TX_ON)
@@ -101,3 +101,234 @@ def identical_ctype_structs(struct_a, struct_b):
 # Clamps a value between a lower and an upper bound.
 def clamp_value(value, lower_bound, upper_bound):
   return max(lower_bound, min(value, upper_bound))
+
+
+# Event trace (flexsea_trace.h). Each event is 8 bytes: [TIMESTAMP (uint32)][EVENT][PORT][ARG (uint16)]
+TRACE_EVENT_SIZE = 8
+TRACE_EVENT_NAMES = {1: 'FRAME_START', 2: 'DECODE_OK', 3: 'DECODE_FAIL', 4: 'HANDLER_ENTER', 5: 'HANDLER_EXIT',
+                     6: 'TX_QUEUED', 7: 'TX_START', 8: 'TX_COMPLETE'}
+
+
+def decode_trace(data):
+    """
+    Unpack trace events
+    :param data: bytes, a multiple of TRACE_EVENT_SIZE
+    :return: list of (timestamp, event, port, arg) tuples
+    """
+    return [struct.unpack_from('<IBBH', data, i) for i in range(0, len(data) - TRACE_EVENT_SIZE + 1,
+                                                                  TRACE_EVENT_SIZE)]
+
+
+def format_trace(events, timestamp_hz):
+    """
+    Turn trace events into a readable timeline. Times are in us, relative to the first event.
+    :param events: list from decode_trace()
+    :param timestamp_hz: timestamp frequency reported by the device
+    :return: list of strings, one per event
+    """
+    lines = []
+    if not events:
+        return lines
+    t0 = prev = events[0][0]
+    for timestamp, event, port, arg in events:
+        # Timestamps are 32-bit and wrap
+        t = ((timestamp - t0) & 0xFFFFFFFF) * 1e6 / timestamp_hz
+        dt = ((timestamp - prev) & 0xFFFFFFFF) * 1e6 / timestamp_hz
+        name = TRACE_EVENT_NAMES.get(event, f'USER_{event}')
+        lines.append(f'{t:12.1f} us  (+{dt:9.1f})  port {port}  {name:<14} {arg}')
+        prev = timestamp
+    return lines
+
+
+# Stage latencies (flexsea_profile.h): [TIMESTAMP_HZ (uint32)][N][N x (COUNT, P50, P99, MAX)], all uint32
+PROFILE_STAGE_NAMES = ['decode', 'parse', 'handler', 'encode']
+
+
+def decode_profile(data):
+    """
+    Unpack a latency summary. Times are converted to us.
+    :param data: bytes, FX_DIAG_PROFILE reply (after the selector)
+    :return: dictionary {stage name: {'count', 'p50_us', 'p99_us', 'max_us'}}
+    """
+    timestamp_hz, n = struct.unpack_from('<IB', data, 0)
+    profile = {}
+    for i in range(n):
+        count, p50, p99, max_ticks = struct.unpack_from('<4I', data, 5 + 16 * i)
+        name = PROFILE_STAGE_NAMES[i] if i < len(PROFILE_STAGE_NAMES) else f'stage_{i}'
+        scale = 1e6 / timestamp_hz if timestamp_hz else 0
+        profile[name] = {'count': count, 'p50_us': p50 * scale, 'p99_us': p99 * scale, 'max_us': max_ticks * scale}
+    return profile
+
+
+# Clock synchronisation (FX_CMD_TIME_SYNC). This follows NTP: the host sends T1, the device notes T2 when it
+# receives the request and T3 when it replies, the host notes T4. Host times are in seconds, device times in ticks
+# of a free-running 32-bit counter.
+class ClockSync:
+
+    def __init__(self, window=32):
+        """
+        :param window: number of exchanges kept for the fit
+        """
+        self.window = window
+        self.samples = []  # (device_s, host_s, round_trip_s)
+        self.timestamp_hz = 0
+        self.last_ticks = None
+        self.ticks = 0  # Unwrapped device counter
+        self.offset = 0.0  # host_s = offset + rate * device_s
+        self.rate = 1.0
+
+    def unwrap(self, ticks, update=True):
+        """
+        Extend a 32-bit device timestamp. Exchanges must be closer than half a counter period (25 s at 170 MHz).
+        """
+        if self.last_ticks is None:
+            extended = ticks
+        else:
+            delta = (ticks - self.last_ticks) & 0xFFFFFFFF
+            if delta >= 0x80000000:
+                delta -= 0x100000000  # Slightly in the past
+            extended = self.ticks + delta
+        if update:
+            self.last_ticks = ticks
+            self.ticks = extended
+        return extended
+
+    def add_sample(self, t1, t2, t3, t4, timestamp_hz):
+        """
+        Add one exchange and update the estimate
+        :param t1: host transmit time (s)
+        :param t2: device receive time (ticks)
+        :param t3: device transmit time (ticks)
+        :param t4: host receive time (s)
+        :param timestamp_hz: device timestamp frequency
+        :return: round trip time (s), device processing excluded
+        """
+        self.timestamp_hz = timestamp_hz
+        d2 = self.unwrap(t2) / timestamp_hz
+        d3 = self.unwrap(t3) / timestamp_hz
+        round_trip = (t4 - t1) - (d3 - d2)
+        self.samples.append(((d2 + d3) / 2, (t1 + t4) / 2, round_trip))
+        self.samples = self.samples[-self.window:]
+        self.fit()
+        return round_trip
+
+    def fit(self):
+        """
+        Least squares fit of host time vs device time. Exchanges that took much longer than the best one were delayed
+        on one side or the other; we leave them out.
+        """
+        best = min(s[2] for s in self.samples)
+        good = [s for s in self.samples if s[2] <= 2 * best + 1e-4]
+        if len(good) < 2 or good[-1][0] == good[0][0]:
+            device_s, host_s, _ = good[-1]
+            self.offset = host_s - self.rate * device_s
+            return
+        n = len(good)
+        mean_d = sum(s[0] for s in good) / n
+        mean_h = sum(s[1] for s in good) / n
+        num = sum((s[0] - mean_d) * (s[1] - mean_h) for s in good)
+        den = sum((s[0] - mean_d) ** 2 for s in good)
+        self.rate = num / den
+        self.offset = mean_h - self.rate * mean_d
+
+    @property
+    def drift_ppm(self):
+        """Device clock error, in ppm. Positive: the device clock is slow."""
+        return (self.rate - 1.0) * 1e6
+
+    @property
+    def min_round_trip(self):
+        """Best round trip (s). Half of it bounds the error on the offset."""
+        return min(s[2] for s in self.samples) if self.samples else None
+
+    def device_to_host(self, ticks):
+        """
+        Convert a device timestamp (FX_TIMESTAMP(), ex.: in a stream or a trace) to host time
+        :param ticks: 32-bit device timestamp
+        :return: host time (s), or None before the first exchange
+        """
+        if not self.samples:
+            return None
+        return self.offset + self.rate * self.unwrap(ticks, update=False) / self.timestamp_hz
+
+    def host_to_device(self, host_s):
+        """
+        Convert a host time (time.monotonic()) to a 32-bit device timestamp, ex.: for FX_CMD_SCHEDULE
+        :param host_s: host time (s)
+        :return: device timestamp, or None before the first exchange
+        """
+        if not self.samples:
+            return None
+        return round((host_s - self.offset) / self.rate * self.timestamp_hz) & 0xFFFFFFFF
+
+
+# Delta (on-change) decoder. This matches flexsea_delta.c.
+# Keyframe: [0x80 | ID][FULL STRUCTURE...]
+# Delta:    [ID][FIELD BITMAP...][CHANGED FIELDS...]
+class DeltaDecoder:
+    KEYFRAME = 0x80
+    ID_MASK = 0x7F
+
+    def __init__(self, field_sizes):
+        """
+        :param field_sizes: size of each field, in bytes. Use from_structure() for ctypes structures.
+        """
+        self.field_sizes = list(field_sizes)
+        self.obj_size = sum(self.field_sizes)
+        self.bitmap_bytes = (len(self.field_sizes) + 7) // 8
+        # We keep the last two keyframes received (FX_DELTA_KEYFRAMES): {id: bytes}
+        self.keyframes = {}
+        self.last_id = None
+
+    @classmethod
+    def from_structure(cls, structure):
+        """
+        Build a decoder from a packed ctypes Structure class
+        """
+        import ctypes
+        return cls([ctypes.sizeof(field_type) for _, field_type in structure._fields_])
+
+    def ack(self):
+        """
+        Ack byte for the last keyframe received ([0x80 | ID]). Send it back to the device with your
+        requests (it's harmless to repeat), it gives it to fx_delta_ack().
+        :return: the byte, or None if we haven't received a keyframe yet
+        """
+        if self.last_id is None:
+            return None
+        return self.KEYFRAME | self.last_id
+
+    def decode(self, data):
+        """
+        Rebuild the full structure
+        :param data: delta-encoded payload (bytes)
+        :return: the full structure as bytes, or None if it refers to a keyframe we didn't receive
+        """
+        if len(data) < 1:
+            return None
+        key_id = data[0] & self.ID_MASK
+
+        if data[0] & self.KEYFRAME:
+            if len(data) < 1 + self.obj_size:
+                return None
+            obj = bytes(data[1:1 + self.obj_size])
+            # Like fx_delta_decode(): the previous keyframe is always replaced, even by one with the same ID
+            if self.last_id is not None:
+                self.keyframes = {self.last_id: self.keyframes[self.last_id]}
+            self.keyframes[key_id] = obj
+            self.last_id = key_id
+            return obj
+
+        if key_id not in self.keyframes or len(data) < 1 + self.bitmap_bytes:
+            return None
+        obj = bytearray(self.keyframes[key_id])
+        idx = 1 + self.bitmap_bytes
+        offset = 0
+        for i, size in enumerate(self.field_sizes):
+            if data[1 + (i >> 3)] & (1 << (i & 7)):
+                if idx + size > len(data):
+                    return None
+                obj[offset:offset + size] = data[idx:idx + size]
+                idx += size
+            offset += size
+        return bytes(obj)
@@ -0,0 +1,16 @@
+# Builds the native binding (_flexsea), the same C stack as the DLL but called without ctypes.
+# In this folder: python3 setup.py build_ext --inplace
+# Then use FlexSEANative instead of FlexSEAPython (flexsea_python.py).
+import glob
+import os
+from setuptools import setup, Extension
+
+here = os.path.dirname(os.path.abspath(__file__))
+os.chdir(here)
+stack_sources = sorted(glob.glob(os.path.join('..', 'src', '*.c')))
+
+setup(
+    name='flexsea_native',
+    ext_modules=[Extension('_flexsea', sources=['_flexsea.c'] + stack_sources,
+                           include_dirs=[os.path.join('..', 'inc')])],
+)
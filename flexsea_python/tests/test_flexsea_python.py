@@ -1,5 +1,7 @@
 import sys
 import unittest
+import asyncio
+import socket
 
 # Add the FlexSEA path to this project
 sys.path.append('../flexsea_python')
@@ -146,5 +148,201 @@ class TestFlexSEAPython(unittest.TestCase):
         self.assertEqual(self.cb_len, 0)
 
 
+class TestDeltaDecoder(unittest.TestCase):
+
+    def test_delta_decoder(self):
+        """Can we rebuild structures from keyframes and deltas? (No shared library needed)"""
+        dd = DeltaDecoder([1, 4, 1, 2, 4])
+        keyframe = bytes(range(12))
+
+        # Keyframe #0
+        self.assertIsNone(dd.ack())
+        self.assertEqual(dd.decode(bytes([0x80]) + keyframe), keyframe)
+        self.assertEqual(dd.ack(), 0x80)
+        # Delta relative to #0, field 3 changed
+        self.assertEqual(dd.decode(bytes([0, 0b1000, 9, 9])), keyframe[0:6] + bytes([9, 9]) + keyframe[8:])
+        # Delta relative to a keyframe we never received
+        self.assertIsNone(dd.decode(bytes([1, 0])))
+        # Keyframe #1, repeated: like the C decoder, #0 is gone
+        self.assertEqual(dd.decode(bytes([0x81]) + keyframe), keyframe)
+        self.assertEqual(dd.decode(bytes([0, 0])), keyframe)
+        self.assertEqual(dd.decode(bytes([0x81]) + keyframe[::-1]), keyframe[::-1])
+        self.assertIsNone(dd.decode(bytes([0, 0])))
+        self.assertEqual(dd.decode(bytes([1, 0])), keyframe[::-1])
+
+
+class TestTrace(unittest.TestCase):
+
+    def test_decode_trace(self):
+        """Can we decode trace events and build a timeline? (No shared library needed)"""
+        import struct
+        data = struct.pack('<IBBH', 0xFFFFFFF0, 1, 0, 12) + struct.pack('<IBBH', 0x10, 2, 0, 5)
+        events = decode_trace(data)
+        self.assertEqual(events, [(0xFFFFFFF0, 1, 0, 12), (0x10, 2, 0, 5)])
+        lines = format_trace(events, 1000000)
+        self.assertEqual(len(lines), 2)
+        self.assertIn('FRAME_START', lines[0])
+        self.assertIn('32.0 us', lines[1])   # Timestamp wrapped
+
+
+class TestClockSync(unittest.TestCase):
+
+    def test_clock_sync(self):
+        """Offset, drift and counter wrap (No shared library needed)"""
+        hz = 1000000
+        drift = 100e-6  # Device runs 100 ppm fast
+
+        def device(host_s):
+            return int((host_s - 10) * hz * (1 + drift) + 0xFFF00000) & 0xFFFFFFFF
+
+        cs = ClockSync()
+        for i in range(10):
+            t1 = 10 + i
+            t2 = device(t1 + 0.001)
+            t3 = device(t1 + 0.0012)
+            round_trip = cs.add_sample(t1, t2, t3, t1 + 0.0022, hz)
+            self.assertAlmostEqual(round_trip, 0.002, places=5)
+        self.assertAlmostEqual(cs.drift_ppm, -100, delta=1)
+        self.assertAlmostEqual(cs.device_to_host(device(19.5)), 19.5, places=5)
+        self.assertLessEqual(abs(cs.host_to_device(20.5) - device(20.5)), 2)
+
+
+class TestProfile(unittest.TestCase):
+
+    def test_decode_profile(self):
+        """Can we decode a latency summary? (No shared library needed)"""
+        import struct
+        data = struct.pack('<IB', 1000000, 2) + struct.pack('<4I', 10, 3, 7, 9) + struct.pack('<4I', 0, 0, 0, 0)
+        profile = decode_profile(data)
+        self.assertEqual(list(profile.keys()), ['decode', 'parse'])
+        self.assertEqual(profile['decode'], {'count': 10, 'p50_us': 3.0, 'p99_us': 7.0, 'max_us': 9.0})
+        self.assertEqual(profile['parse']['count'], 0)
+
+
+class TestNative(unittest.TestCase):
+
+    def setUp(self):
+        try:
+            import _flexsea
+        except ImportError:
+            self.skipTest('_flexsea is not built (setup.py)')
+        self.native = _flexsea
+
+    def test_feed_and_decode(self):
+        """Frames in, memoryviews out (no serial port or DLL needed)"""
+        port = self.native.Port()
+        frame = self.native.encode(12, 2, 0, b'hello')
+        self.assertEqual(port.feed(frame + frame), 2 * len(frame))
+        cmd, rw, ack, payload = port.decode()
+        self.assertEqual((cmd, rw, ack), (12, 2, 0))
+        self.assertIsInstance(payload, memoryview)
+        self.assertEqual(bytes(payload[3:]), b'hello')
+        self.assertIsNotNone(port.decode())
+        self.assertIsNone(port.decode())
+        self.assertEqual(port.length, 0)
+
+    def test_address_filter(self):
+        """A host port only decodes the frames sent to the host"""
+        port = self.native.Port(address=0)
+        port.feed(self.native.encode(12, 2, 0, b'a', 7) + self.native.encode(12, 2, 0, b'b', 0))
+        cmd, rw, ack, payload = port.decode()
+        self.assertEqual(bytes(payload[3:]), b'b')
+        self.assertEqual(port.last_address, 0)
+
+    def test_encode_into(self):
+        """Encoding in a buffer we own gives the same frame"""
+        out = bytearray(self.native.MAX_ENCODED_PAYLOAD_BYTES)
+        n = self.native.encode_into(out, 12, 1, 0, b'xyz')
+        self.assertEqual(n, len(self.native.encode(12, 1, 0, b'xyz')))
+        self.assertEqual(out[0], 0xED)
+        self.assertRaises(ValueError, self.native.encode, 64, 1, 0, b'')
+
+class SocketPort:
+    """Stands in for a pyserial object: one end of a socket pair"""
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.sock.setblocking(False)
+
+    @property
+    def in_waiting(self):
+        try:
+            return len(self.sock.recv(4096, socket.MSG_PEEK))
+        except BlockingIOError:
+            return 0
+
+    def read(self, count):
+        return self.sock.recv(count)
+
+    def write(self, data):
+        self.sock.sendall(data)
+
+    def fileno(self):
+        return self.sock.fileno()
+
+
+class TestAsync(unittest.TestCase):
+
+    def setUp(self):
+        try:
+            import _flexsea
+        except ImportError:
+            self.skipTest('_flexsea is not built (setup.py)')
+        from flexsea_python import FlexSEANative, FlexSEASerial
+        self.native = _flexsea
+        host, self.device = socket.socketpair()
+        self.loop = asyncio.new_event_loop()
+        self.serial = FlexSEASerial()
+        self.serial.serial_port = SocketPort(host)
+        self.fx = FlexSEANative(open_new_port=False, existing_port=self.serial)
+
+    def tearDown(self):
+        self.loop.close()
+        self.device.close()
+        self.serial.serial_port.sock.close()
+
+    def test_request_reply(self):
+        """A read resolves when its reply arrives, unsolicited frames go to the handlers"""
+        from flexsea_python import AsyncFlexSEA
+        streamed = []
+        self.fx.register_cmd_handler(13, lambda cmd, rw, ack, buf: streamed.append(bytes(buf[3:])))
+
+        async def run():
+            afx = AsyncFlexSEA(self.fx, self.loop)
+            reply = asyncio.ensure_future(afx.request(12, "CmdRead", b'ping', timeout=1.0))
+            await asyncio.sleep(0)
+            port = self.native.Port()
+            port.feed(self.device.recv(256))
+            self.assertEqual(port.decode()[0:2], (12, 1))
+            self.device.sendall(self.native.encode(13, 2, 0, b'stream') + self.native.encode(12, 2, 0, b'pong'))
+            payload = await reply
+            afx.close()
+            return payload
+
+        payload = self.loop.run_until_complete(run())
+        self.assertEqual(payload[3:], b'pong')
+        self.assertEqual(streamed, [b'stream'])
+
+    def test_timeout(self):
+        """No reply: the request times out, and a late reply doesn't resolve the next one"""
+        from flexsea_python import AsyncFlexSEA
+
+        async def run():
+            afx = AsyncFlexSEA(self.fx, self.loop)
+            with self.assertRaises(asyncio.TimeoutError):
+                await afx.request(12, "CmdRead", b'', timeout=0.01)
+            self.device.sendall(self.native.encode(12, 2, 0, b'late'))
+            await asyncio.sleep(0.01)
+            reply = asyncio.ensure_future(afx.request(12, "CmdRead", b'', timeout=1.0))
+            await asyncio.sleep(0)
+            self.device.sendall(self.native.encode(12, 2, 0, b'new'))
+            payload = await reply
+            afx.close()
+            return payload
+
+        self.fx.register_cmd_handler(12, lambda cmd, rw, ack, buf: None)
+        self.assertEqual(self.loop.run_until_complete(run())[3:], b'new')
+
+
 if __name__ == '__main__':
     unittest.main()
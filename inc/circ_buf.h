@@ -27,6 +27,7 @@ typedef struct circ_buf
 
 uint8_t circ_buf_init(circ_buf_t *cb);
 uint8_t circ_buf_write_byte(circ_buf_t *cb, uint8_t new_value);
+uint16_t circ_buf_write(circ_buf_t *cb, const uint8_t *values, uint16_t len);
 uint8_t circ_buf_read_byte(circ_buf_t *cb, uint8_t *read_value);
 uint8_t circ_buf_peek(circ_buf_t *cb, uint8_t *read_value, uint16_t offset);
 uint8_t circ_buf_search(circ_buf_t *cb, uint16_t *search_result, uint8_t value,
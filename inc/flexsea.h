@@ -44,6 +44,13 @@ extern "C" {
 #include <flexsea_command.h>
 #include <flexsea_comm.h>
 #include <flexsea_tools.h>
+#include <flexsea_delta.h>
+#include <flexsea_profile.h>
+#include <flexsea_trace.h>
+#include <flexsea_bus.h>
+#include <flexsea_route.h>
+#include <flexsea_serial.h>
+#include <flexsea_shm.h>
 
 //****************************************************************************
 // Definition(s):
@@ -60,6 +67,10 @@ extern "C" {
 uint8_t fx_create_bytestream_from_cmd(uint8_t cmd_6bits, ReadWrite rw,
 		AckNack ack, uint8_t *buf_in, uint8_t buf_in_len, uint8_t* bytestream,
 		uint8_t *bytestream_len);
+uint8_t fx_create_bytestream_from_cmd_addr(uint8_t addr, uint8_t cmd_6bits,
+		ReadWrite rw, AckNack ack, uint8_t *buf_in, uint8_t buf_in_len,
+		uint8_t* bytestream, uint8_t *bytestream_len);
+uint16_t fx_feed(circ_buf_t *cb, const uint8_t *bytes, uint16_t len);
 uint8_t fx_get_cmd_handler_from_bytestream(circ_buf_t *cb,
 		uint8_t *cmd_6bits, ReadWrite *rw, AckNack *ack, uint8_t *buf,
 		uint8_t *buf_len);
@@ -0,0 +1,112 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jfduval at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_bus: poll scheduler for multiplexed half-duplex channels
+ ****************************************************************************/
+
+#ifndef INC_FX_BUS_H
+#define INC_FX_BUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include <flexsea_comm.h>
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+#define FX_BUS_MAX_POLLS	16		//Entries in the poll table
+#define FX_BUS_POLL_BYTES	24		//Data bytes per poll request
+#define FX_BUS_NO_CHANNEL	0xFF
+
+//Direction, see the 'select' callback
+#define FX_BUS_RX			0
+#define FX_BUS_TX			1
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+//One request of the poll table
+typedef struct FxBusPoll
+{
+	uint8_t channel;			//Logical channel (transceiver)
+	uint8_t addr;				//Destination, FX_ADDR_NONE if the channel is point-to-point
+	uint8_t cmd;
+	ReadWrite rw;				//Write without Ack: we don't wait for a reply
+	AckNack ack;
+	uint8_t len;
+	uint8_t data[FX_BUS_POLL_BYTES];
+	uint32_t replies;			//Answered in time
+	uint32_t timeouts;			//No answer within 'timeout_us'
+}FxBusPoll;
+
+typedef enum {
+	BusIdle,		//Ready to send the next request
+	BusWaitReply	//Request sent, listening
+} FxBusState;
+
+//N logical channels behind one UART. The scheduler goes through the poll
+//table, selects each channel with the 'select' callback and waits for the
+//reply (or a timeout) before moving on.
+typedef struct FxBus
+{
+	CommPort *cp;				//UART: tx_fct_prt and reception
+	void (*select)(uint8_t channel, uint8_t dir);	//Drives DE/RE
+	uint32_t timeout_us;
+	FxBusPoll poll[FX_BUS_MAX_POLLS];
+	uint8_t polls;
+	FxBusState state;
+	uint8_t current;			//Poll in progress
+	uint8_t channel;			//Selected channel
+	uint32_t sent_us;			//When we sent the current request
+	TxFrame next;				//Next request, encoded ahead of time
+	uint8_t next_poll;			//Poll 'next' was encoded for, FX_BUS_MAX_POLLS if none
+	uint32_t cycles;			//Completed passes through the table
+}FxBus;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+void fx_bus_init(FxBus *bus, CommPort *cp,
+		void (*select)(uint8_t channel, uint8_t dir), uint32_t timeout_us);
+uint8_t fx_bus_add_poll(FxBus *bus, uint8_t channel, uint8_t addr,
+		uint8_t cmd, ReadWrite rw, AckNack ack, uint8_t *data, uint8_t len);
+uint8_t fx_bus_run(FxBus *bus, uint32_t now_us);
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//INC_FX_BUS_H
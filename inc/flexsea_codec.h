@@ -44,6 +44,18 @@ extern "C" {
 #define FOOTER  						0xEE	//238d
 #define ESCAPE  						0xE9	//233d
 
+//Multi-drop addressing (first payload byte, see fx_encode_addr()). Addresses
+//stay below ESCAPE so they never need to be escaped.
+#define FX_ADDR_HOST					0x00	//Replies go to the host
+#define FX_ADDR_NODE_MAX				0xDF	//Highest node address
+#define FX_ADDR_GROUP_0					0xE0	//8 groups, see fx_codec_set_rx_groups()
+#define FX_ADDR_GROUPS					8
+#define FX_ADDR_BROADCAST				0xE8	//Every node
+#define FX_ADDR_MAX						0xE8	//Highest valid address
+#define FX_ADDR_NONE					0xFF	//Point-to-point link, no address
+#define FX_ADDR_GROUP(n)				(FX_ADDR_GROUP_0 + (n))
+#define FX_ADDR_IS_MULTICAST(a)			(((a) >= FX_ADDR_GROUP_0) && ((a) <= FX_ADDR_BROADCAST))
+
 //Buffers and packets:
 #define MIN_OVERHEAD					4		//Header + Footer + Checksum + # bytes
 #define MAX_ENCODED_PAYLOAD_BYTES		200		//Max number of bytes in a packed payload
@@ -52,6 +64,17 @@ extern "C" {
 //so we recommend keeping some margin.
 //Some variables are uint8, do not exceed 256 bytes!
 
+//Codec counters, see fx_codec_attach_stats()
+typedef struct fx_codec_stats_t
+{
+	uint32_t frames_decoded;		//Valid frames extracted by fx_decode()
+	uint32_t checksum_errors;		//Header and footer found, bad checksum
+	uint32_t footer_errors;			//Header found, no footer where expected
+	uint32_t bytes_discarded;		//Noise and bad frames flushed from the buffer
+	uint32_t escapes_encoded;		//ESCAPE bytes added by fx_encode()
+	uint32_t frames_filtered;		//Frames for other nodes (multi-drop)
+}fx_codec_stats_t;
+
 //****************************************************************************
 // Public Function Prototype(s):
 //****************************************************************************
@@ -59,9 +82,18 @@ extern "C" {
 uint8_t fx_encode(uint8_t *payload, uint8_t payload_len,
 		uint8_t *encoded_payload, uint8_t *encoded_payload_len,
 				uint8_t max_encoded_payload_len);
+uint8_t fx_encode_addr(uint8_t addr, uint8_t *payload, uint8_t payload_len,
+		uint8_t *encoded_payload, uint8_t *encoded_payload_len,
+		uint8_t max_encoded_payload_len);
 uint8_t fx_decode(circ_buf_t *cb, uint8_t *encoded, uint8_t *encoded_len,
 		uint8_t *decoded, uint8_t *decoded_len);
+uint8_t fx_unescape(uint8_t *encoded, uint8_t encoded_len, uint8_t addressed,
+		uint8_t *decoded, uint8_t *decoded_len);
 uint8_t fx_cleanup(circ_buf_t *cb);
+void fx_codec_attach_stats(fx_codec_stats_t *stats);
+void fx_codec_set_rx_address(uint8_t addr);
+void fx_codec_set_rx_groups(uint8_t groups);
+uint8_t fx_codec_get_last_rx_address(void);
 
 //****************************************************************************
 // Structure(s):
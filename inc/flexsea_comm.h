@@ -41,19 +41,163 @@ extern "C" {
 
 #define DBUF_MAX_LEN	256
 
+//Periodic streams (device-pushed commands)
+#define FX_STREAMS_MAX	4		//Number of simultaneous subscriptions per port
+
+//Pending replies and acks
+#define FX_REPLYQ_DEPTH	8		//Must be a power of 2
+
+//Transmit queue
+#define FX_TXQ_DEPTH	2		//Frames per priority class. Must be a power of 2.
+
+//Pending replies keep the first data bytes of the request (stack commands)
+#define FX_REPLY_ARG_BYTES	3
+
+//FX_CMD_DIAG selectors (first data byte)
+#define FX_DIAG_STATS	0		//Read: port counters. Write: reset them.
+#define FX_DIAG_TRACE	1		//Read [FIRST (uint16)]: trace page. Write [CTRL].
+#define FX_DIAG_PROFILE	2		//Read: stage latencies. Write: reset them.
+#define FX_TRACE_EVENTS_PER_PAGE	10	//Escapes can double the size, keep margin
+
+//Frames sent by a port on a multi-drop bus go to the host
+#define FX_REPLY_ADDR(cp)	(((cp)->addr == FX_ADDR_NONE) ? FX_ADDR_NONE : FX_ADDR_HOST)
+
+//FX_CMD_TIME_SYNC: the host timestamp is opaque to us, we echo it
+#define FX_TSYNC_HOST_BYTES	8
+
+//FX_CMD_SCHEDULE
+#define FX_SCHED_DEPTH		4		//Commands waiting for their time, per port
+#define FX_SCHED_MAX_BYTES	32		//Embedded command, header included
+
+//FX_CMD_TDMA
+#define FX_TDMA_NO_SLOT			0xFF	//Default: we don't take part in TDMA cycles
+#define FX_TDMA_NO_CMD			0xFF	//Nothing is queued at the beacon
+#define FX_TDMA_FRAMES_PER_SLOT	1		//Size your slots for this many frames
+
 //****************************************************************************
 // Structure(s):
 //****************************************************************************
 
+//One periodic stream: 'cmd' gets sent every 'period_ms' until unsubscribed
+typedef struct StreamSlot
+{
+	uint8_t active;				//Is this slot in use?
+	uint8_t started;			//Did we send the first sample?
+	uint8_t cmd;				//Command code to stream
+	uint16_t period_ms;			//Streaming period
+	uint32_t last_ms;			//Last time we scheduled this stream
+}StreamSlot;
+
+//Something we owe the host: a reply to a read, or an ack to a write
+typedef enum {
+	ReplyData,		//Read or ReadWrite: send the data associated with 'cmd'
+	ReplyAck		//Write with Ack request: acknowledge 'packet_num'
+} ReplyType;
+
+typedef struct ReplyDesc
+{
+	ReplyType type;
+	uint8_t cmd;				//Command we are answering
+	uint8_t arg[FX_REPLY_ARG_BYTES];	//First data bytes (stack commands)
+	AckNack ack;				//Did the host request an Ack?
+	uint16_t packet_num;		//Packet number we are answering
+}ReplyDesc;
+
+//Ring of pending replies, filled by fx_receive() and drained by your transmit
+//function
+typedef struct ReplyQueue
+{
+	ReplyDesc desc[FX_REPLYQ_DEPTH];
+	uint8_t wr;
+	uint8_t rd;
+}ReplyQueue;
+
+//Transmit priority classes, highest first
+typedef enum {
+	TxControl,		//Acks, setpoints: anything a control loop is waiting for
+	TxReply,		//Replies to reads
+	TxBulk,			//Streams, parameter dumps: anything that can wait
+	TX_CLASSES
+} TxClass;
+
+//One encoded frame, ready to be sent
+typedef struct TxFrame
+{
+	uint8_t len;
+	uint8_t data[MAX_ENCODED_PAYLOAD_BYTES];
+}TxFrame;
+
+//Per-port transmit queue. Each class is a small ring of encoded frames. The
+//main loop only moves 'wr', the sender (possibly an ISR) only moves 'rd'.
+typedef struct TxQueue
+{
+	TxFrame frame[TX_CLASSES][FX_TXQ_DEPTH];
+	volatile uint8_t wr[TX_CLASSES];
+	volatile uint8_t rd[TX_CLASSES];
+	uint8_t async;					//Set if tx_fct_prt returns before the frame is out
+	volatile uint8_t busy;			//Asynchronous transmission in progress
+	volatile uint8_t done;			//Set by fx_comm_tx_done(), traced by the main loop
+	volatile uint32_t t_done;		//FX_TIMESTAMP() of the completion (tracing)
+	uint8_t sending;				//Class of the frame in flight
+}TxQueue;
+
+//Pending time synchronisation request (FX_CMD_TIME_SYNC)
+typedef struct TimeSync
+{
+	uint8_t t1[FX_TSYNC_HOST_BYTES];	//Host transmit time, echoed
+	uint32_t t2;				//Our receive time, FX_TIMESTAMP()
+}TimeSync;
+
+//A command waiting for its execution time (FX_CMD_SCHEDULE)
+typedef struct ScheduledCmd
+{
+	uint8_t active;
+	uint8_t quiet;				//Received as a multicast: no reply
+	uint32_t at;				//Execution time, FX_TIMESTAMP() ticks
+	uint8_t len;
+	uint8_t data[FX_SCHED_MAX_BYTES];	//[CMD|RW][ACK|PNUM][PNUM][DATA...]
+}ScheduledCmd;
+
+//Time-slotted bus mode (FX_CMD_TDMA). A beacon starts a cycle of 'slots'
+//slots, and we only transmit in ours.
+typedef struct TdmaState
+{
+	uint8_t slot;				//Our slot, FX_TDMA_NO_SLOT if we don't take part
+	uint8_t cmd;				//Queued at every beacon, or FX_TDMA_NO_CMD
+	uint8_t active;				//Set by a beacon, cleared by an empty one
+	uint8_t slots;				//Slots per cycle
+	uint8_t sent;				//Frames sent in this cycle
+	uint32_t slot_ticks;		//Slot length, FX_TIMESTAMP() ticks
+	uint32_t start;				//Beacon reception time, FX_TIMESTAMP()
+	uint32_t beacons;			//Beacons received
+}TdmaState;
+
+//Last frame decoded by fx_receive(), see fx_wait_for_reply()
+typedef struct RxLast
+{
+	uint32_t count;				//Frames decoded so far
+	uint8_t cmd;
+	uint16_t acked;				//FX_CMD_ACK frames: packet number acknowledged
+}RxLast;
+
+//Link health counters. Read them with FX_CMD_DIAG / FX_DIAG_STATS.
+typedef struct fx_port_stats_t
+{
+	uint32_t bytes_received;		//Bytes moved from the ping-pong buffers
+	uint32_t rx_overflows;			//Bytes refused by a full circular buffer
+	fx_codec_stats_t codec;			//Decoding and encoding (flexsea_codec)
+	uint32_t frames_sent;			//Frames sent by fx_comm_process_tx_queue()
+	uint32_t replies_dropped;		//Reply queue was full
+	uint32_t frames_dropped[TX_CLASSES];	//TX queue class was full
+}fx_port_stats_t;
+
 //This structure holds all the info about a communication port
 typedef struct CommPort
 {
 	uint8_t id;					//Port identification
-	uint8_t send_reply;			//Do we have a reply to send?
-	uint8_t reply_cmd;			//What is it?
-	uint8_t send_ack;			//Do we need to acknowledge a Write?
-	uint8_t ack_cmd;			//Command code we are acknowledging
-	uint16_t ack_packet_num;	//Packet number we are acknowledging
+	uint8_t addr;				//Our address on a multi-drop bus, FX_ADDR_NONE (default) otherwise
+	uint8_t groups;				//Multicast groups we belong to, bit n for FX_ADDR_GROUP(n)
+	ReplyQueue replyq;			//Replies and acks we need to send
 	circ_buf_t *cb;				//Reception circular buffer
 	uint8_t (*tx_fct_prt) (uint8_t *, uint16_t);	//TX function
 	//Double buffering with ping-pong buffers
@@ -62,14 +206,54 @@ typedef struct CommPort
 	volatile uint8_t dbuf_lock[2];
 	volatile uint32_t dbuf_len[2];
 	volatile uint8_t dbuf_selected;
+	//Periodic streams
+	StreamSlot stream[FX_STREAMS_MAX];
+	//Prioritized transmission
+	TxQueue txq;
+	//Link health
+	fx_port_stats_t stats;
+	//Clock synchronisation
+	TimeSync tsync;
+	//Commands scheduled for later
+	ScheduledCmd sched[FX_SCHED_DEPTH];
+	//Time-slotted bus mode
+	TdmaState tdma;
+	RxLast rx_last;
 }CommPort;
 
 //****************************************************************************
 // Public Function Prototype(s):
 //****************************************************************************
 
+void fx_comm_port_init(CommPort *cp, uint8_t id, circ_buf_t *cb,
+		uint8_t (*tx_fct_prt) (uint8_t *, uint16_t));
 void fx_comm_process_ping_pong_buffers(CommPort *cp);
 uint8_t fx_receive(CommPort *cp);
+uint8_t fx_receive_frame(CommPort *cp, uint8_t *frame, uint8_t len);
+uint8_t fx_stream_subscribe(CommPort *cp, uint8_t cmd, uint16_t period_ms);
+uint8_t fx_stream_unsubscribe(CommPort *cp, uint8_t cmd);
+uint8_t fx_stream_get_due(CommPort *cp, uint32_t now_ms, uint8_t *cmd);
+uint8_t fx_reply_queue_push(CommPort *cp, ReplyDesc *desc);
+uint8_t fx_reply_queue_peek(CommPort *cp, ReplyDesc *desc);
+uint8_t fx_reply_queue_pop(CommPort *cp, ReplyDesc *desc);
+uint8_t fx_reply_queue_length(CommPort *cp);
+uint8_t fx_tx_queue_frame(CommPort *cp, TxClass tx_class, uint8_t *frame,
+		uint8_t len);
+TxFrame *fx_tx_queue_reserve(CommPort *cp, TxClass tx_class);
+uint8_t fx_tx_queue_commit(CommPort *cp, TxClass tx_class, uint8_t len);
+uint8_t fx_tx_queue_cmd(CommPort *cp, TxClass tx_class, uint8_t cmd_6bits,
+		ReadWrite rw, AckNack ack, uint8_t *buf, uint8_t len);
+uint8_t fx_tx_queue_reply(CommPort *cp, TxClass tx_class, uint8_t cmd_6bits);
+uint8_t fx_tx_queue_free(CommPort *cp, TxClass tx_class);
+uint8_t fx_tx_queue_pending(CommPort *cp);
+uint8_t fx_comm_process_replies(CommPort *cp);
+uint8_t fx_comm_process_streams(CommPort *cp, uint32_t now_ms);
+uint8_t fx_comm_process_tx_queue(CommPort *cp);
+void fx_comm_tx_done(CommPort *cp);
+uint8_t fx_comm_process_schedule(CommPort *cp);
+uint8_t fx_schedule_pending(CommPort *cp);
+void fx_tdma_config(CommPort *cp, uint8_t slot, uint8_t cmd);
+uint8_t fx_tdma_can_transmit(CommPort *cp);
 
 //****************************************************************************
 // Shared variable(s)
@@ -43,6 +43,16 @@ extern "C" {
 #define MIN_CMD_CODE	0	//Commands 0 is our WhoAmI, same on all boards
 #define MAX_CMD_CODE	63
 
+//Stack commands. Codes 0 to 9 are reserved for the stack, start your custom
+//commands at 10.
+#define FX_CMD_WHO_AM_I		0
+#define FX_CMD_ACK			1
+#define FX_CMD_STREAM		4	//Subscribe to / unsubscribe from a periodic command
+#define FX_CMD_DIAG			5	//Diagnostics, see FX_DIAG_x in flexsea_comm.h
+#define FX_CMD_TIME_SYNC	6	//NTP-style timestamp exchange
+#define FX_CMD_SCHEDULE		7	//Execute a command at a given device time
+#define FX_CMD_TDMA			8	//Beacon: start of a time-slotted bus cycle
+
 typedef enum {
 	CmdInvalid,		//00b: Invalid
 	CmdRead,		//01b: Read
@@ -81,6 +91,11 @@ typedef enum {
 #define CMD_ACK_PNUM_MSB(ack, pnum)		(((ack & 0b1) << 7) | ((pnum & 0x7F00) >> 8))
 #define CMD_ACK_PNUM_LSB(pnum)			(pnum & 0x00FF)
 
+//Reply builders write their data after the command header. This is the most
+//they can write (escaping can make the encoded frame longer, fx_encode() will
+//refuse it if it doesn't fit).
+#define FX_REPLY_MAX_DATA	(MAX_ENCODED_PAYLOAD_BYTES - MIN_OVERHEAD - CMD_OVERHEAD)
+
 //Who Am I?
 typedef struct WhoAmI{
 	uint32_t uuid[3];
@@ -102,6 +117,10 @@ uint8_t fx_call_rx_cmd_handler(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
 		uint8_t *buf, uint8_t len);
 uint8_t fx_register_rx_cmd_handler(uint8_t cmd,
 		uint8_t (*fct_prt)(uint8_t, ReadWrite, AckNack, uint8_t*, uint8_t));
+uint8_t fx_build_tx_reply(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
+		uint8_t *buf_out, uint8_t *buf_out_len);
+uint8_t fx_register_tx_reply_builder(uint8_t cmd,
+		uint8_t (*fct_prt)(uint8_t, uint8_t*, uint8_t*));
 uint16_t get_last_tx_packet_num(void);
 uint16_t get_last_rx_packet_num(void);
 
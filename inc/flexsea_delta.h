@@ -0,0 +1,101 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jfduval at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_delta: delta (on-change) encoding for structured payloads
+ ****************************************************************************/
+
+#ifndef INC_FX_DELTA_H
+#define INC_FX_DELTA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+#define FX_DELTA_MAX_FIELDS		32		//Fields per structure
+#define FX_DELTA_MAX_BYTES		96		//Size of the largest structure
+#define FX_DELTA_BITMAP_BYTES(n)	(((n) + 7) / 8)
+
+//First byte of every delta-encoded payload: keyframe flag + keyframe ID
+#define FX_DELTA_KEYFRAME		0x80
+#define FX_DELTA_ID_MASK		0x7F
+
+//Keyframes kept by a decoder. An encoder never refers to an older one.
+#define FX_DELTA_KEYFRAMES		2
+
+//Size of a structure member, for the field size table
+#define FX_DELTA_FIELD(type, member)	sizeof(((type *)0)->member)
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+//Encoder or decoder state for one structure. Both ends use the same
+//field size table.
+typedef struct DeltaCodec
+{
+	const uint8_t *field_size;	//Size of each field, in bytes
+	uint8_t num_fields;			//Number of fields in the structure
+	uint8_t obj_size;			//Structure size (sum of the field sizes)
+	uint8_t keyframe_interval;	//Send a keyframe at least every N payloads
+	uint8_t auto_ack;			//1: keyframes are used as soon as they are sent
+	uint8_t frames_since_key;	//Payloads sent since the last keyframe
+	uint8_t next_id;			//Next keyframe ID
+	uint8_t ref_valid;			//Do we have a reference keyframe?
+	uint8_t ref_id;				//Reference keyframe ID
+	uint8_t ref[FX_DELTA_MAX_BYTES];		//Reference keyframe
+	uint8_t prev_valid;			//Encoder: keyframe waiting for an ack.
+	uint8_t prev_id;			//Decoder: previous keyframe.
+	uint8_t prev[FX_DELTA_MAX_BYTES];
+	uint8_t keys_since_ref;		//Encoder: keyframes sent after the reference
+}DeltaCodec;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+uint8_t fx_delta_init(DeltaCodec *d, const uint8_t *field_size,
+		uint8_t num_fields, uint8_t keyframe_interval, uint8_t auto_ack);
+uint8_t fx_delta_encode(DeltaCodec *d, const uint8_t *obj, uint8_t *out,
+		uint8_t *out_len);
+uint8_t fx_delta_ack(DeltaCodec *d, uint8_t keyframe_id);
+uint8_t fx_delta_get_ack(DeltaCodec *d, uint8_t *ack);
+uint8_t fx_delta_decode(DeltaCodec *d, const uint8_t *in, uint8_t in_len,
+		uint8_t *obj);
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//INC_FX_DELTA_H
@@ -0,0 +1,108 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jfduval at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_profile: timing hooks and per-stage latency histograms
+ ****************************************************************************/
+
+#ifndef INC_FX_PROFILE_H
+#define INC_FX_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+//Compile-time switch. When disabled the FX_PROFILE_x() macros compile to
+//nothing. Enable with -DFX_PROFILE_ENABLE=1.
+#ifndef FX_PROFILE_ENABLE
+#define FX_PROFILE_ENABLE	0
+#endif
+
+//Timestamp hook. By default we call fx_timestamp(), a port can replace it with
+//a direct register read (ex.: -D'FX_TIMESTAMP()=(DWT->CYCCNT)')
+#ifndef FX_TIMESTAMP
+#define FX_TIMESTAMP()		fx_timestamp()
+#endif
+
+//Default timestamp frequency, see fx_timestamp_hz()
+#ifndef FX_TIMESTAMP_HZ
+#define FX_TIMESTAMP_HZ		1000000
+#endif
+
+//Stages
+#define FX_STAGE_DECODE		0	//fx_decode()
+#define FX_STAGE_PARSE		1	//fx_parse_rx_cmd()
+#define FX_STAGE_HANDLER	2	//RX command handler
+#define FX_STAGE_ENCODE		3	//fx_encode()
+#define FX_STAGES			4
+
+//Histograms: bucket 0 holds 0 ticks, bucket b holds [2^(b-1), 2^b) ticks
+#define FX_PROFILE_BUCKETS	33
+
+#if FX_PROFILE_ENABLE
+#define FX_PROFILE_START(t0)		uint32_t t0 = FX_TIMESTAMP()
+#define FX_PROFILE_STOP(stage, t0)	fx_profile_record((stage), FX_TIMESTAMP() - (t0))
+#else
+#define FX_PROFILE_START(t0)
+#define FX_PROFILE_STOP(stage, t0)
+#endif
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+typedef struct FxHistogram
+{
+	uint32_t bucket[FX_PROFILE_BUCKETS];
+	uint32_t count;
+	uint32_t max;
+}FxHistogram;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+uint32_t fx_timestamp(void);
+uint32_t fx_timestamp_hz(void);
+void fx_profile_record(uint8_t stage, uint32_t ticks);
+void fx_profile_reset(void);
+uint32_t fx_profile_get_count(uint8_t stage);
+uint32_t fx_profile_get_max(uint8_t stage);
+uint32_t fx_profile_get_percentile(uint8_t stage, uint8_t percent);
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//INC_FX_PROFILE_H
@@ -0,0 +1,92 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jfduval at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_route: frame forwarding between communication ports
+ ****************************************************************************/
+
+#ifndef INC_FX_ROUTE_H
+#define INC_FX_ROUTE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include <flexsea_comm.h>
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+#define FX_ROUTES_MAX		16		//Entries in a routing table
+
+//What a route looks at
+typedef enum {
+	RouteByAddr,	//Destination address (multi-drop input port)
+	RouteByCmd		//Command code
+} FxRouteType;
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+//Frames that match 'type' and 'key' are sent, as they are, by 'out'
+typedef struct FxRoute
+{
+	FxRouteType type;
+	uint8_t key;				//Address or command code
+	CommPort *out;
+	TxClass tx_class;
+}FxRoute;
+
+//Routing table of one input port
+typedef struct FxRouter
+{
+	FxRoute route[FX_ROUTES_MAX];
+	uint8_t routes;
+	uint32_t forwarded;			//Frames queued on an output port
+	uint32_t dropped;			//Output queue was full
+	uint32_t local;				//No route: executed by the input port
+}FxRouter;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+void fx_route_init(FxRouter *r);
+uint8_t fx_route_add(FxRouter *r, FxRouteType type, uint8_t key,
+		CommPort *out, TxClass tx_class);
+uint8_t fx_route_receive(FxRouter *r, CommPort *in);
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//INC_FX_ROUTE_H
@@ -0,0 +1,96 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jfduval at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_serial: serial ports and event loop for Linux hosts
+ ****************************************************************************/
+
+#ifndef INC_FX_SERIAL_H
+#define INC_FX_SERIAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Linux only (termios, epoll). On other targets this module is empty.
+#if defined(__linux__)
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include <flexsea_comm.h>
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+#define FX_SERIAL_MAX_PORTS		8		//Ports per event loop
+#define FX_SERIAL_READ_CHUNK	256		//Bytes per read() call
+#define FX_PNUM_ANY				0xFFFF	//fx_wait_for_reply(): any packet number
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+//One serial port watched by the event loop
+typedef struct FxSerialPort
+{
+	int fd;
+	CommPort *cp;				//Its bytes go in cp->cb
+	uint32_t frames;			//Decoded by fx_receive()
+}FxSerialPort;
+
+typedef struct FxSerialLoop
+{
+	int epoll_fd;
+	FxSerialPort port[FX_SERIAL_MAX_PORTS];
+	uint8_t ports;
+	uint32_t wakeups;			//epoll_wait() returns with data
+}FxSerialLoop;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+uint8_t fx_serial_open(const char *path, uint32_t baud, int *fd);
+uint8_t fx_serial_open_pty(int *master_fd, char *slave_path, uint16_t len);
+uint8_t fx_serial_write(int fd, uint8_t *bytes, uint16_t len);
+void fx_serial_close(int fd);
+uint8_t fx_serial_loop_init(FxSerialLoop *loop);
+uint8_t fx_serial_loop_add(FxSerialLoop *loop, int fd, CommPort *cp);
+int fx_serial_loop_run(FxSerialLoop *loop, int timeout_ms);
+void fx_serial_loop_close(FxSerialLoop *loop);
+uint8_t fx_wait_for_reply(FxSerialPort *port, uint8_t cmd, uint16_t pnum,
+		uint32_t timeout_us);
+
+#endif	//defined(__linux__)
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//INC_FX_SERIAL_H
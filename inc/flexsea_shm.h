@@ -0,0 +1,164 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jfduval at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_shm: shared-memory frame delivery between host processes
+ ****************************************************************************/
+
+#ifndef INC_FX_SHM_H
+#define INC_FX_SHM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Linux only (POSIX shared memory, futexes). On other targets this module is
+//empty.
+#if defined(__linux__)
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include <flexsea_codec.h>
+#include <flexsea_command.h>
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+#define FX_SHM_MAX_PORTS	8		//Ports served by one daemon
+#define FX_SHM_CMDS			(MAX_CMD_CODE + 1)
+#define FX_SHM_RX_DEPTH		16		//Frames kept per port and command. Must be a power of 2.
+#define FX_SHM_TX_DEPTH		64		//Frames waiting to be sent. Must be a power of 2.
+#define FX_SHM_NAME_LEN		64
+#define FX_SHM_MAGIC		0x46585348	//"FXSH"
+#define FX_SHM_VERSION		1
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+//One decoded frame. 'seq' is odd while the daemon writes the slot: readers
+//copy it, and try again if 'seq' changed in the meantime (seqlock).
+typedef struct FxShmSlot
+{
+	volatile uint32_t seq;
+	uint32_t index;				//Frame number in its ring
+	uint64_t t_rx_ns;			//CLOCK_MONOTONIC, when it was decoded
+	uint8_t len;
+	uint8_t data[MAX_ENCODED_PAYLOAD_BYTES];	//[CMD|RW][ACK|PNUM][PNUM][DATA...]
+}FxShmSlot;
+
+//Frames of one command, received on one port. One writer (the daemon), any
+//number of readers, each with its own cursor (FxShmReader).
+typedef struct FxShmRing
+{
+	volatile uint32_t published;	//Frames written so far. Futex word.
+	volatile uint32_t waiters;		//Readers sleeping in fx_shm_wait()
+	FxShmSlot slot[FX_SHM_RX_DEPTH];
+}FxShmRing;
+
+//One frame to send, already encoded (fx_create_bytestream_from_cmd())
+typedef struct FxShmTxSlot
+{
+	volatile uint32_t seq;
+	uint8_t port;
+	uint8_t len;
+	uint8_t data[MAX_ENCODED_PAYLOAD_BYTES];
+}FxShmTxSlot;
+
+//Any number of clients push, the daemon pops
+typedef struct FxShmTxQueue
+{
+	volatile uint32_t head;			//Next slot to fill (clients)
+	volatile uint32_t tail;			//Next slot to send (daemon)
+	volatile uint32_t doorbell;		//Incremented by every push. Futex word.
+	volatile uint32_t sleeping;		//The daemon is in fx_shm_tx_wait()
+	FxShmTxSlot slot[FX_SHM_TX_DEPTH];
+}FxShmTxQueue;
+
+//What's in the shared memory object
+typedef struct FxShmRegion
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	volatile uint32_t alive;		//Cleared when the daemon exits
+	int32_t pid;				//Daemon
+	uint8_t ports;
+	FxShmTxQueue tx;
+	FxShmRing rx[FX_SHM_MAX_PORTS][FX_SHM_CMDS];
+}FxShmRegion;
+
+//A process' handle on the region
+typedef struct FxShm
+{
+	FxShmRegion *region;
+	uint8_t owner;				//Created by us (the daemon)
+	char name[FX_SHM_NAME_LEN];
+}FxShm;
+
+//A reader's position in one ring
+typedef struct FxShmReader
+{
+	uint8_t port;
+	uint8_t cmd;
+	uint32_t next;				//Next frame to read
+	uint32_t lost;				//Overwritten before we read them
+	uint64_t t_rx_ns;			//Last frame read: reception time
+}FxShmReader;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+//Daemon
+uint8_t fx_shm_create(FxShm *shm, const char *name, uint8_t ports);
+uint8_t fx_shm_publish(FxShm *shm, uint8_t port, uint8_t *buf, uint8_t len);
+uint8_t fx_shm_tx_pop(FxShm *shm, uint8_t *port, uint8_t *frame,
+		uint8_t *len);
+uint8_t fx_shm_tx_wait(FxShm *shm, uint32_t timeout_us);
+void fx_shm_destroy(FxShm *shm);
+
+//Clients
+uint8_t fx_shm_attach(FxShm *shm, const char *name);
+uint8_t fx_shm_reader_init(FxShm *shm, FxShmReader *r, uint8_t port,
+		uint8_t cmd);
+uint8_t fx_shm_read(FxShm *shm, FxShmReader *r, uint8_t *buf, uint8_t *len);
+uint8_t fx_shm_read_latest(FxShm *shm, FxShmReader *r, uint8_t *buf,
+		uint8_t *len);
+uint8_t fx_shm_wait(FxShm *shm, FxShmReader *r, uint32_t timeout_us);
+uint8_t fx_shm_tx_push(FxShm *shm, uint8_t port, uint8_t *frame, uint8_t len);
+void fx_shm_detach(FxShm *shm);
+
+#endif	//defined(__linux__)
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//INC_FX_SHM_H
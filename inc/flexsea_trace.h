@@ -0,0 +1,110 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jfduval at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_trace: low-overhead event trace ring
+ ****************************************************************************/
+
+#ifndef INC_FX_TRACE_H
+#define INC_FX_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+//****************************************************************************
+// Definition(s):
+//****************************************************************************
+
+//Events are recorded from the main loop only: the ring isn't interrupt safe.
+//An interrupt can take a timestamp, the main loop records it with FX_TRACE_AT().
+//Compile-time switch. When disabled FX_TRACE() compiles to nothing and the
+//ring doesn't use any RAM. Enable with -DFX_TRACE_ENABLE=1.
+#ifndef FX_TRACE_ENABLE
+#define FX_TRACE_ENABLE		0
+#endif
+
+#ifndef FX_TRACE_DEPTH
+#define FX_TRACE_DEPTH		128		//Events in the ring. Must be a power of 2.
+#endif
+
+//Events
+#define FX_TRACE_FRAME_START	1	//fx_receive() starts decoding. Arg: bytes in buffer
+#define FX_TRACE_DECODE_OK		2	//Arg: command code
+#define FX_TRACE_DECODE_FAIL	3	//Arg: bytes left in buffer
+#define FX_TRACE_HANDLER_ENTER	4	//Arg: command code
+#define FX_TRACE_HANDLER_EXIT	5	//Arg: handler return value
+#define FX_TRACE_TX_QUEUED		6	//Arg: (class << 8) | frame length
+#define FX_TRACE_TX_START		7	//Arg: frame length
+#define FX_TRACE_TX_COMPLETE	8	//Arg: class
+#define FX_TRACE_USER			32	//Your own events start here
+
+//Control (FX_CMD_DIAG / FX_DIAG_TRACE, Write)
+#define FX_TRACE_CTRL_STOP		0	//Freeze the ring, ex.: before a dump
+#define FX_TRACE_CTRL_START		1
+#define FX_TRACE_CTRL_CLEAR		2
+
+#if FX_TRACE_ENABLE
+#define FX_TRACE(event, port, arg)	fx_trace_record((event), (port), (arg))
+#define FX_TRACE_AT(t, event, port, arg)	fx_trace_record_at((t), (event), (port), (arg))
+#else
+#define FX_TRACE(event, port, arg)
+#define FX_TRACE_AT(t, event, port, arg)
+#endif
+
+//****************************************************************************
+// Structure(s):
+//****************************************************************************
+
+//One event, 8 bytes. This is also the wire format (little endian).
+typedef struct FxTraceEvent
+{
+	uint32_t timestamp;			//FX_TIMESTAMP() (flexsea_profile.h)
+	uint8_t event;				//FX_TRACE_x
+	uint8_t port;				//CommPort ID
+	uint16_t arg;				//Event specific
+}__attribute__((__packed__))FxTraceEvent;
+
+//****************************************************************************
+// Public Function Prototype(s):
+//****************************************************************************
+
+void fx_trace_record(uint8_t event, uint8_t port, uint16_t arg);
+void fx_trace_record_at(uint32_t timestamp, uint8_t event, uint8_t port,
+		uint16_t arg);
+void fx_trace_control(uint8_t ctrl);
+uint32_t fx_trace_get_count(void);
+uint16_t fx_trace_read(uint16_t first, FxTraceEvent *events, uint16_t max);
+
+//****************************************************************************
+// Shared variable(s)
+//****************************************************************************
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//INC_FX_TRACE_H
@@ -70,6 +70,34 @@ uint8_t circ_buf_write_byte(circ_buf_t *cb, uint8_t new_value)
 	return ret_val;
 }
 
+//Add many values to the circular buffer, in at most two copies (wrap-around)
+//Returns the number of bytes that didn't fit (0 in normal operation). The
+//buffer keeps the first ones, like with circ_buf_write_byte().
+uint16_t circ_buf_write(circ_buf_t *cb, const uint8_t *values, uint16_t len)
+{
+	uint16_t room = CIRC_BUF_SIZE - cb->length;
+	uint16_t accepted = (len > room) ? room : len;
+	uint16_t first = CIRC_BUF_SIZE - cb->write_index;
+
+	if(first > accepted)
+	{
+		first = accepted;
+	}
+
+	//Up to the end of the array, then from the start
+	memcpy((uint8_t *)&cb->buffer[cb->write_index], values, first);
+	memcpy((uint8_t *)cb->buffer, &values[first], accepted - first);
+
+	cb->write_index += accepted;
+	if(cb->write_index >= CIRC_BUF_SIZE)
+	{
+		cb->write_index -= CIRC_BUF_SIZE;
+	}
+	cb->length += accepted;
+
+	return len - accepted;
+}
+
 //Read a value from the circular buffer (single byte)
 //Returns 0 if it's not empty, read_value is your data (normal operation)
 //Returns 1 if the buffer is empty (read_value will be set to 0)
@@ -50,11 +50,22 @@ extern "C" {
 uint8_t fx_create_bytestream_from_cmd(uint8_t cmd_6bits, ReadWrite rw,
 		AckNack ack, uint8_t *buf_in, uint8_t buf_in_len, uint8_t* bytestream,
 		uint8_t *bytestream_len)
+{
+	return fx_create_bytestream_from_cmd_addr(FX_ADDR_NONE, cmd_6bits, rw, ack,
+			buf_in, buf_in_len, bytestream, bytestream_len);
+}
+
+//From command to bytestream, for a multi-drop bus. 'addr' is the destination
+//(FX_ADDR_NONE for a point-to-point link).
+uint8_t fx_create_bytestream_from_cmd_addr(uint8_t addr, uint8_t cmd_6bits,
+		ReadWrite rw, AckNack ack, uint8_t *buf_in, uint8_t buf_in_len,
+		uint8_t* bytestream, uint8_t *bytestream_len)
 {
 	//Temporary variables to hold data between command creation
 	//and encoding
 	uint8_t payload_out[MAX_ENCODED_PAYLOAD_BYTES] = {0};
 	uint8_t payload_out_len = 0;
+	uint8_t ret_val = 0;
 
 	//Is the payload small enough to be packed?
 	if(buf_in_len > (MAX_ENCODED_PAYLOAD_BYTES + MIN_OVERHEAD))
@@ -68,8 +79,11 @@ uint8_t fx_create_bytestream_from_cmd(uint8_t cmd_6bits, ReadWrite rw,
 			payload_out, &payload_out_len))
 	{
 		//Encode it
-		if(!fx_encode(payload_out, payload_out_len, bytestream,
-							bytestream_len, MAX_ENCODED_PAYLOAD_BYTES))
+		FX_PROFILE_START(t_encode);
+		ret_val = fx_encode_addr(addr, payload_out, payload_out_len, bytestream,
+							bytestream_len, MAX_ENCODED_PAYLOAD_BYTES);
+		FX_PROFILE_STOP(FX_STAGE_ENCODE, t_encode);
+		if(!ret_val)
 		{
 			//Success!
 			return 0;
@@ -85,6 +99,14 @@ uint8_t fx_create_bytestream_from_cmd(uint8_t cmd_6bits, ReadWrite rw,
 	return 1;
 }
 
+//Hand received bytes to the stack, all at once (ex.: from a USB or DMA
+//callback, or from Python)
+//Returns the number of bytes that didn't fit in the circular buffer
+uint16_t fx_feed(circ_buf_t *cb, const uint8_t *bytes, uint16_t len)
+{
+	return circ_buf_write(cb, bytes, len);
+}
+
 //Our input bytestream comes in the form of a circular buffer
 //We decode it, and get ready to call a function handler
 uint8_t fx_get_cmd_handler_from_bytestream(circ_buf_t *cb,
@@ -95,15 +117,22 @@ uint8_t fx_get_cmd_handler_from_bytestream(circ_buf_t *cb,
 	uint8_t encoded_payload_len = 0;
 	uint8_t decoded_payload[MAX_ENCODED_PAYLOAD_BYTES] = {0};
 	uint8_t decoded_payload_len = 0;
+	uint8_t ret_val = 0;
 
 	//Decode payload
-	if(!fx_decode(cb, encoded_payload, &encoded_payload_len,
-			decoded_payload, &decoded_payload_len))
+	FX_PROFILE_START(t_decode);
+	ret_val = fx_decode(cb, encoded_payload, &encoded_payload_len,
+			decoded_payload, &decoded_payload_len);
+	FX_PROFILE_STOP(FX_STAGE_DECODE, t_decode);
+	if(!ret_val)
 	{
 		//This function takes a decoded payload as an input,
 		//and determines what the command code and R/W is
-		if(!fx_parse_rx_cmd(decoded_payload, decoded_payload_len,
-				cmd_6bits, rw, ack))
+		FX_PROFILE_START(t_parse);
+		ret_val = fx_parse_rx_cmd(decoded_payload, decoded_payload_len,
+				cmd_6bits, rw, ack);
+		FX_PROFILE_STOP(FX_STAGE_PARSE, t_parse);
+		if(!ret_val)
 		{
 			//Share data with the caller
 			memcpy(buf, decoded_payload, decoded_payload_len);
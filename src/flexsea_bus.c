@@ -0,0 +1,229 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jf at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_bus: poll scheduler for multiplexed half-duplex channels
+ ****************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//A host often talks to several devices through one UART and a few RS-485
+//transceivers, one per channel. fx_bus_run() goes through a table of requests:
+//it selects the channel (driver enabled), sends the request, switches the
+//channel to reception and waits for the reply with fx_receive(). The replies
+//go to your registered handlers, as usual.
+//While we wait, the next request is encoded: as soon as a reply is in (or
+//times out) the next request goes out, no serialization in between.
+//Non-blocking: call fx_bus_run() from your main loop.
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include "flexsea.h"
+#include <flexsea_bus.h>
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+//****************************************************************************
+// Private Function Prototype(s):
+//****************************************************************************
+
+static void fx_bus_prepare(FxBus *bus, uint8_t poll_index);
+static void fx_bus_send(FxBus *bus, uint32_t now_us);
+static uint8_t fx_bus_next(FxBus *bus);
+static uint8_t fx_bus_receive(FxBus *bus, FxBusPoll *p);
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+//'cp': the UART's port. Its tx_fct_prt must return once the frame is out (the
+//transceiver is switched to reception right after).
+//'select': called with (channel, FX_BUS_TX or FX_BUS_RX). Use it to drive the
+//DE/RE lines, or replace it with a simulation.
+//'timeout_us': how long we wait for a reply
+void fx_bus_init(FxBus *bus, CommPort *cp,
+		void (*select)(uint8_t channel, uint8_t dir), uint32_t timeout_us)
+{
+	memset(bus, 0, sizeof(FxBus));
+	bus->cp = cp;
+	bus->select = select;
+	bus->timeout_us = timeout_us;
+	bus->state = BusIdle;
+	bus->channel = FX_BUS_NO_CHANNEL;
+	bus->next_poll = FX_BUS_MAX_POLLS;
+}
+
+//Add a request to the poll table. They are sent in the order they are added.
+//Returns 0 if it worked, 1 if the table is full or the request too long
+uint8_t fx_bus_add_poll(FxBus *bus, uint8_t channel, uint8_t addr,
+		uint8_t cmd, ReadWrite rw, AckNack ack, uint8_t *data, uint8_t len)
+{
+	FxBusPoll *p = NULL;
+
+	if((bus->polls >= FX_BUS_MAX_POLLS) || (len > FX_BUS_POLL_BYTES))
+	{
+		return FX_PROBLEM;
+	}
+
+	p = &bus->poll[bus->polls++];
+	memset(p, 0, sizeof(FxBusPoll));
+	p->channel = channel;
+	p->addr = addr;
+	p->cmd = cmd;
+	p->rw = rw;
+	p->ack = ack;
+	p->len = len;
+	memcpy(p->data, data, len);
+
+	return FX_SUCCESS;
+}
+
+//Run the scheduler: send, listen, time out, move on. 'now_us' is a free-running
+//microsecond counter.
+//Returns 1 when a pass through the poll table was completed, 0 otherwise
+uint8_t fx_bus_run(FxBus *bus, uint32_t now_us)
+{
+	FxBusPoll *p = NULL;
+	uint8_t done = 0, cycle = 0;
+
+	if(bus->polls == 0)
+	{
+		return 0;
+	}
+
+	p = &bus->poll[bus->current];
+	if(bus->state == BusIdle)
+	{
+		fx_bus_send(bus, now_us);
+	}
+
+	//Listen. A Write without Ack doesn't get a reply, we move on right away.
+	if((p->rw == CmdWrite) && (p->ack == Nack))
+	{
+		done = 1;
+	}
+	else if(fx_bus_receive(bus, p))
+	{
+		p->replies++;
+		done = 1;
+	}
+	else if((uint32_t)(now_us - bus->sent_us) >= bus->timeout_us)
+	{
+		p->timeouts++;
+		done = 1;
+	}
+	else if(bus->next_poll == FX_BUS_MAX_POLLS)
+	{
+		//Still waiting: get the next request ready
+		fx_bus_prepare(bus, fx_bus_next(bus));
+	}
+
+	if(done)
+	{
+		cycle = (fx_bus_next(bus) == 0);
+		bus->current = fx_bus_next(bus);
+		bus->state = BusIdle;
+		bus->cycles += cycle;
+	}
+
+	return cycle;
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+//Index of the poll that follows the current one
+static uint8_t fx_bus_next(FxBus *bus)
+{
+	return (bus->current + 1) % bus->polls;
+}
+
+//Decode what came in. Returns 1 if it was the reply to 'p': a frame with the
+//command we expect (FX_CMD_ACK for a Write with Ack), whatever its handler
+//returned. Noise and stray frames aren't replies.
+static uint8_t fx_bus_receive(FxBus *bus, FxBusPoll *p)
+{
+	RxLast *last = &bus->cp->rx_last;
+	uint32_t count = last->count;
+	uint8_t cmd = (p->rw == CmdWrite) ? FX_CMD_ACK : p->cmd;
+
+	fx_receive(bus->cp);
+
+	return (last->count != count) && (last->cmd == cmd);
+}
+
+//Encode a request in bus->next
+static void fx_bus_prepare(FxBus *bus, uint8_t poll_index)
+{
+	FxBusPoll *p = &bus->poll[poll_index];
+
+	if(!fx_create_bytestream_from_cmd_addr(p->addr, p->cmd, p->rw, p->ack,
+			p->data, p->len, bus->next.data, &bus->next.len))
+	{
+		bus->next_poll = poll_index;
+	}
+}
+
+//Send the current request, then listen on its channel
+static void fx_bus_send(FxBus *bus, uint32_t now_us)
+{
+	FxBusPoll *p = &bus->poll[bus->current];
+
+	if(bus->next_poll != bus->current)
+	{
+		fx_bus_prepare(bus, bus->current);
+	}
+
+	//Anything left from the previous request is noise now (a late reply would
+	//be mistaken for this one)
+	circ_buf_init(bus->cp->cb);
+
+	if(bus->select)
+	{
+		bus->select(p->channel, FX_BUS_TX);
+	}
+	bus->channel = p->channel;
+	if(bus->next_poll == bus->current)
+	{
+		bus->cp->tx_fct_prt(bus->next.data, bus->next.len);
+		bus->cp->stats.frames_sent++;
+	}
+	bus->next_poll = FX_BUS_MAX_POLLS;
+	if(bus->select)
+	{
+		bus->select(p->channel, FX_BUS_RX);
+	}
+
+	bus->sent_us = now_us;
+	bus->state = BusWaitReply;
+}
+
+#ifdef __cplusplus
+}
+#endif
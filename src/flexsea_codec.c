@@ -35,6 +35,9 @@ extern "C" {
 //=> Checksum is done on the payload (data + ESCAPEs) and on the BYTES byte.
 //=> Payload/data: string of bytes. It can be a command (see flexsea_command)
 //   or raw data.
+//=> Multi-drop buses: the first payload byte can be a destination address
+//   (see fx_encode_addr()). Addresses are below ESCAPE, they are never
+//   escaped and they always sit right after # of BYTES.
 
 //This file is all about encoding and decoding (CODEC) the data you want to
 //exchange between two systems. Encode your data using fx_encode(),
@@ -54,10 +57,26 @@ extern "C" {
 // Variable(s)
 //****************************************************************************
 
+//Counters of the port we are currently working for (NULL: not counting)
+static fx_codec_stats_t *codec_stats = NULL;
+
+//Address and groups (bitmask) of the node we are decoding for, and address of
+//the last frame
+static uint8_t rx_address = FX_ADDR_NONE;
+static uint8_t rx_groups = 0;
+static uint8_t last_rx_address = FX_ADDR_NONE;
+
 //****************************************************************************
 // Private Function Prototype(s):
 //****************************************************************************
 
+static uint8_t fx_encode_frame(uint8_t addr, uint8_t *payload,
+		uint8_t payload_len, uint8_t *encoded_payload,
+		uint8_t *encoded_payload_len, uint8_t max_encoded_payload_len);
+static uint8_t fx_codec_address_match(uint8_t addr);
+static uint8_t fx_codec_has_header(circ_buf_t *cb, uint16_t start,
+		uint16_t end);
+
 //****************************************************************************
 // Public Function(s)
 //****************************************************************************
@@ -74,61 +93,26 @@ uint8_t fx_encode(uint8_t *payload, uint8_t payload_len,
 		uint8_t *encoded_payload, uint8_t *encoded_payload_len,
 		uint8_t max_encoded_payload_len)
 {
-	uint16_t i = 0, escapes = 0, idx = 0, total_bytes = 0;
-	uint8_t checksum = 0;
-
-	//Fill encoded_payload with known values ('a'), up to 'max_encoded_payload_len'
-	memset(encoded_payload, 0xAA, max_encoded_payload_len);
-
-	//Fill encoded_payload with payload and add ESCAPE characters when necessary
-	escapes = 0;
-	idx = 2;
-	for(i = 0; i < payload_len && idx < max_encoded_payload_len; i++)
-	{
-		if((payload[i] == HEADER) || (payload[i] == FOOTER)
-				|| (payload[i] == ESCAPE))
-		{
-			escapes = escapes + 1;
-			encoded_payload[idx] = ESCAPE;
-			encoded_payload[idx + 1] = payload[i];
-			checksum += encoded_payload[idx];
-			checksum += encoded_payload[idx + 1];
-			idx = idx + 1;
-		}
-		else
-		{
-			encoded_payload[idx] = payload[i];
-			checksum += encoded_payload[idx];
-		}
-		idx++;
-	}
-
-	if((idx + 2) >= max_encoded_payload_len)
-	{
-		//Packaged payload too long, abort
-		memset(encoded_payload, 0, max_encoded_payload_len);	//Clear string
-		return 1;
-	}
-
-	total_bytes = payload_len + escapes;
+	return fx_encode_frame(FX_ADDR_NONE, payload, payload_len,
+			encoded_payload, encoded_payload_len, max_encoded_payload_len);
+}
 
-	//String length?
-	if(total_bytes >= max_encoded_payload_len)
+//Same as fx_encode(), for a multi-drop bus: 'addr' is the destination. It is
+//the first byte of the frame's payload, see fx_codec_set_rx_address().
+//FX_ADDR_NONE gives the same frame as fx_encode().
+//Returns 0 if it was able to encode it, 1 otherwise (including invalid addresses)
+uint8_t fx_encode_addr(uint8_t addr, uint8_t *payload, uint8_t payload_len,
+		uint8_t *encoded_payload, uint8_t *encoded_payload_len,
+		uint8_t max_encoded_payload_len)
+{
+	if((addr > FX_ADDR_MAX) && (addr != FX_ADDR_NONE))
 	{
-		//Too long, abort:
-		memset(encoded_payload, 0, max_encoded_payload_len);	//Clear string
+		*encoded_payload_len = 0;
 		return 1;
 	}
 
-	//Build comm_str:
-	encoded_payload[0] = HEADER;
-	encoded_payload[1] = total_bytes;
-	encoded_payload[2 + total_bytes] = checksum;
-	encoded_payload[3 + total_bytes] = FOOTER;
-
-	//Return the length of the valid data
-	*encoded_payload_len = (MIN_OVERHEAD + total_bytes);
-	return 0;
+	return fx_encode_frame(addr, payload, payload_len, encoded_payload,
+			encoded_payload_len, max_encoded_payload_len);
 }
 
 //Takes data from the wire (stored in a circular buffer) and extracts the first valid payload
@@ -137,6 +121,8 @@ uint8_t fx_encode(uint8_t *payload, uint8_t payload_len,
 //'uint8_t *encoded_len': length of the encoded array.
 //'uint8_t *decoded': array that will store the extracted decoded payload (no header/footer/...)
 //'uint8_t *decoded_len': length of the decoded array.
+//'decoded' and 'decoded_len' can be NULL: the frame is checked and extracted,
+//but not un-escaped (forwarding, see flexsea_route).
 
 //ToDo: how do we handle a corrupted payload? Do we remove it from the buffer or not?
 
@@ -154,9 +140,19 @@ uint8_t fx_decode(circ_buf_t *cb, uint8_t *encoded, uint8_t *encoded_len,
 	uint8_t checksum = 0;
 	uint8_t bytes_in_encoded_payload = 0;
 	uint8_t byte_peek = 0;
+	uint16_t i = 0;
+	//Bad frames only get counted once they are flushed, a search that fails
+	//will look at them again
+	uint32_t checksum_errors = 0, footer_errors = 0;
+	//Noise: headers that can't start a frame anymore, flushed if we fail
+	uint16_t drop_len = 0;
+	uint32_t drop_checksum_errors = 0, drop_footer_errors = 0;
 
 	*encoded_len = 0;
-	*decoded_len = 0;
+	if(decoded_len != NULL)
+	{
+		*decoded_len = 0;
+	}
 
 	//We look for an encoded payload, starting by searching for a header
 	uint16_t headers = 0, footers = 0;
@@ -191,7 +187,7 @@ uint8_t fx_decode(circ_buf_t *cb, uint8_t *encoded, uint8_t *encoded_len,
 		//This means it's not the first time => we found at least one header => don't delete
 		if(ret_val == 1)
 		{
-			return 1;
+			break;
 		}
 
 		//We found a header! Can we find a footer in the right location?
@@ -212,7 +208,54 @@ uint8_t fx_decode(circ_buf_t *cb, uint8_t *encoded, uint8_t *encoded_len,
 					//We make sure that what we think is our footer is actually a footer
 					found_footer = ((possible_footer_pos < cb_size)
 							&& (byte_peek == FOOTER));
+					footer_errors += !found_footer;
+				}
+			}
+		}
+
+		//Multi-drop: is it for us? We look at the address before the checksum
+		//and the un-escaping, frames for other nodes are dropped at little cost
+		if(found_footer && (rx_address != FX_ADDR_NONE))
+		{
+			ret_val = circ_buf_peek(cb, &byte_peek, header_pos + 2);
+			if(ret_val || (bytes_in_encoded_payload == 0)
+					|| !fx_codec_address_match(byte_peek))
+			{
+				//Not for us, but it hasn't been checked: it could be a false
+				//header. If another frame could start inside of it, we only
+				//drop this header and keep searching.
+				uint8_t whole = !fx_codec_has_header(cb, header_pos + 1,
+						possible_footer_pos - 1);
+				uint16_t flush_len = whole ? (possible_footer_pos + 1) :
+						(header_pos + 1);
+				uint8_t dump = 0;
+				for(i = 0; i < flush_len; i++)
+				{
+					ret_val = circ_buf_read_byte(cb, &dump);
 				}
+
+				if(codec_stats)
+				{
+					codec_stats->frames_filtered += whole;
+					codec_stats->bytes_discarded += whole ? header_pos : flush_len;
+					codec_stats->checksum_errors += checksum_errors;
+					codec_stats->footer_errors += footer_errors;
+				}
+
+				if(whole)
+				{
+					return 1;
+				}
+
+				//Start over on what's left
+				ret_val = circ_buf_get_size(cb, &cb_size);
+				last_possible_header_index = cb_size - 4;
+				last_header_pos = 0;
+				first_time = 1;
+				checksum_errors = 0;
+				footer_errors = 0;
+				drop_len = 0;
+				continue;
 			}
 		}
 
@@ -231,16 +274,26 @@ uint8_t fx_decode(circ_buf_t *cb, uint8_t *encoded, uint8_t *encoded_len,
 				{
 					//We make sure that the two checksums match
 					found_encoded_payload = (checksum == byte_peek);
+					checksum_errors += !found_encoded_payload;
 				}
 			}
 		}
 
+		//A frame is never longer than MAX_ENCODED_PAYLOAD_BYTES: if more than
+		//that follows a bad header, it will never be valid
+		if(!found_encoded_payload && (header_pos < cb_size)
+				&& ((cb_size - header_pos) > MAX_ENCODED_PAYLOAD_BYTES))
+		{
+			drop_len = header_pos + 1;
+			drop_checksum_errors = checksum_errors;
+			drop_footer_errors = footer_errors;
+		}
+
 		//Either we found an encoded payload and it had a valid checksum, or we want to launch a new search
 		last_header_pos = header_pos;
 	}
 
 	//A correct encoded payload was found in the circular buffer, and we can now extract it
-	uint16_t i = 0;
 	if(found_encoded_payload)
 	{
 		*encoded_len = bytes_in_encoded_payload + MIN_OVERHEAD;
@@ -261,31 +314,89 @@ uint8_t fx_decode(circ_buf_t *cb, uint8_t *encoded, uint8_t *encoded_len,
 			ret_val = circ_buf_read_byte(cb, &encoded[i]);
 		}
 
-		//Final step, we remove any ESCAPE chars
-		uint16_t k, skip = 0, decoded_idx = 0;
-		for(k = 0; k < bytes_in_encoded_payload; k++)
+		//Addressed frame? The address isn't part of the decoded payload
+		last_rx_address = FX_ADDR_NONE;
+		if(rx_address != FX_ADDR_NONE)
 		{
-			uint16_t index = k + 2; //First value is header, next value is bytes, next value is first data
-			if((encoded[index] == ESCAPE) && (skip == 0))
-			{
-				skip = 1;
-			}
-			else
-			{
-				skip = 0;
-				decoded[decoded_idx++] = encoded[index];
-			}
+			last_rx_address = encoded[2];
+		}
+
+		//Final step, we remove any ESCAPE chars. Frames that are only
+		//forwarded (decoded = NULL) stay as they are.
+		if(decoded != NULL)
+		{
+			fx_unescape(encoded, *encoded_len, (rx_address != FX_ADDR_NONE),
+					decoded, decoded_len);
+		}
+
+		if(codec_stats)
+		{
+			codec_stats->frames_decoded++;
+			codec_stats->bytes_discarded += header_pos;
+			codec_stats->checksum_errors += checksum_errors;
+			codec_stats->footer_errors += footer_errors;
 		}
 
 		//Success, we are done! The user will be able to access the data in 'unpacked'
-		*decoded_len = decoded_idx;
 		return 0;
 	}
 
-	//We didn't extract what we wanted
+	//We didn't extract what we wanted. Flush the noise, or a buffer full of
+	//bad headers would never decode anything again.
+	if(drop_len)
+	{
+		uint8_t dump = 0;
+		for(i = 0; i < drop_len; i++)
+		{
+			ret_val = circ_buf_read_byte(cb, &dump);
+		}
+
+		if(codec_stats)
+		{
+			codec_stats->bytes_discarded += drop_len;
+			codec_stats->checksum_errors += drop_checksum_errors;
+			codec_stats->footer_errors += drop_footer_errors;
+		}
+	}
+
 	return 1;
 }
 
+//Extract the payload of a valid frame (from fx_decode()): remove the ESCAPE
+//chars, and the address if the frame is 'addressed'.
+//Returns 0 if it worked, 1 if 'encoded' is too short to be a frame
+uint8_t fx_unescape(uint8_t *encoded, uint8_t encoded_len, uint8_t addressed,
+		uint8_t *decoded, uint8_t *decoded_len)
+{
+	uint16_t k = 0, skip = 0, decoded_idx = 0;
+	uint8_t bytes_in_encoded_payload = 0;
+
+	*decoded_len = 0;
+	if(encoded_len < MIN_OVERHEAD)
+	{
+		return 1;
+	}
+
+	bytes_in_encoded_payload = encoded_len - MIN_OVERHEAD;
+	k = (addressed && bytes_in_encoded_payload) ? 1 : 0;
+	for(; k < bytes_in_encoded_payload; k++)
+	{
+		uint16_t index = k + 2; //First value is header, next value is bytes, next value is first data
+		if((encoded[index] == ESCAPE) && (skip == 0))
+		{
+			skip = 1;
+		}
+		else
+		{
+			skip = 0;
+			decoded[decoded_idx++] = encoded[index];
+		}
+	}
+
+	*decoded_len = decoded_idx;
+	return 0;
+}
+
 //Anything that it's in the buffer and that's before a header is useless
 //It could be padding, noise, etc. In any case, we don't want that.
 uint8_t fx_cleanup(circ_buf_t *cb)
@@ -309,6 +420,10 @@ uint8_t fx_cleanup(circ_buf_t *cb)
 				{
 					ret_val = circ_buf_read_byte(cb, &dump);
 				}
+				if(codec_stats)
+				{
+					codec_stats->bytes_discarded += i;
+				}
 				break;
 			}
 			//Did we scan the entire buffer?
@@ -320,6 +435,10 @@ uint8_t fx_cleanup(circ_buf_t *cb)
 				{
 					ret_val = circ_buf_read_byte(cb, &dump);
 				}
+				if(codec_stats)
+				{
+					codec_stats->bytes_discarded += i + 1;
+				}
 				break;
 			}
 		}
@@ -328,6 +447,154 @@ uint8_t fx_cleanup(circ_buf_t *cb)
 	return 0;	//Always OK
 }
 
+//The codec doesn't know about ports. Attach the counters of the port you are
+//working for before encoding or decoding, and detach them (NULL) when done.
+//fx_receive() and the TX queue functions do this for you.
+void fx_codec_attach_stats(fx_codec_stats_t *stats)
+{
+	codec_stats = stats;
+}
+
+//Multi-drop buses: only decode frames addressed to 'addr'. Frames for other
+//nodes are flushed by fx_decode() without being checked. FX_ADDR_NONE (default)
+//is for point-to-point links, where frames have no address.
+//Like the counters, this is set by fx_receive() for the port it works on.
+void fx_codec_set_rx_address(uint8_t addr)
+{
+	rx_address = addr;
+}
+
+//Multi-drop buses: groups we belong to, bit n for FX_ADDR_GROUP(n). Every node
+//accepts FX_ADDR_BROADCAST.
+void fx_codec_set_rx_groups(uint8_t groups)
+{
+	rx_groups = groups;
+}
+
+//Destination of the last frame decoded, FX_ADDR_NONE if it wasn't addressed.
+//Use FX_ADDR_IS_MULTICAST() to know if it was for a group or for everyone.
+uint8_t fx_codec_get_last_rx_address(void)
+{
+	return last_rx_address;
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+//Is a frame sent to 'addr' for us?
+static uint8_t fx_codec_address_match(uint8_t addr)
+{
+	if((addr == rx_address) || (addr == FX_ADDR_BROADCAST))
+	{
+		return 1;
+	}
+
+	if((addr >= FX_ADDR_GROUP_0) && (addr < (FX_ADDR_GROUP_0 + FX_ADDR_GROUPS)))
+	{
+		return (rx_groups >> (addr - FX_ADDR_GROUP_0)) & 1;
+	}
+
+	return 0;
+}
+
+//Is there a HEADER between 'start' and 'end' (excluded) that isn't escaped?
+//Inside of a valid frame, every HEADER follows an ESCAPE.
+static uint8_t fx_codec_has_header(circ_buf_t *cb, uint16_t start,
+		uint16_t end)
+{
+	uint16_t pos = start;
+	uint8_t before = 0;
+
+	while(!circ_buf_search(cb, &pos, HEADER, pos) && (pos < end))
+	{
+		circ_buf_peek(cb, &before, pos - 1);
+		if(before != ESCAPE)
+		{
+			return 1;
+		}
+		pos++;
+	}
+
+	return 0;
+}
+
+//Common to fx_encode() and fx_encode_addr(). 'addr' is FX_ADDR_NONE for
+//point-to-point links.
+static uint8_t fx_encode_frame(uint8_t addr, uint8_t *payload,
+		uint8_t payload_len, uint8_t *encoded_payload,
+		uint8_t *encoded_payload_len, uint8_t max_encoded_payload_len)
+{
+	uint16_t i = 0, escapes = 0, idx = 0, total_bytes = 0;
+	uint8_t checksum = 0, addr_bytes = 0;
+
+	//Fill encoded_payload with known values ('a'), up to 'max_encoded_payload_len'
+	memset(encoded_payload, 0xAA, max_encoded_payload_len);
+
+	//Destination address, never escaped
+	idx = 2;
+	if(addr != FX_ADDR_NONE)
+	{
+		encoded_payload[idx++] = addr;
+		checksum += addr;
+		addr_bytes = 1;
+	}
+
+	//Fill encoded_payload with payload and add ESCAPE characters when necessary
+	escapes = 0;
+	for(i = 0; i < payload_len && idx < max_encoded_payload_len; i++)
+	{
+		if((payload[i] == HEADER) || (payload[i] == FOOTER)
+				|| (payload[i] == ESCAPE))
+		{
+			escapes = escapes + 1;
+			encoded_payload[idx] = ESCAPE;
+			encoded_payload[idx + 1] = payload[i];
+			checksum += encoded_payload[idx];
+			checksum += encoded_payload[idx + 1];
+			idx = idx + 1;
+		}
+		else
+		{
+			encoded_payload[idx] = payload[i];
+			checksum += encoded_payload[idx];
+		}
+		idx++;
+	}
+
+	if((idx + 2) >= max_encoded_payload_len)
+	{
+		//Packaged payload too long, abort
+		memset(encoded_payload, 0, max_encoded_payload_len);	//Clear string
+		return 1;
+	}
+
+	total_bytes = addr_bytes + payload_len + escapes;
+
+	//String length?
+	if(total_bytes >= max_encoded_payload_len)
+	{
+		//Too long, abort:
+		memset(encoded_payload, 0, max_encoded_payload_len);	//Clear string
+		return 1;
+	}
+
+	if(codec_stats)
+	{
+		codec_stats->escapes_encoded += escapes;
+	}
+
+	//Build comm_str:
+	encoded_payload[0] = HEADER;
+	encoded_payload[1] = total_bytes;
+	encoded_payload[2 + total_bytes] = checksum;
+	encoded_payload[3 + total_bytes] = FOOTER;
+
+	//Return the length of the valid data
+	*encoded_payload_len = (MIN_OVERHEAD + total_bytes);
+	return 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -43,10 +43,44 @@ extern "C" {
 // Private Function Prototype(s):
 //****************************************************************************
 
+static uint8_t fx_dispatch_rx_cmd(CommPort *cp, uint8_t cmd_6bits,
+		ReadWrite rw, AckNack ack, uint8_t *buf, uint8_t len, uint32_t t_rx,
+		uint8_t quiet);
+static uint8_t fx_rx_cmd_stream(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len);
+static uint8_t fx_rx_cmd_schedule(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len, uint8_t quiet);
+static uint8_t fx_rx_cmd_diag(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len);
+static uint8_t fx_tx_queue_diag(CommPort *cp, TxClass tx_class,
+		ReplyDesc *desc);
+static uint8_t fx_rx_cmd_time_sync(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len, uint32_t t_rx);
+static uint8_t fx_tx_queue_time_sync(CommPort *cp);
+static uint8_t fx_rx_cmd_tdma(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len, uint32_t t_rx);
+static TxFrame *fx_tx_queue_get_free_slot(CommPort *cp, TxClass tx_class);
+static uint8_t fx_tx_queue_ack(CommPort *cp, ReplyDesc *desc);
+
 //****************************************************************************
 // Public Function(s)
 //****************************************************************************
 
+//Initialize a communication port. Everything is cleared, double buffering is
+//disabled by default. The port is point-to-point, set 'addr' for a multi-drop
+//bus.
+void fx_comm_port_init(CommPort *cp, uint8_t id, circ_buf_t *cb,
+		uint8_t (*tx_fct_prt) (uint8_t *, uint16_t))
+{
+	memset(cp, 0, sizeof(CommPort));
+	cp->id = id;
+	cp->addr = FX_ADDR_NONE;
+	cp->tdma.slot = FX_TDMA_NO_SLOT;
+	cp->tdma.cmd = FX_TDMA_NO_CMD;
+	cp->cb = cb;
+	cp->tx_fct_prt = tx_fct_prt;
+}
+
 //We write to the Circular Buffer here, when new data has been received.
 void fx_comm_process_ping_pong_buffers(CommPort *cp)
 {
@@ -55,20 +89,18 @@ void fx_comm_process_ping_pong_buffers(CommPort *cp)
 		//Read from the non-selected buffer
 		if(cp->dbuf_len[!cp->dbuf_selected] > 0 && !cp->dbuf_lock[!cp->dbuf_selected])
 		{
-			for(int i = 0; i < cp->dbuf_len[!cp->dbuf_selected]; i++)
-			{
-				circ_buf_write_byte(cp->cb, cp->dbuf[!cp->dbuf_selected][i]);
-			}
+			cp->stats.rx_overflows += circ_buf_write(cp->cb,
+					(uint8_t *)cp->dbuf[!cp->dbuf_selected], cp->dbuf_len[!cp->dbuf_selected]);
+			cp->stats.bytes_received += cp->dbuf_len[!cp->dbuf_selected];
 			cp->dbuf_len[!cp->dbuf_selected] = 0;
 		}
 
 		//If we are reading too slow, pong might also be full...
 		if(cp->dbuf_len[cp->dbuf_selected] > 0 && !cp->dbuf_lock[cp->dbuf_selected])
 		{
-			for(int i = 0; i < cp->dbuf_len[cp->dbuf_selected]; i++)
-			{
-				circ_buf_write_byte(cp->cb, cp->dbuf[cp->dbuf_selected][i]);
-			}
+			cp->stats.rx_overflows += circ_buf_write(cp->cb,
+					(uint8_t *)cp->dbuf[cp->dbuf_selected], cp->dbuf_len[cp->dbuf_selected]);
+			cp->stats.bytes_received += cp->dbuf_len[cp->dbuf_selected];
 			cp->dbuf_len[cp->dbuf_selected] = 0;
 		}
 	}
@@ -81,17 +113,20 @@ uint8_t fx_receive(CommPort *cp)
 	AckNack ack_out = Nack;
 	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0};
 	uint8_t buf_len = 0;
-	uint8_t ret_val = 0, ret_val_cmd = 0;
-	cp->send_reply = 0;
-	cp->send_ack = 0;
-	cp->ack_cmd = 0;
-	cp->ack_packet_num = 0;
+	uint8_t ret_val = 0;
+	uint32_t t_rx = 0;
 
 	fx_comm_process_ping_pong_buffers(cp);
+	fx_codec_attach_stats(&cp->stats.codec);
+	fx_codec_set_rx_address(cp->addr);
+	fx_codec_set_rx_groups(cp->groups);
 
 	//Receive commands
 	if(cp->cb->length > MIN_OVERHEAD)
 	{
+		FX_TRACE(FX_TRACE_FRAME_START, cp->id, cp->cb->length);
+		t_rx = FX_TIMESTAMP();
+
 		//At this point our encoded command is in the circular buffer
 		ret_val = fx_get_cmd_handler_from_bytestream(cp->cb, &cmd_6bits_out, &rw_out,
 				&ack_out, buf, &buf_len);
@@ -99,38 +134,1006 @@ uint8_t fx_receive(CommPort *cp)
 		//Call handler
 		if(!ret_val)
 		{
-			ret_val_cmd = fx_call_rx_cmd_handler(cmd_6bits_out, rw_out, ack_out, buf, buf_len);
+			FX_TRACE(FX_TRACE_DECODE_OK, cp->id, cmd_6bits_out);
+			cp->rx_last.count++;
+			cp->rx_last.cmd = cmd_6bits_out;
+			//[ACKED CMD][PACKET NUM LSB][PACKET NUM MSB]
+			cp->rx_last.acked = CMD_GET_PACKET_NUM(buf[CMD_OVERHEAD + 2],
+					buf[CMD_OVERHEAD + 1]);
+
+			//Group and broadcast commands are executed, never answered
+			if(!fx_dispatch_rx_cmd(cp, cmd_6bits_out, rw_out, ack_out, buf,
+					buf_len, t_rx,
+					FX_ADDR_IS_MULTICAST(fx_codec_get_last_rx_address())))
+			{
+				//Proceed with clean-up procedure
+				fx_cleanup(cp->cb);
+				fx_codec_attach_stats(NULL);
+				fx_codec_set_rx_address(FX_ADDR_NONE);
+				fx_codec_set_rx_groups(0);
+
+				return FX_SUCCESS;	//Success = we decoded something
+			}
+		}
+		else
+		{
+			FX_TRACE(FX_TRACE_DECODE_FAIL, cp->id, cp->cb->length);
+		}
+	}
+	else
+	{
+		fx_cleanup(cp->cb);
+	}
+
+	fx_codec_attach_stats(NULL);
+	fx_codec_set_rx_address(FX_ADDR_NONE);
+	fx_codec_set_rx_groups(0);
+	return FX_PROBLEM;	//Not really a problem, but we didn't decode anything.
+}
+
+//Execute a frame that was already extracted from a ring by fx_decode(), ex.: a
+//frame that the router (fx_route_receive()) didn't forward. Same as
+//fx_receive() from there: handler, replies, no replies for multicasts.
+//Returns 0 if the frame was valid and its handler succeeded
+uint8_t fx_receive_frame(CommPort *cp, uint8_t *frame, uint8_t len)
+{
+	uint8_t cmd_6bits = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t buf_len = 0;
+	uint8_t addressed = (cp->addr != FX_ADDR_NONE);
+
+	if(fx_unescape(frame, len, addressed, buf, &buf_len) ||
+			fx_parse_rx_cmd(buf, buf_len, &cmd_6bits, &rw, &ack))
+	{
+		return FX_PROBLEM;
+	}
+
+	return fx_dispatch_rx_cmd(cp, cmd_6bits, rw, ack, buf, buf_len,
+			FX_TIMESTAMP(), addressed && FX_ADDR_IS_MULTICAST(frame[2]));
+}
+
+//Start streaming 'cmd' every 'period_ms'. Subscribing to a command that is
+//already streamed updates its period.
+//Returns 0 if it worked, 1 if the command is invalid or if all slots are used
+uint8_t fx_stream_subscribe(CommPort *cp, uint8_t cmd, uint16_t period_ms)
+{
+	int i = 0;
+	StreamSlot *slot = NULL;
+
+	if((cmd > MAX_CMD_CODE) || (period_ms == 0))
+	{
+		return FX_PROBLEM;
+	}
+
+	//Existing subscription?
+	for(i = 0; i < FX_STREAMS_MAX; i++)
+	{
+		if(cp->stream[i].active && (cp->stream[i].cmd == cmd))
+		{
+			slot = &cp->stream[i];
+			break;
+		}
+	}
+
+	//No, find a free slot
+	if(slot == NULL)
+	{
+		for(i = 0; i < FX_STREAMS_MAX; i++)
+		{
+			if(!cp->stream[i].active)
+			{
+				slot = &cp->stream[i];
+				break;
+			}
+		}
+	}
+
+	if(slot == NULL)
+	{
+		return FX_PROBLEM;	//Full
+	}
+
+	slot->cmd = cmd;
+	slot->period_ms = period_ms;
+	slot->started = 0;
+	slot->last_ms = 0;
+	slot->active = 1;
+
+	return FX_SUCCESS;
+}
+
+//Stop streaming 'cmd'
+//Returns 0 if it worked, 1 if that command wasn't streamed
+uint8_t fx_stream_unsubscribe(CommPort *cp, uint8_t cmd)
+{
+	int i = 0;
+
+	for(i = 0; i < FX_STREAMS_MAX; i++)
+	{
+		if(cp->stream[i].active && (cp->stream[i].cmd == cmd))
+		{
+			cp->stream[i].active = 0;
+			return FX_SUCCESS;
+		}
+	}
+
+	return FX_PROBLEM;
+}
+
+//Call this from your transmit function. If a stream is due, 'cmd' is the
+//command to send and we return 0. Call it again until it returns 1 (nothing
+//left to send for now).
+//'uint32_t now_ms': time in ms, from any free-running counter (wraps safely)
+uint8_t fx_stream_get_due(CommPort *cp, uint32_t now_ms, uint8_t *cmd)
+{
+	int i = 0;
+	StreamSlot *slot = NULL;
+
+	for(i = 0; i < FX_STREAMS_MAX; i++)
+	{
+		slot = &cp->stream[i];
+		if(!slot->active)
+		{
+			continue;
+		}
+
+		//First sample goes out right away
+		if(!slot->started)
+		{
+			slot->started = 1;
+			slot->last_ms = now_ms;
+			*cmd = slot->cmd;
+			return FX_SUCCESS;
+		}
+
+		if((uint32_t)(now_ms - slot->last_ms) >= slot->period_ms)
+		{
+			slot->last_ms += slot->period_ms;
+			//If we fell behind by more than a period we skip samples rather
+			//than sending a burst
+			if((uint32_t)(now_ms - slot->last_ms) >= slot->period_ms)
+			{
+				slot->last_ms = now_ms;
+			}
+			*cmd = slot->cmd;
+			return FX_SUCCESS;
+		}
+	}
+
+	return FX_PROBLEM;	//Nothing to send
+}
+
+//Add a reply to the queue (fx_receive() does this for you)
+//Returns 0 if it worked, 1 if the queue is full (the reply is dropped)
+uint8_t fx_reply_queue_push(CommPort *cp, ReplyDesc *desc)
+{
+	ReplyQueue *q = &cp->replyq;
+
+	if((uint8_t)(q->wr - q->rd) >= FX_REPLYQ_DEPTH)
+	{
+		cp->stats.replies_dropped++;
+		return FX_PROBLEM;
+	}
+
+	q->desc[q->wr & (FX_REPLYQ_DEPTH - 1)] = *desc;
+	q->wr++;
+
+	return FX_SUCCESS;
+}
+
+//Oldest pending reply, left in the queue. Use this when you might not be able
+//to send it right away (ex.: full TX queue), and pop it once it's handled.
+//Returns 0 if there was one, 1 if the queue is empty
+uint8_t fx_reply_queue_peek(CommPort *cp, ReplyDesc *desc)
+{
+	ReplyQueue *q = &cp->replyq;
+
+	if(q->wr == q->rd)
+	{
+		return FX_PROBLEM;
+	}
+
+	*desc = q->desc[q->rd & (FX_REPLYQ_DEPTH - 1)];
+
+	return FX_SUCCESS;
+}
+
+//Remove the oldest pending reply. 'desc' can be NULL.
+//Returns 0 if there was one, 1 if the queue is empty
+uint8_t fx_reply_queue_pop(CommPort *cp, ReplyDesc *desc)
+{
+	ReplyQueue *q = &cp->replyq;
+
+	if(q->wr == q->rd)
+	{
+		return FX_PROBLEM;
+	}
+
+	if(desc != NULL)
+	{
+		*desc = q->desc[q->rd & (FX_REPLYQ_DEPTH - 1)];
+	}
+	q->rd++;
+
+	return FX_SUCCESS;
+}
+
+uint8_t fx_reply_queue_length(CommPort *cp)
+{
+	return (uint8_t)(cp->replyq.wr - cp->replyq.rd);
+}
+
+//Queue an encoded frame (ex.: from fx_create_bytestream_from_cmd()). The frame
+//is copied, 'frame' can be reused right away.
+//Returns 0 if it worked, 1 if that class is full (the frame is dropped)
+uint8_t fx_tx_queue_frame(CommPort *cp, TxClass tx_class, uint8_t *frame,
+		uint8_t len)
+{
+	TxFrame *slot = NULL;
+
+	if((tx_class >= TX_CLASSES) || (len > MAX_ENCODED_PAYLOAD_BYTES))
+	{
+		return FX_PROBLEM;
+	}
+
+	slot = fx_tx_queue_get_free_slot(cp, tx_class);
+	if(slot == NULL)
+	{
+		return FX_PROBLEM;
+	}
+
+	memcpy(slot->data, frame, len);
+	slot->len = len;
+	cp->txq.wr[tx_class]++;
+	FX_TRACE(FX_TRACE_TX_QUEUED, cp->id, (tx_class << 8) | len);
+
+	return FX_SUCCESS;
+}
+
+//In-place producers (ex.: flexsea_route): the next free slot of a class, to
+//write an encoded frame directly in the queue. Nothing is queued until
+//fx_tx_queue_commit(). Returns NULL if the class is full (not counted as a
+//drop, nothing was lost yet).
+TxFrame *fx_tx_queue_reserve(CommPort *cp, TxClass tx_class)
+{
+	if(!fx_tx_queue_free(cp, tx_class))
+	{
+		return NULL;
+	}
+
+	return &cp->txq.frame[tx_class][cp->txq.wr[tx_class] & (FX_TXQ_DEPTH - 1)];
+}
+
+//Queue the 'len' bytes written in the slot given by fx_tx_queue_reserve()
+//Returns 0 if it worked, 1 if the class is full or 'len' invalid
+uint8_t fx_tx_queue_commit(CommPort *cp, TxClass tx_class, uint8_t len)
+{
+	TxFrame *slot = fx_tx_queue_reserve(cp, tx_class);
+
+	if((slot == NULL) || (len == 0) || (len > MAX_ENCODED_PAYLOAD_BYTES))
+	{
+		return FX_PROBLEM;
+	}
+
+	slot->len = len;
+	cp->txq.wr[tx_class]++;
+	FX_TRACE(FX_TRACE_TX_QUEUED, cp->id, (tx_class << 8) | len);
+
+	return FX_SUCCESS;
+}
+
+//Create a command and encode it directly in the transmit queue
+//Returns 0 if it worked, 1 if the class is full or if the command is invalid
+uint8_t fx_tx_queue_cmd(CommPort *cp, TxClass tx_class, uint8_t cmd_6bits,
+		ReadWrite rw, AckNack ack, uint8_t *buf, uint8_t len)
+{
+	TxFrame *slot = NULL;
+	uint8_t ret_val = 0;
+
+	if(tx_class >= TX_CLASSES)
+	{
+		return FX_PROBLEM;
+	}
+
+	slot = fx_tx_queue_get_free_slot(cp, tx_class);
+	if(slot == NULL)
+	{
+		return FX_PROBLEM;
+	}
+
+	fx_codec_attach_stats(&cp->stats.codec);
+	ret_val = fx_create_bytestream_from_cmd_addr(FX_REPLY_ADDR(cp), cmd_6bits,
+			rw, ack, buf, len, slot->data, &slot->len);
+	fx_codec_attach_stats(NULL);
+	if(ret_val)
+	{
+		return FX_PROBLEM;
+	}
+	cp->txq.wr[tx_class]++;
+	FX_TRACE(FX_TRACE_TX_QUEUED, cp->id, (tx_class << 8) | slot->len);
+
+	return FX_SUCCESS;
+}
+
+//Build the reply to 'cmd_6bits' with its registered builder (see
+//fx_register_tx_reply_builder()) and encode it directly in the transmit queue
+//Returns 0 if it worked, 1 if the class is full or if there is no builder
+uint8_t fx_tx_queue_reply(CommPort *cp, TxClass tx_class, uint8_t cmd_6bits)
+{
+	TxFrame *slot = NULL;
+	uint8_t payload[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t payload_len = 0, ret_val = 0;
+
+	if(tx_class >= TX_CLASSES)
+	{
+		return FX_PROBLEM;
+	}
+
+	slot = fx_tx_queue_get_free_slot(cp, tx_class);
+	if(slot == NULL)
+	{
+		return FX_PROBLEM;
+	}
+
+	if(fx_build_tx_reply(cmd_6bits, CmdWrite, Nack, payload, &payload_len))
+	{
+		return FX_PROBLEM;
+	}
+
+	fx_codec_attach_stats(&cp->stats.codec);
+	FX_PROFILE_START(t_encode);
+	ret_val = fx_encode_addr(FX_REPLY_ADDR(cp), payload, payload_len,
+			slot->data, &slot->len, MAX_ENCODED_PAYLOAD_BYTES);
+	FX_PROFILE_STOP(FX_STAGE_ENCODE, t_encode);
+	fx_codec_attach_stats(NULL);
+	if(ret_val)
+	{
+		return FX_PROBLEM;
+	}
+	cp->txq.wr[tx_class]++;
+	FX_TRACE(FX_TRACE_TX_QUEUED, cp->id, (tx_class << 8) | slot->len);
+
+	return FX_SUCCESS;
+}
+
+//How many frames can we still queue in that class? Bulk producers (ex.: a
+//parameter dump) should use this to pace themselves rather than filling the
+//class and counting drops.
+uint8_t fx_tx_queue_free(CommPort *cp, TxClass tx_class)
+{
+	if(tx_class >= TX_CLASSES)
+	{
+		return 0;
+	}
+
+	return FX_TXQ_DEPTH - (uint8_t)(cp->txq.wr[tx_class] - cp->txq.rd[tx_class]);
+}
+
+//Number of frames waiting, all classes (including the one in flight)
+uint8_t fx_tx_queue_pending(CommPort *cp)
+{
+	uint8_t pending = 0;
+
+	for(int i = 0; i < TX_CLASSES; i++)
+	{
+		pending += (uint8_t)(cp->txq.wr[i] - cp->txq.rd[i]);
+	}
+
+	return pending;
+}
+
+//Move pending replies to the transmit queue. Acks are built by the stack and
+//go in the control class, replies are built by the registered reply builders.
+//Replies that don't fit in the transmit queue stay pending for the next call.
+//Returns the number of replies that were queued
+uint8_t fx_comm_process_replies(CommPort *cp)
+{
+	ReplyDesc desc = {0};
+	TxClass tx_class = TxReply;
+	uint8_t queued = 0;
+
+	while(!fx_reply_queue_peek(cp, &desc))
+	{
+		//Acks and time sync go first: the host is waiting on them, and the
+		//sooner a sync reply leaves the better its timestamp
+		tx_class = ((desc.type == ReplyAck) || (desc.cmd == FX_CMD_TIME_SYNC)) ?
+				TxControl : TxReply;
+		if(!fx_tx_queue_free(cp, tx_class))
+		{
+			break;
+		}
+
+		if(desc.type == ReplyAck)
+		{
+			queued += !fx_tx_queue_ack(cp, &desc);
+		}
+		else if(desc.cmd == FX_CMD_DIAG)
+		{
+			//Stack command, the reply depends on the port
+			queued += !fx_tx_queue_diag(cp, tx_class, &desc);
+		}
+		else if(desc.cmd == FX_CMD_TIME_SYNC)
+		{
+			queued += !fx_tx_queue_time_sync(cp);
+		}
+		else
+		{
+			//Commands without a builder are silently skipped
+			queued += !fx_tx_queue_reply(cp, tx_class, desc.cmd);
+		}
+		fx_reply_queue_pop(cp, NULL);
+	}
+
+	return queued;
+}
+
+//Queue the streams that are due (see fx_stream_get_due()) in the bulk class.
+//If the bulk class is full we skip samples rather than blocking.
+//Returns the number of frames that were queued
+uint8_t fx_comm_process_streams(CommPort *cp, uint32_t now_ms)
+{
+	uint8_t cmd = 0;
+	uint8_t queued = 0;
+
+	while(fx_tx_queue_free(cp, TxBulk) && !fx_stream_get_due(cp, now_ms, &cmd))
+	{
+		queued += !fx_tx_queue_reply(cp, TxBulk, cmd);
+	}
+
+	return queued;
+}
+
+//Call this from your main loop. We send at most one frame per call, taken from
+//the highest priority class that has something. Priorities are re-evaluated
+//before every frame: a control frame queued while a long bulk transfer is in
+//progress goes out right after the current frame.
+//Returns 0 if a frame was sent, 1 if there was nothing to send, if the port
+//is still busy or if an asynchronous transmission didn't start
+uint8_t fx_comm_process_tx_queue(CommPort *cp)
+{
+	TxQueue *q = &cp->txq;
+	TxFrame *frame = NULL;
 
-			if(!ret_val_cmd)
+	if(q->done)
+	{
+		//Completion of the last asynchronous frame, see fx_comm_tx_done()
+		q->done = 0;
+		FX_TRACE_AT(q->t_done, FX_TRACE_TX_COMPLETE, cp->id, q->sending);
+	}
+
+	if(q->busy || (cp->tx_fct_prt == NULL) || !fx_tdma_can_transmit(cp))
+	{
+		return FX_PROBLEM;
+	}
+
+	for(int i = 0; i < TX_CLASSES; i++)
+	{
+		if(q->wr[i] != q->rd[i])
+		{
+			frame = &q->frame[i][q->rd[i] & (FX_TXQ_DEPTH - 1)];
+			q->sending = i;
+			FX_TRACE(FX_TRACE_TX_START, cp->id, frame->len);
+			if(q->async)
 			{
-				//Reply if requested
-				if((rw_out == CmdRead) || (rw_out == CmdReadWrite))
+				//The frame stays in the queue until fx_comm_tx_done(). If the
+				//transmission couldn't start (ex.: HAL_BUSY) no interrupt is
+				//coming: we stay idle and retry the same frame next time.
+				q->busy = 1;
+				if(cp->tx_fct_prt(frame->data, frame->len))
 				{
-					cp->reply_cmd = cmd_6bits_out;
-					cp->send_reply = 1;
+					q->busy = 0;
+					return FX_PROBLEM;
 				}
+			}
+			else
+			{
+				cp->tx_fct_prt(frame->data, frame->len);
+				q->rd[i]++;
+				FX_TRACE(FX_TRACE_TX_COMPLETE, cp->id, i);
+			}
+			cp->stats.frames_sent++;
+			cp->tdma.sent++;
 
-				//Write with Ack request?
-				if((rw_out == CmdWrite) && (ack_out == Ack))
+			return FX_SUCCESS;
+		}
+	}
+
+	return FX_PROBLEM;	//Nothing to send
+}
+
+//Asynchronous ports (txq.async = 1): call this from your TX complete interrupt.
+//It doesn't trace: the trace ring isn't interrupt safe. We only take the
+//time, the next call to fx_comm_process_tx_queue() records the completion.
+void fx_comm_tx_done(CommPort *cp)
+{
+	if(cp->txq.busy)
+	{
+#if FX_TRACE_ENABLE
+		cp->txq.t_done = FX_TIMESTAMP();
+#endif
+		cp->txq.rd[cp->txq.sending]++;
+		cp->txq.done = 1;
+		cp->txq.busy = 0;
+	}
+}
+
+//Dispatch the scheduled commands (FX_CMD_SCHEDULE) that are due, earliest
+//first. Call this from your main loop, as often as possible: the execution
+//jitter is the time between two calls.
+//Returns the number of commands that were dispatched
+uint8_t fx_comm_process_schedule(CommPort *cp)
+{
+	uint8_t buf[FX_SCHED_MAX_BYTES];
+	uint8_t len = 0, cmd_6bits = 0, dispatched = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+	ScheduledCmd *next = NULL;
+	uint32_t now = 0;
+
+	do
+	{
+		now = FX_TIMESTAMP();
+		next = NULL;
+		for(int i = 0; i < FX_SCHED_DEPTH; i++)
+		{
+			//Due? (wrap-safe, the host schedules less than half a counter
+			//period ahead)
+			if(cp->sched[i].active && ((int32_t)(now - cp->sched[i].at) >= 0))
+			{
+				if((next == NULL) || ((int32_t)(cp->sched[i].at - next->at) < 0))
 				{
-					cp->send_ack = 1;
-					cp->ack_cmd = cmd_6bits_out;
-					cp->ack_packet_num = get_last_rx_packet_num();
+					next = &cp->sched[i];
 				}
+			}
+		}
 
-				//Proceed with clean-up procedure
-				fx_cleanup(cp->cb);
+		if(next != NULL)
+		{
+			//Free the slot first, the command can schedule another one
+			len = next->len;
+			memcpy(buf, next->data, len);
+			next->active = 0;
 
-				return FX_SUCCESS;	//Success = we decoded something
+			if(!fx_parse_rx_cmd(buf, len, &cmd_6bits, &rw, &ack))
+			{
+				fx_dispatch_rx_cmd(cp, cmd_6bits, rw, ack, buf, len, now,
+						next->quiet);
+				dispatched++;
 			}
 		}
+	}while(next != NULL);
+
+	return dispatched;
+}
+
+//Number of commands waiting for their time
+uint8_t fx_schedule_pending(CommPort *cp)
+{
+	uint8_t pending = 0;
+
+	for(int i = 0; i < FX_SCHED_DEPTH; i++)
+	{
+		pending += cp->sched[i].active;
+	}
+
+	return pending;
+}
+
+//Take part in the TDMA cycles (FX_CMD_TDMA) started by the host's beacons.
+//'slot': our slot, 0 is the first one after the beacon. FX_TDMA_NO_SLOT to
+//leave.
+//'cmd': command queued (reply builder) at every beacon, so each cycle carries
+//a fresh sample. FX_TDMA_NO_CMD if you queue your own frames.
+void fx_tdma_config(CommPort *cp, uint8_t slot, uint8_t cmd)
+{
+	cp->tdma.slot = slot;
+	cp->tdma.cmd = cmd;
+	cp->tdma.active = 0;
+}
+
+//Are we allowed to start a frame now? Always, unless a beacon started a TDMA
+//cycle: then only in our slot, FX_TDMA_FRAMES_PER_SLOT frames per cycle.
+//Nothing is sent once the cycle is over, until the next beacon.
+//Returns 1 if we can transmit, 0 otherwise
+uint8_t fx_tdma_can_transmit(CommPort *cp)
+{
+	TdmaState *t = &cp->tdma;
+	uint32_t elapsed = 0, begin = 0;
+
+	if(!t->active)
+	{
+		return 1;
+	}
+
+	if((t->slot >= t->slots) || (t->sent >= FX_TDMA_FRAMES_PER_SLOT))
+	{
+		return 0;
+	}
+
+	elapsed = FX_TIMESTAMP() - t->start;
+	begin = t->slot * t->slot_ticks;
+
+	return ((elapsed >= begin) && ((elapsed - begin) < t->slot_ticks));
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+//Call the handler for a decoded command, and queue the replies it needs.
+//Stack commands that need to know about the port are handled here, everything
+//else goes to the registered handlers.
+//'t_rx': time we started decoding (FX_CMD_TIME_SYNC)
+//'quiet': execute only, no reply or ack (multicast)
+//Returns the handler's return value
+static uint8_t fx_dispatch_rx_cmd(CommPort *cp, uint8_t cmd_6bits,
+		ReadWrite rw, AckNack ack, uint8_t *buf, uint8_t len, uint32_t t_rx,
+		uint8_t quiet)
+{
+	uint8_t ret_val_cmd = 0;
+	ReplyDesc desc = {0};
+
+	//Some handlers parse embedded commands, keep our packet number
+	desc.packet_num = get_last_rx_packet_num();
+
+	FX_TRACE(FX_TRACE_HANDLER_ENTER, cp->id, cmd_6bits);
+	FX_PROFILE_START(t_handler);
+	switch(cmd_6bits)
+	{
+		case FX_CMD_STREAM:
+			ret_val_cmd = fx_rx_cmd_stream(cp, rw, buf, len);
+			break;
+		case FX_CMD_DIAG:
+			ret_val_cmd = fx_rx_cmd_diag(cp, rw, buf, len);
+			break;
+		case FX_CMD_TIME_SYNC:
+			ret_val_cmd = fx_rx_cmd_time_sync(cp, rw, buf, len, t_rx);
+			break;
+		case FX_CMD_SCHEDULE:
+			ret_val_cmd = fx_rx_cmd_schedule(cp, rw, buf, len, quiet);
+			break;
+		case FX_CMD_TDMA:
+			ret_val_cmd = fx_rx_cmd_tdma(cp, rw, buf, len, t_rx);
+			break;
+		default:
+			ret_val_cmd = fx_call_rx_cmd_handler(cmd_6bits, rw, ack, buf, len);
+			break;
+	}
+	FX_PROFILE_STOP(FX_STAGE_HANDLER, t_handler);
+	FX_TRACE(FX_TRACE_HANDLER_EXIT, cp->id, ret_val_cmd);
+
+	if(!ret_val_cmd && !quiet)
+	{
+		//Reply if requested. Replies are queued, a host can pipeline
+		//requests without waiting for each answer.
+		desc.cmd = cmd_6bits;
+		memcpy(desc.arg, &buf[CMD_OVERHEAD], FX_REPLY_ARG_BYTES);
+		desc.ack = ack;
+		if((rw == CmdRead) || (rw == CmdReadWrite))
+		{
+			desc.type = ReplyData;
+			fx_reply_queue_push(cp, &desc);
+		}
+
+		//Write with Ack request?
+		if((rw == CmdWrite) && (ack == Ack))
+		{
+			desc.type = ReplyAck;
+			fx_reply_queue_push(cp, &desc);
+		}
+	}
+
+	return ret_val_cmd;
+}
+
+//FlexSEA Write Acknowledge: [ACKED CMD][PACKET NUM LSB][PACKET NUM MSB]. Reads
+//and ReadWrites are acknowledged by their reply.
+static uint8_t fx_tx_queue_ack(CommPort *cp, ReplyDesc *desc)
+{
+	uint8_t payload[3] = {0};
+
+	payload[0] = desc->cmd;
+	payload[1] = CMD_ACK_PNUM_LSB(desc->packet_num);
+	payload[2] = CMD_ACK_PNUM_MSB(1, desc->packet_num);
+
+	return fx_tx_queue_cmd(cp, TxControl, FX_CMD_ACK, CmdWrite, Ack, payload, 3);
+}
+
+//Time synchronisation reply: [T1 (host, echoed)][T2][T3][TIMESTAMP_HZ]. T2 is
+//the time we started decoding the request, T3 the time we queue the reply, in
+//FX_TIMESTAMP() ticks. The host takes T1 and T4 on its side.
+static uint8_t fx_tx_queue_time_sync(CommPort *cp)
+{
+	uint8_t payload[FX_TSYNC_HOST_BYTES + 12];
+	uint16_t index = 0;
+
+	memcpy(payload, cp->tsync.t1, FX_TSYNC_HOST_BYTES);
+	index += FX_TSYNC_HOST_BYTES;
+	SPLIT_32(cp->tsync.t2, payload, &index);
+	SPLIT_32(FX_TIMESTAMP(), payload, &index);
+	SPLIT_32(fx_timestamp_hz(), payload, &index);
+
+	return fx_tx_queue_cmd(cp, TxControl, FX_CMD_TIME_SYNC, CmdWrite, Nack,
+			payload, index);
+}
+
+//Next free frame in a class, or NULL if it's full (we count the drop)
+static TxFrame *fx_tx_queue_get_free_slot(CommPort *cp, TxClass tx_class)
+{
+	TxQueue *q = &cp->txq;
+
+	if((uint8_t)(q->wr[tx_class] - q->rd[tx_class]) >= FX_TXQ_DEPTH)
+	{
+		cp->stats.frames_dropped[tx_class]++;
+		return NULL;
+	}
+
+	return &q->frame[tx_class][q->wr[tx_class] & (FX_TXQ_DEPTH - 1)];
+}
+
+//Stream subscription command
+//Data: [CMD][PERIOD_MS LSB][PERIOD_MS MSB]. A period of 0 unsubscribes.
+static uint8_t fx_rx_cmd_stream(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len)
+{
+	uint16_t index = CMD_OVERHEAD;
+	uint8_t cmd = 0;
+	uint16_t period_ms = 0;
+
+	if((rw != CmdWrite) || (len < (CMD_OVERHEAD + 3)))
+	{
+		return FX_PROBLEM;
+	}
+
+	cmd = buf[index++];
+	period_ms = REBUILD_UINT16(buf, &index);
+
+	if(period_ms)
+	{
+		return fx_stream_subscribe(cp, cmd, period_ms);
 	}
 	else
 	{
-		fx_cleanup(cp->cb);
+		return fx_stream_unsubscribe(cp, cmd);
 	}
+}
 
-	return FX_PROBLEM;	//Not really a problem, but we didn't decode anything.
+//Time synchronisation command
+//Data: [T1 (FX_TSYNC_HOST_BYTES)], Read only. We keep T1 and our receive time
+//for the reply. One request at a time: a new one replaces a pending one.
+static uint8_t fx_rx_cmd_time_sync(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len, uint32_t t_rx)
+{
+	if((rw != CmdRead) || (len < (CMD_OVERHEAD + FX_TSYNC_HOST_BYTES)))
+	{
+		return FX_PROBLEM;
+	}
+
+	memcpy(cp->tsync.t1, &buf[CMD_OVERHEAD], FX_TSYNC_HOST_BYTES);
+	cp->tsync.t2 = t_rx;
+
+	return FX_SUCCESS;
+}
+
+//Scheduled command
+//Data: [AT (uint32)][EMBEDDED COMMAND], Write only. The embedded command is a
+//full payload ([CMD|RW][ACK|PNUM][PNUM][DATA...]) dispatched when
+//FX_TIMESTAMP() reaches AT. Its replies and acks are sent at that time (none if
+//the request was a multicast). A Write without data cancels every pending
+//command.
+static uint8_t fx_rx_cmd_schedule(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len, uint8_t quiet)
+{
+	uint16_t index = CMD_OVERHEAD;
+	uint8_t embedded_len = 0;
+	uint32_t at = 0;
+
+	if(rw != CmdWrite)
+	{
+		return FX_PROBLEM;
+	}
+
+	//Cancel
+	if(len == CMD_OVERHEAD)
+	{
+		memset(cp->sched, 0, sizeof(cp->sched));
+		return FX_SUCCESS;
+	}
+
+	if(len < (CMD_OVERHEAD + 4 + CMD_OVERHEAD))
+	{
+		return FX_PROBLEM;
+	}
+
+	at = REBUILD_UINT32(buf, &index);
+	embedded_len = len - index;
+	if((embedded_len > FX_SCHED_MAX_BYTES) ||
+			(CMD_GET_6BITS(buf[index + CMD_CODE_INDEX]) == FX_CMD_SCHEDULE))
+	{
+		return FX_PROBLEM;
+	}
+
+	for(int i = 0; i < FX_SCHED_DEPTH; i++)
+	{
+		if(!cp->sched[i].active)
+		{
+			cp->sched[i].at = at;
+			cp->sched[i].len = embedded_len;
+			cp->sched[i].quiet = quiet;
+			memcpy(cp->sched[i].data, &buf[index], embedded_len);
+			cp->sched[i].active = 1;
+			return FX_SUCCESS;
+		}
+	}
+
+	return FX_PROBLEM;	//Full
+}
+
+//TDMA beacon, usually broadcast: Write [SLOT_US (uint16)][SLOTS]. The cycle
+//starts when we receive it: slot n begins n * SLOT_US after that. An empty
+//Write ends TDMA mode, we transmit freely again.
+static uint8_t fx_rx_cmd_tdma(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len, uint32_t t_rx)
+{
+	TdmaState *t = &cp->tdma;
+	uint16_t index = CMD_OVERHEAD;
+	uint16_t slot_us = 0;
+
+	if(rw != CmdWrite)
+	{
+		return FX_PROBLEM;
+	}
+
+	if(len == CMD_OVERHEAD)
+	{
+		t->active = 0;
+		return FX_SUCCESS;
+	}
+
+	if(len < (CMD_OVERHEAD + 3))
+	{
+		return FX_PROBLEM;
+	}
+
+	slot_us = REBUILD_UINT16(buf, &index);
+	t->slots = buf[index];
+	t->beacons++;
+	if(t->slot == FX_TDMA_NO_SLOT)
+	{
+		return FX_SUCCESS;	//Not for us
+	}
+
+	t->slot_ticks = (uint32_t)(((uint64_t)slot_us * fx_timestamp_hz()) / 1000000);
+	t->start = t_rx;
+	t->sent = 0;
+	t->active = 1;
+
+	//Our sample for this cycle. It waits in the queue until our slot.
+	if(t->cmd != FX_TDMA_NO_CMD)
+	{
+		fx_tx_queue_reply(cp, TxReply, t->cmd);
+	}
+
+	return FX_SUCCESS;
+}
+
+//Diagnostics command
+//Data: [SELECTOR][...]. The reply is built by fx_comm_process_replies().
+//FX_DIAG_STATS: Read to get the counters, Write to reset them.
+//FX_DIAG_TRACE: Read [FIRST (uint16)] to get a page, Write [CTRL] to stop,
+//start or clear the ring.
+//FX_DIAG_PROFILE: Read to get the latency summary, Write to reset it.
+static uint8_t fx_rx_cmd_diag(CommPort *cp, ReadWrite rw, uint8_t *buf,
+		uint8_t len)
+{
+	if(len < (CMD_OVERHEAD + 1))
+	{
+		return FX_PROBLEM;
+	}
+
+	switch(buf[CMD_OVERHEAD])
+	{
+		case FX_DIAG_STATS:
+			if(rw == CmdRead)
+			{
+				return FX_SUCCESS;
+			}
+			else if(rw == CmdWrite)
+			{
+				memset(&cp->stats, 0, sizeof(fx_port_stats_t));
+				return FX_SUCCESS;
+			}
+			break;
+		case FX_DIAG_TRACE:
+			if((rw == CmdRead) && (len >= (CMD_OVERHEAD + 3)))
+			{
+				return FX_SUCCESS;
+			}
+			else if((rw == CmdWrite) && (len >= (CMD_OVERHEAD + 2)))
+			{
+				fx_trace_control(buf[CMD_OVERHEAD + 1]);
+				return FX_SUCCESS;
+			}
+			break;
+		case FX_DIAG_PROFILE:
+			if(rw == CmdRead)
+			{
+				return FX_SUCCESS;
+			}
+			else if(rw == CmdWrite)
+			{
+				fx_profile_reset();
+				return FX_SUCCESS;
+			}
+			break;
+	}
+
+	return FX_PROBLEM;
+}
+
+//Diagnostics reply: [SELECTOR][DATA...]
+//FX_DIAG_STATS: every counter as a uint32, in fx_port_stats_t order (the codec's
+//frames_filtered, added later, comes last)
+//FX_DIAG_TRACE: [TIMESTAMP_HZ (uint32)][COUNT (uint32)][FIRST (uint16)][N]
+//[N x FxTraceEvent]. COUNT is the number of events recorded since the last
+//clear, the ring holds the last FX_TRACE_DEPTH.
+//FX_DIAG_PROFILE: [TIMESTAMP_HZ (uint32)][N][N x (COUNT, P50, P99, MAX)], all
+//uint32, one entry per FX_STAGE_x. Times are in ticks.
+static uint8_t fx_tx_queue_diag(CommPort *cp, TxClass tx_class,
+		ReplyDesc *desc)
+{
+	uint8_t payload[FX_REPLY_MAX_DATA];
+	uint16_t index = 0, first = 0, n = 0;
+	fx_port_stats_t *stats = &cp->stats;
+
+	payload[index++] = desc->arg[0];
+	switch(desc->arg[0])
+	{
+		case FX_DIAG_STATS:
+			SPLIT_32(stats->bytes_received, payload, &index);
+			SPLIT_32(stats->rx_overflows, payload, &index);
+			SPLIT_32(stats->codec.frames_decoded, payload, &index);
+			SPLIT_32(stats->codec.checksum_errors, payload, &index);
+			SPLIT_32(stats->codec.footer_errors, payload, &index);
+			SPLIT_32(stats->codec.bytes_discarded, payload, &index);
+			SPLIT_32(stats->codec.escapes_encoded, payload, &index);
+			SPLIT_32(stats->frames_sent, payload, &index);
+			SPLIT_32(stats->replies_dropped, payload, &index);
+			for(int i = 0; i < TX_CLASSES; i++)
+			{
+				SPLIT_32(stats->frames_dropped[i], payload, &index);
+			}
+			SPLIT_32(stats->codec.frames_filtered, payload, &index);
+			break;
+		case FX_DIAG_TRACE:
+			first = desc->arg[1] | (desc->arg[2] << 8);
+			SPLIT_32(fx_timestamp_hz(), payload, &index);
+			SPLIT_32(fx_trace_get_count(), payload, &index);
+			SPLIT_16(first, payload, &index);
+			n = fx_trace_read(first, (FxTraceEvent *)&payload[index + 1],
+					FX_TRACE_EVENTS_PER_PAGE);
+			payload[index++] = n;
+			index += n * sizeof(FxTraceEvent);
+			break;
+		case FX_DIAG_PROFILE:
+			SPLIT_32(fx_timestamp_hz(), payload, &index);
+			payload[index++] = FX_STAGES;
+			for(uint8_t i = 0; i < FX_STAGES; i++)
+			{
+				SPLIT_32(fx_profile_get_count(i), payload, &index);
+				SPLIT_32(fx_profile_get_percentile(i, 50), payload, &index);
+				SPLIT_32(fx_profile_get_percentile(i, 99), payload, &index);
+				SPLIT_32(fx_profile_get_max(i), payload, &index);
+			}
+			break;
+		default:
+			return FX_PROBLEM;
+	}
+
+	return fx_tx_queue_cmd(cp, tx_class, FX_CMD_DIAG, CmdWrite, Nack, payload,
+			index);
 }
 
 #ifdef __cplusplus
@@ -57,6 +57,10 @@ extern "C" {
 uint8_t (*fx_rx_cmd_handler_ptr[MAX_CMD_CODE])(uint8_t cmd_6bits, ReadWrite rw,
 		AckNack ack, uint8_t *buf, uint8_t buf_len);
 
+//Function pointer array that points to the reply builders
+uint8_t (*fx_tx_reply_builder_ptr[MAX_CMD_CODE])(uint8_t cmd_6bits,
+		uint8_t *buf, uint8_t *buf_len);
+
 WhoAmI who_am_i = {.uuid[0] = 0xAA, .uuid[1] = 0xBB, .uuid[2] = 0xCC,
 		.serial_number = 0, .board = "TBD\0"};
 
@@ -69,6 +73,10 @@ uint16_t tx_packet_num = 0, rx_packet_num = 0;
 uint8_t fx_register_rx_cmd_handlers(void);
 static uint8_t fx_rx_cmd_handler_catchall(uint8_t cmd_6bits, ReadWrite rw,
 		AckNack ack, uint8_t *buf, uint8_t buf_len);
+static uint8_t fx_tx_reply_builder_catchall(uint8_t cmd_6bits, uint8_t *buf,
+		uint8_t *buf_len);
+static uint8_t fx_create_tx_cmd_header(uint8_t cmd_6bits, ReadWrite rw,
+		AckNack ack, uint8_t *buf_out);
 static uint16_t generate_new_tx_packet_num(void);
 
 //****************************************************************************
@@ -84,10 +92,11 @@ uint8_t fx_rx_cmd_init(void)
 	for(i = 0; i < MAX_CMD_CODE; i++)
 	{
 		fx_rx_cmd_handler_ptr[i] = &fx_rx_cmd_handler_catchall;
+		fx_tx_reply_builder_ptr[i] = &fx_tx_reply_builder_catchall;
 	}
 
 	//In the user-space, pair command codes and functions by
-	//using register_command()
+	//using register_command(). Reply builders can be registered there too.
 	fx_register_rx_cmd_handlers();
 
 
@@ -106,34 +115,9 @@ uint8_t fx_create_tx_cmd(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
 		uint8_t *buf_in, uint8_t buf_in_len, uint8_t *buf_out,
 		uint8_t *buf_out_len)
 {
-	uint8_t cmd_rw = 0;
-	uint16_t packet_num = 0;
-
-	if((cmd_6bits >= MIN_CMD_CODE) && (cmd_6bits <= MAX_CMD_CODE) &&
-			(rw != CmdInvalid))
+	if(!fx_create_tx_cmd_header(cmd_6bits, rw, ack, buf_out))
 	{
-		//Create the CMD + R/W byte
-		switch(rw)
-		{
-			case CmdRead:
-				cmd_rw = CMD_SET_R(cmd_6bits);
-				break;
-			case CmdWrite:
-				cmd_rw = CMD_SET_W(cmd_6bits);
-				break;
-			case CmdReadWrite:
-				cmd_rw = CMD_SET_RW(cmd_6bits);
-				break;
-			default:
-				//Invalid!
-				return 1;
-		}
-
 		//Create the output data string
-		packet_num = generate_new_tx_packet_num();
-		buf_out[CMD_CODE_INDEX] = cmd_rw;
-		buf_out[CMD_ACK_INDEX] = CMD_ACK_PNUM_MSB(ack, packet_num);
-		buf_out[CMD_ACK_INDEX + 1] = CMD_ACK_PNUM_LSB(packet_num);
 		memcpy(&buf_out[CMD_CODE_INDEX + CMD_OVERHEAD], buf_in, buf_in_len);
 		*buf_out_len = buf_in_len + CMD_OVERHEAD;
 
@@ -220,6 +204,55 @@ uint8_t fx_register_rx_cmd_handler(uint8_t cmd, uint8_t (*fct_prt) (uint8_t, Rea
 	}
 }
 
+//Creates a reply by calling the builder registered for that command. The
+//builder writes its data straight into 'buf_out', after the command header.
+//'buf_out' needs to hold MAX_ENCODED_PAYLOAD_BYTES.
+//Returns 0 if it worked, 1 if there is no builder or if it failed
+uint8_t fx_build_tx_reply(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
+		uint8_t *buf_out, uint8_t *buf_out_len)
+{
+	uint8_t data_len = 0;
+
+	*buf_out_len = 0;
+
+	if(cmd_6bits >= MAX_CMD_CODE)
+	{
+		return 1;
+	}
+
+	if((*fx_tx_reply_builder_ptr[cmd_6bits]) (cmd_6bits,
+			&buf_out[CMD_CODE_INDEX + CMD_OVERHEAD], &data_len))
+	{
+		return 1;
+	}
+
+	if((data_len > FX_REPLY_MAX_DATA) ||
+			fx_create_tx_cmd_header(cmd_6bits, rw, ack, buf_out))
+	{
+		return 1;
+	}
+
+	*buf_out_len = data_len + CMD_OVERHEAD;
+	return 0;
+}
+
+//Pair a reply builder and a command code together. The builder gets the
+//command code and a buffer that can hold FX_REPLY_MAX_DATA bytes. It sets the
+//length and returns 0 if it worked.
+uint8_t fx_register_tx_reply_builder(uint8_t cmd, uint8_t (*fct_prt) (uint8_t,
+		uint8_t *, uint8_t *))
+{
+	if((cmd >= MIN_CMD_CODE) && (cmd < MAX_CMD_CODE))
+	{
+		fx_tx_reply_builder_ptr[cmd] = fct_prt;
+		return 0;
+	}
+	else
+	{
+		return 1;
+	}
+}
+
 __attribute__((weak)) uint8_t fx_register_rx_cmd_handlers(void)
 {
 	//Implement in user space, and register your handlers
@@ -272,6 +305,55 @@ static uint8_t fx_rx_cmd_handler_catchall(uint8_t cmd_6bits, ReadWrite rw,
 	return CATCHALL_RETURN;
 }
 
+//No builder registered for this command: we have nothing to reply
+static uint8_t fx_tx_reply_builder_catchall(uint8_t cmd_6bits, uint8_t *buf,
+		uint8_t *buf_len)
+{
+	(void)cmd_6bits;
+	(void)buf;
+
+	*buf_len = 0;
+	return CATCHALL_RETURN;
+}
+
+//Writes the [CMD + R/W][ACK/NAK + PACKET NUM] header
+static uint8_t fx_create_tx_cmd_header(uint8_t cmd_6bits, ReadWrite rw,
+		AckNack ack, uint8_t *buf_out)
+{
+	uint8_t cmd_rw = 0;
+	uint16_t packet_num = 0;
+
+	if((cmd_6bits >= MIN_CMD_CODE) && (cmd_6bits <= MAX_CMD_CODE) &&
+			(rw != CmdInvalid))
+	{
+		//Create the CMD + R/W byte
+		switch(rw)
+		{
+			case CmdRead:
+				cmd_rw = CMD_SET_R(cmd_6bits);
+				break;
+			case CmdWrite:
+				cmd_rw = CMD_SET_W(cmd_6bits);
+				break;
+			case CmdReadWrite:
+				cmd_rw = CMD_SET_RW(cmd_6bits);
+				break;
+			default:
+				//Invalid!
+				return 1;
+		}
+
+		packet_num = generate_new_tx_packet_num();
+		buf_out[CMD_CODE_INDEX] = cmd_rw;
+		buf_out[CMD_ACK_INDEX] = CMD_ACK_PNUM_MSB(ack, packet_num);
+		buf_out[CMD_ACK_INDEX + 1] = CMD_ACK_PNUM_LSB(packet_num);
+
+		return 0;
+	}
+
+	return 1;
+}
+
 //TX packet number
 static uint16_t generate_new_tx_packet_num(void)
 {
@@ -0,0 +1,326 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jf at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_delta: delta (on-change) encoding for structured payloads
+ ****************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Delta Payload Prototype:
+//========================
+//Keyframe: [KEYFRAME | ID][FULL STRUCTURE...]
+//Delta:    [ID][FIELD BITMAP...][CHANGED FIELDS...]
+//=> ID is a 7-bit keyframe ID. A delta is relative to that keyframe.
+//=> The bitmap has one bit per field (field 0 is the LSB of the first byte).
+//   It is FX_DELTA_BITMAP_BYTES(num_fields) long.
+//=> Changed fields are sent in order, with their native size.
+
+//Streamed structures typically have a few fields that change at every sample
+//and many that rarely do. Sending a delta relative to the last keyframe
+//(rather than to the last sample) means a lost payload does not corrupt the
+//following ones. Periodic keyframes bound the size of the deltas.
+
+//This only deals with the data; use the result as the payload of a command.
+
+//Acknowledgements (auto_ack = 0): the receiver gets its ack byte
+//([KEYFRAME | ID], fx_delta_get_ack()) and sends it back in its next request,
+//ex.: as the first data byte of the Read that polls the structure. The
+//sender gives it to fx_delta_ack(). Acks can be repeated or lost: until one
+//comes back, deltas stay relative to the last acknowledged keyframe. Once the
+//decoder can't have it anymore (FX_DELTA_KEYFRAMES), or before the first ack,
+//they are relative to the last keyframe sent: a lost keyframe then costs the
+//deltas up to the next one, as with auto_ack.
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include "flexsea.h"
+#include <flexsea_delta.h>
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+//****************************************************************************
+// Private Function Prototype(s):
+//****************************************************************************
+
+static void fx_delta_new_keyframe(DeltaCodec *d, const uint8_t *obj,
+		uint8_t *out, uint8_t *out_len);
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+//Prepare an encoder or a decoder
+//'const uint8_t *field_size': size of each field (use FX_DELTA_FIELD()). The
+//  table is not copied, keep it in scope.
+//'uint8_t num_fields': number of fields
+//'uint8_t keyframe_interval': send a keyframe at least every N payloads
+//'uint8_t auto_ack': 1 to use keyframes as references as soon as they are
+//  sent. 0 to wait for fx_delta_ack().
+//Returns 0 if the structure is supported, 1 otherwise
+uint8_t fx_delta_init(DeltaCodec *d, const uint8_t *field_size,
+		uint8_t num_fields, uint8_t keyframe_interval, uint8_t auto_ack)
+{
+	uint16_t i = 0, obj_size = 0;
+
+	memset(d, 0, sizeof(DeltaCodec));
+
+	if((num_fields == 0) || (num_fields > FX_DELTA_MAX_FIELDS))
+	{
+		return 1;
+	}
+
+	for(i = 0; i < num_fields; i++)
+	{
+		obj_size += field_size[i];
+	}
+
+	if((obj_size == 0) || (obj_size > FX_DELTA_MAX_BYTES))
+	{
+		return 1;
+	}
+
+	d->field_size = field_size;
+	d->num_fields = num_fields;
+	d->obj_size = (uint8_t)obj_size;
+	d->keyframe_interval = keyframe_interval;
+	d->auto_ack = auto_ack;
+
+	return 0;
+}
+
+//Encode 'obj'. 'out' needs room for a keyframe (1 + obj_size bytes).
+//Returns 0 if it was able to encode it, 1 otherwise
+uint8_t fx_delta_encode(DeltaCodec *d, const uint8_t *obj, uint8_t *out,
+		uint8_t *out_len)
+{
+	uint8_t i = 0, offset = 0, idx = 0;
+	uint8_t bitmap_bytes = FX_DELTA_BITMAP_BYTES(d->num_fields);
+	const uint8_t *ref = d->ref;
+	uint8_t ref_id = d->ref_id;
+
+	if(d->num_fields == 0)
+	{
+		*out_len = 0;
+		return 1;
+	}
+
+	//Keyframe?
+	if((!d->ref_valid && !d->prev_valid) ||
+			(d->frames_since_key >= d->keyframe_interval))
+	{
+		fx_delta_new_keyframe(d, obj, out, out_len);
+		return 0;
+	}
+
+	//Delta relative to the last acknowledged keyframe, as long as the decoder
+	//still has it. Otherwise (no ack yet, or too many keyframes since) it is
+	//relative to the last keyframe we sent, like with auto_ack.
+	if(!d->ref_valid || (d->keys_since_ref >= FX_DELTA_KEYFRAMES))
+	{
+		ref = d->prev;
+		ref_id = d->prev_id;
+	}
+
+	out[0] = ref_id;
+	memset(&out[1], 0, bitmap_bytes);
+	idx = 1 + bitmap_bytes;
+	for(i = 0; i < d->num_fields; i++)
+	{
+		if(memcmp(&obj[offset], &ref[offset], d->field_size[i]))
+		{
+			//A delta is never allowed to be larger than a keyframe
+			if((idx + d->field_size[i]) > (1 + d->obj_size))
+			{
+				fx_delta_new_keyframe(d, obj, out, out_len);
+				return 0;
+			}
+
+			out[1 + (i >> 3)] |= (1 << (i & 7));
+			memcpy(&out[idx], &obj[offset], d->field_size[i]);
+			idx += d->field_size[i];
+		}
+		offset += d->field_size[i];
+	}
+
+	d->frames_since_key++;
+	*out_len = idx;
+	return 0;
+}
+
+//The receiver got keyframe 'keyframe_id', we can use it as a reference.
+//Only needed when auto_ack is 0. Takes the ID or the ack byte from
+//fx_delta_get_ack(). Only the last keyframe sent can be acknowledged.
+//Returns 0 if that keyframe was waiting for an ack, 1 otherwise
+uint8_t fx_delta_ack(DeltaCodec *d, uint8_t keyframe_id)
+{
+	if(d->prev_valid && (d->prev_id == (keyframe_id & FX_DELTA_ID_MASK)))
+	{
+		memcpy(d->ref, d->prev, d->obj_size);
+		d->ref_id = d->prev_id;
+		d->ref_valid = 1;
+		d->prev_valid = 0;
+		d->keys_since_ref = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
+//Decoder: the ack byte for the last keyframe received ([KEYFRAME | ID]).
+//Send it back with every request, it's harmless to repeat.
+//Returns 0 if there is one, 1 if we haven't received a keyframe yet
+uint8_t fx_delta_get_ack(DeltaCodec *d, uint8_t *ack)
+{
+	if(!d->ref_valid)
+	{
+		return 1;
+	}
+
+	*ack = FX_DELTA_KEYFRAME | d->ref_id;
+	return 0;
+}
+
+//Rebuild 'obj' from a keyframe or a delta. The decoder keeps the last
+//FX_DELTA_KEYFRAMES keyframes, so deltas relative to the last acknowledged
+//one still decode while a new one waits for its ack.
+//Returns 0 if 'obj' was rebuilt, 1 if the payload is invalid or if it refers
+//to a keyframe we didn't receive
+uint8_t fx_delta_decode(DeltaCodec *d, const uint8_t *in, uint8_t in_len,
+		uint8_t *obj)
+{
+	uint8_t i = 0, offset = 0, idx = 0, id = 0;
+	uint8_t bitmap_bytes = FX_DELTA_BITMAP_BYTES(d->num_fields);
+	uint8_t *ref = NULL;
+
+	if((d->num_fields == 0) || (in_len < 1))
+	{
+		return 1;
+	}
+
+	id = in[0] & FX_DELTA_ID_MASK;
+
+	//Keyframe
+	if(in[0] & FX_DELTA_KEYFRAME)
+	{
+		if(in_len < (1 + d->obj_size))
+		{
+			return 1;
+		}
+
+		//Keep the previous one
+		if(d->ref_valid)
+		{
+			memcpy(d->prev, d->ref, d->obj_size);
+			d->prev_id = d->ref_id;
+			d->prev_valid = 1;
+		}
+		memcpy(d->ref, &in[1], d->obj_size);
+		d->ref_id = id;
+		d->ref_valid = 1;
+		memcpy(obj, d->ref, d->obj_size);
+		return 0;
+	}
+
+	//Delta: which keyframe?
+	if(d->ref_valid && (d->ref_id == id))
+	{
+		ref = d->ref;
+	}
+	else if(d->prev_valid && (d->prev_id == id))
+	{
+		ref = d->prev;
+	}
+	else
+	{
+		return 1;
+	}
+
+	if(in_len < (1 + bitmap_bytes))
+	{
+		return 1;
+	}
+
+	memcpy(obj, ref, d->obj_size);
+	idx = 1 + bitmap_bytes;
+	for(i = 0; i < d->num_fields; i++)
+	{
+		if(in[1 + (i >> 3)] & (1 << (i & 7)))
+		{
+			if((idx + d->field_size[i]) > in_len)
+			{
+				return 1;
+			}
+			memcpy(&obj[offset], &in[idx], d->field_size[i]);
+			idx += d->field_size[i];
+		}
+		offset += d->field_size[i];
+	}
+
+	return 0;
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+//Send 'obj' as a new keyframe
+static void fx_delta_new_keyframe(DeltaCodec *d, const uint8_t *obj,
+		uint8_t *out, uint8_t *out_len)
+{
+	uint8_t id = d->next_id;
+	d->next_id = (d->next_id + 1) & FX_DELTA_ID_MASK;
+
+	if(d->auto_ack)
+	{
+		memcpy(d->ref, obj, d->obj_size);
+		d->ref_id = id;
+		d->ref_valid = 1;
+	}
+	else
+	{
+		//Deltas stay relative to the last acknowledged keyframe until this
+		//one gets acknowledged
+		memcpy(d->prev, obj, d->obj_size);
+		d->prev_id = id;
+		d->prev_valid = 1;
+		if(d->ref_valid && (d->keys_since_ref < FX_DELTA_KEYFRAMES))
+		{
+			d->keys_since_ref++;
+		}
+	}
+
+	out[0] = FX_DELTA_KEYFRAME | id;
+	memcpy(&out[1], obj, d->obj_size);
+	*out_len = 1 + d->obj_size;
+	d->frames_since_key = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,212 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jf at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_profile: timing hooks and per-stage latency histograms
+ ****************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//The stack times its main stages (decode, parse, handler, encode) with
+//FX_TIMESTAMP() and keeps one log2 histogram per stage. Histograms are cheap
+//(one increment per sample) and give p50/p99 with a 2x resolution, which is
+//plenty to know if a stage fits in a control period. Read them with
+//FX_CMD_DIAG / FX_DIAG_PROFILE.
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include "flexsea.h"
+#include <flexsea_profile.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+#if FX_PROFILE_ENABLE
+static FxHistogram histogram[FX_STAGES];
+#endif
+
+//****************************************************************************
+// Private Function Prototype(s):
+//****************************************************************************
+
+#if FX_PROFILE_ENABLE
+static uint8_t fx_profile_bucket(uint32_t ticks);
+#endif
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+//Free-running timestamp, fx_timestamp_hz() ticks per second. Microseconds on
+//POSIX hosts. Embedded targets should provide their own (cycle counter, timer)
+//along with fx_timestamp_hz().
+__attribute__((weak)) uint32_t fx_timestamp(void)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#else
+	return 0;
+#endif
+}
+
+//Timestamp frequency, reported to the host with traces and profiles
+__attribute__((weak)) uint32_t fx_timestamp_hz(void)
+{
+	return FX_TIMESTAMP_HZ;
+}
+
+//Add a sample to a stage's histogram. Use FX_PROFILE_START() and
+//FX_PROFILE_STOP() rather than calling this directly.
+void fx_profile_record(uint8_t stage, uint32_t ticks)
+{
+#if FX_PROFILE_ENABLE
+	if(stage >= FX_STAGES)
+	{
+		return;
+	}
+
+	histogram[stage].bucket[fx_profile_bucket(ticks)]++;
+	histogram[stage].count++;
+	if(ticks > histogram[stage].max)
+	{
+		histogram[stage].max = ticks;
+	}
+#else
+	(void)stage;
+	(void)ticks;
+#endif
+}
+
+void fx_profile_reset(void)
+{
+#if FX_PROFILE_ENABLE
+	memset(histogram, 0, sizeof(histogram));
+#endif
+}
+
+//Number of samples
+uint32_t fx_profile_get_count(uint8_t stage)
+{
+#if FX_PROFILE_ENABLE
+	if(stage < FX_STAGES)
+	{
+		return histogram[stage].count;
+	}
+#else
+	(void)stage;
+#endif
+	return 0;
+}
+
+//Longest sample, in ticks
+uint32_t fx_profile_get_max(uint8_t stage)
+{
+#if FX_PROFILE_ENABLE
+	if(stage < FX_STAGES)
+	{
+		return histogram[stage].max;
+	}
+#else
+	(void)stage;
+#endif
+	return 0;
+}
+
+//Percentile (0-100), in ticks. We return the upper bound of the bucket that
+//holds it (never more than the max): 'percent' of the samples took at most
+//that long.
+uint32_t fx_profile_get_percentile(uint8_t stage, uint8_t percent)
+{
+#if FX_PROFILE_ENABLE
+	FxHistogram *h = NULL;
+	uint64_t target = 0, sum = 0;
+	uint32_t upper = 0;
+
+	if((stage >= FX_STAGES) || (histogram[stage].count == 0))
+	{
+		return 0;
+	}
+
+	h = &histogram[stage];
+	if(percent > 100)
+	{
+		percent = 100;
+	}
+
+	//Rank of the sample we are looking for (rounded up)
+	target = ((uint64_t)h->count * percent + 99) / 100;
+	if(target == 0)
+	{
+		target = 1;
+	}
+
+	for(int b = 0; b < FX_PROFILE_BUCKETS; b++)
+	{
+		sum += h->bucket[b];
+		if(sum >= target)
+		{
+			upper = (b == 0) ? 0 : (uint32_t)(((uint64_t)1 << b) - 1);
+			return (upper < h->max) ? upper : h->max;
+		}
+	}
+
+	return h->max;
+#else
+	(void)stage;
+	(void)percent;
+	return 0;
+#endif
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+#if FX_PROFILE_ENABLE
+//Bucket index: number of significant bits
+static uint8_t fx_profile_bucket(uint32_t ticks)
+{
+	uint8_t b = 0;
+
+	while(ticks)
+	{
+		ticks >>= 1;
+		b++;
+	}
+
+	return b;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,269 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jf at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_route: frame forwarding between communication ports
+ ****************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//A bridge (ex.: USB to three RS-485 buses) receives frames that are for other
+//boards. fx_route_receive() takes the place of fx_receive() on its input
+//ports: each valid frame is checked (checksum) and extracted, but not decoded.
+//If it matches a route it is queued, byte for byte, on the output port. The
+//others are executed locally, like fx_receive() would.
+//Frames are forwarded as they are: both links need the same framing (both
+//addressed, or both point-to-point).
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include "flexsea.h"
+#include <flexsea_route.h>
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+//****************************************************************************
+// Private Function Prototype(s):
+//****************************************************************************
+
+static uint8_t fx_route_match(FxRoute *route, uint8_t addr, uint8_t cmd_6bits);
+static uint8_t fx_route_first(FxRouter *r, uint8_t start, uint8_t addr,
+		uint8_t cmd_6bits);
+static uint8_t fx_route_peek(circ_buf_t *cb, uint8_t addressed, uint8_t *addr,
+		uint8_t *cmd_6bits);
+static void fx_route_parse(uint8_t *frame, uint8_t len, uint8_t addressed,
+		uint8_t *addr, uint8_t *cmd_6bits);
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+void fx_route_init(FxRouter *r)
+{
+	memset(r, 0, sizeof(FxRouter));
+}
+
+//Add a route. A frame goes to every route it matches: a broadcast can be sent
+//on several buses.
+//Returns 0 if it worked, 1 if the table is full or the route invalid
+uint8_t fx_route_add(FxRouter *r, FxRouteType type, uint8_t key,
+		CommPort *out, TxClass tx_class)
+{
+	FxRoute *route = NULL;
+
+	if((r->routes >= FX_ROUTES_MAX) || (out == NULL) ||
+			(tx_class >= TX_CLASSES) ||
+			((type == RouteByCmd) && (key > MAX_CMD_CODE)))
+	{
+		return FX_PROBLEM;
+	}
+
+	route = &r->route[r->routes++];
+	route->type = type;
+	route->key = key;
+	route->out = out;
+	route->tx_class = tx_class;
+
+	return FX_SUCCESS;
+}
+
+//Forward or execute the next frame received by 'in'. Call it instead of
+//fx_receive() for that port. Address routes need an addressed input port
+//('addr' set); use the bridge's own address for the frames it executes.
+//The frame at the head of the buffer is decoded straight into a TX slot of
+//its first route: a frame with a single route is never copied. Extra routes
+//(ex.: a broadcast) get a copy of that slot.
+//Returns 0 if a frame was forwarded or executed, 1 otherwise
+uint8_t fx_route_receive(FxRouter *r, CommPort *in)
+{
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES];
+	uint8_t *dst = frame;
+	uint8_t len = 0, ret_val = FX_PROBLEM, matches = 0, first = 0;
+	uint8_t addr = FX_ADDR_NONE, cmd_6bits = 0;
+	uint8_t addressed = (in->addr != FX_ADDR_NONE);
+	TxFrame *slot = NULL;
+	FxRoute *route = NULL;
+
+	fx_comm_process_ping_pong_buffers(in);
+	if(in->cb->length <= MIN_OVERHEAD)
+	{
+		fx_codec_attach_stats(&in->stats.codec);
+		fx_cleanup(in->cb);
+		fx_codec_attach_stats(NULL);
+		return FX_PROBLEM;
+	}
+
+	//Where is it going? If it has a route with room, we decode it there.
+	if(!fx_route_peek(in->cb, addressed, &addr, &cmd_6bits))
+	{
+		first = fx_route_first(r, 0, addr, cmd_6bits);
+		if(first < r->routes)
+		{
+			slot = fx_tx_queue_reserve(r->route[first].out,
+					r->route[first].tx_class);
+			dst = slot ? slot->data : frame;
+		}
+	}
+
+	fx_codec_attach_stats(&in->stats.codec);
+	fx_codec_set_rx_address(FX_ADDR_NONE);	//We want every frame
+	ret_val = fx_decode(in->cb, dst, &len, NULL, NULL);
+	fx_codec_attach_stats(NULL);
+
+	if(ret_val || (len <= (MIN_OVERHEAD + addressed)))
+	{
+		return FX_PROBLEM;
+	}
+
+	//What we decoded can differ from what we peeked (a corrupted frame was
+	//skipped): the routes are decided on the frame itself. If it isn't going
+	//where we thought, it leaves the slot we borrowed.
+	fx_route_parse(dst, len, addressed, &addr, &cmd_6bits);
+	if(slot && (fx_route_first(r, 0, addr, cmd_6bits) != first))
+	{
+		memcpy(frame, dst, len);
+		dst = frame;
+		slot = NULL;
+	}
+
+	for(int i = fx_route_first(r, 0, addr, cmd_6bits); i < r->routes;
+			i = fx_route_first(r, i + 1, addr, cmd_6bits))
+	{
+		route = &r->route[i];
+		matches++;
+		if(slot && (i == first))
+		{
+			ret_val = fx_tx_queue_commit(route->out, route->tx_class, len);
+		}
+		else
+		{
+			ret_val = fx_tx_queue_frame(route->out, route->tx_class, dst, len);
+		}
+
+		if(!ret_val)
+		{
+			r->forwarded++;
+		}
+		else
+		{
+			r->dropped++;	//Also in the output port's frames_dropped
+		}
+	}
+
+	if(matches)
+	{
+		return FX_SUCCESS;
+	}
+
+	//Not for another port. On a multi-drop bus, is it for us?
+	if(addressed && (addr != in->addr) && (addr != FX_ADDR_BROADCAST) &&
+			!(FX_ADDR_IS_MULTICAST(addr) &&
+			((in->groups >> (addr - FX_ADDR_GROUP_0)) & 1)))
+	{
+		in->stats.codec.frames_filtered++;
+		return FX_PROBLEM;
+	}
+
+	r->local++;
+	return fx_receive_frame(in, frame, len);
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+static uint8_t fx_route_match(FxRoute *route, uint8_t addr, uint8_t cmd_6bits)
+{
+	if(route->type == RouteByAddr)
+	{
+		return ((addr != FX_ADDR_NONE) && (addr == route->key));
+	}
+
+	return (cmd_6bits == route->key);
+}
+
+//Index of the first route at or after 'start' that matches, r->routes if none
+static uint8_t fx_route_first(FxRouter *r, uint8_t start, uint8_t addr,
+		uint8_t cmd_6bits)
+{
+	uint8_t i = 0;
+
+	for(i = start; i < r->routes; i++)
+	{
+		if(fx_route_match(&r->route[i], addr, cmd_6bits))
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+//Destination and command code of the first frame in the buffer, read in
+//place. Returns 1 if there is no header or the frame is too short.
+static uint8_t fx_route_peek(circ_buf_t *cb, uint8_t addressed, uint8_t *addr,
+		uint8_t *cmd_6bits)
+{
+	uint8_t head[MIN_OVERHEAD + 1] = {0};	//[HEADER][#BYTES][(ADDR)][CMD][(CMD)]
+	uint16_t header_pos = 0;
+
+	if(circ_buf_search(cb, &header_pos, HEADER, 0))
+	{
+		return FX_PROBLEM;
+	}
+
+	for(int i = 0; i < (MIN_OVERHEAD + 1); i++)
+	{
+		if(circ_buf_peek(cb, &head[i], header_pos + i))
+		{
+			return FX_PROBLEM;
+		}
+	}
+
+	fx_route_parse(head, MIN_OVERHEAD + 2, addressed, addr, cmd_6bits);
+	return FX_SUCCESS;
+}
+
+//Destination and command code, straight from an encoded frame. The address
+//is never escaped, the command byte can be.
+static void fx_route_parse(uint8_t *frame, uint8_t len, uint8_t addressed,
+		uint8_t *addr, uint8_t *cmd_6bits)
+{
+	uint8_t cmd_byte = frame[2 + addressed];
+
+	*addr = addressed ? frame[2] : FX_ADDR_NONE;
+	if((cmd_byte == ESCAPE) && (len > (MIN_OVERHEAD + addressed + 1)))
+	{
+		cmd_byte = frame[3 + addressed];
+	}
+	*cmd_6bits = CMD_GET_6BITS(cmd_byte);
+}
+
+#ifdef __cplusplus
+}
+#endif
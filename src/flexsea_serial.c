@@ -0,0 +1,476 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jf at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_serial: serial ports and event loop for Linux hosts
+ ****************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//A host that talks to its devices from C doesn't need to poll: the ports are
+//non-blocking and registered with epoll. fx_serial_loop_run() sleeps until one
+//of them has data, reads everything that's waiting in large chunks, and calls
+//fx_receive() (your handlers) until the buffer is empty. Replies and acks
+//queued by the handlers are sent right away.
+//A host that polls its devices one at a time can block on the reply instead:
+//fx_wait_for_reply() sleeps in ppoll() and returns as soon as the frame it
+//waits for has been handled.
+//Ports are raw 8N1 termios devices, or pseudo-terminals for tests and
+//simulations (fx_serial_open_pty()).
+
+#if defined(__linux__)
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#define _GNU_SOURCE
+#include "flexsea.h"
+#include <flexsea_serial.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+//****************************************************************************
+// Private Function Prototype(s):
+//****************************************************************************
+
+static speed_t fx_serial_speed(uint32_t baud);
+static uint8_t fx_serial_configure(int fd, uint32_t baud);
+static ssize_t fx_serial_fill(FxSerialPort *port);
+static uint32_t fx_serial_read(FxSerialPort *port);
+static uint8_t fx_serial_receive_until(FxSerialPort *port, uint8_t cmd,
+		uint16_t pnum);
+static void fx_serial_send_replies(CommPort *cp);
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+//Open a serial port (ex.: "/dev/ttyACM0"): raw, 8N1, non-blocking. USB
+//adapters that support it are switched to low latency mode.
+//Returns 0 if it worked, 1 otherwise
+uint8_t fx_serial_open(const char *path, uint32_t baud, int *fd)
+{
+	struct serial_struct ss;
+
+	*fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if(*fd < 0)
+	{
+		return FX_PROBLEM;
+	}
+
+	if(fx_serial_configure(*fd, baud))
+	{
+		close(*fd);
+		*fd = -1;
+		return FX_PROBLEM;
+	}
+
+	//FTDI & co. buffer for up to 16 ms by default. Not supported everywhere
+	//(ptys, CDC ACM), that's fine.
+	if(!ioctl(*fd, TIOCGSERIAL, &ss))
+	{
+		ss.flags |= ASYNC_LOW_LATENCY;
+		ioctl(*fd, TIOCSSERIAL, &ss);
+	}
+
+	return FX_SUCCESS;
+}
+
+//Create a pseudo-terminal: we keep the master side, open 'slave_path' (ex.:
+//with fx_serial_open()) as if it was a device. Use it to test a host against
+//a simulated device, or the other way around.
+//Returns 0 if it worked, 1 otherwise
+uint8_t fx_serial_open_pty(int *master_fd, char *slave_path, uint16_t len)
+{
+	*master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if(*master_fd < 0)
+	{
+		return FX_PROBLEM;
+	}
+
+	if(grantpt(*master_fd) || unlockpt(*master_fd) ||
+			ptsname_r(*master_fd, slave_path, len) ||
+			fx_serial_configure(*master_fd, 0))
+	{
+		close(*master_fd);
+		*master_fd = -1;
+		return FX_PROBLEM;
+	}
+
+	return FX_SUCCESS;
+}
+
+//Write all the bytes. The port is non-blocking: if the kernel buffer is full
+//we wait until it drains.
+//Returns 0 if it worked, 1 otherwise
+uint8_t fx_serial_write(int fd, uint8_t *bytes, uint16_t len)
+{
+	struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+	ssize_t n = 0;
+
+	while(len)
+	{
+		n = write(fd, bytes, len);
+		if(n > 0)
+		{
+			bytes += n;
+			len -= n;
+		}
+		else if((n < 0) && (errno == EAGAIN))
+		{
+			if(poll(&pfd, 1, 100) <= 0)
+			{
+				return FX_PROBLEM;	//Stuck for 100 ms
+			}
+		}
+		else if(!((n < 0) && (errno == EINTR)))
+		{
+			return FX_PROBLEM;
+		}
+	}
+
+	return FX_SUCCESS;
+}
+
+void fx_serial_close(int fd)
+{
+	if(fd >= 0)
+	{
+		close(fd);
+	}
+}
+
+//Returns 0 if it worked, 1 otherwise
+uint8_t fx_serial_loop_init(FxSerialLoop *loop)
+{
+	memset(loop, 0, sizeof(FxSerialLoop));
+	loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	return (loop->epoll_fd < 0) ? FX_PROBLEM : FX_SUCCESS;
+}
+
+//Watch 'fd'. What it receives goes to 'cp' (its circular buffer, stats and
+//handlers). Set cp's tx_fct_prt to a function that calls fx_serial_write()
+//with the same fd.
+//Returns 0 if it worked, 1 otherwise
+uint8_t fx_serial_loop_add(FxSerialLoop *loop, int fd, CommPort *cp)
+{
+	struct epoll_event ev = {0};
+
+	if(loop->ports >= FX_SERIAL_MAX_PORTS)
+	{
+		return FX_PROBLEM;
+	}
+
+	ev.events = EPOLLIN;
+	ev.data.u32 = loop->ports;
+	if(epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev))
+	{
+		return FX_PROBLEM;
+	}
+
+	loop->port[loop->ports].fd = fd;
+	loop->port[loop->ports].cp = cp;
+	loop->port[loop->ports].frames = 0;
+	loop->ports++;
+
+	return FX_SUCCESS;
+}
+
+//Wait up to 'timeout_ms' (-1: forever, 0: don't wait) for data, then receive
+//and answer. No CPU is used while we wait.
+//Returns the number of frames decoded, -1 if epoll failed
+int fx_serial_loop_run(FxSerialLoop *loop, int timeout_ms)
+{
+	struct epoll_event ev[FX_SERIAL_MAX_PORTS];
+	FxSerialPort *port = NULL;
+	int n = 0, frames = 0;
+
+	n = epoll_wait(loop->epoll_fd, ev, FX_SERIAL_MAX_PORTS, timeout_ms);
+	if(n < 0)
+	{
+		return (errno == EINTR) ? 0 : -1;
+	}
+
+	loop->wakeups += (n > 0);
+	for(int i = 0; i < n; i++)
+	{
+		port = &loop->port[ev[i].data.u32];
+		frames += fx_serial_read(port);
+		fx_serial_send_replies(port->cp);
+	}
+
+	return frames;
+}
+
+//Stop watching the ports. They stay open, close them with fx_serial_close().
+void fx_serial_loop_close(FxSerialLoop *loop)
+{
+	if(loop->epoll_fd >= 0)
+	{
+		close(loop->epoll_fd);
+	}
+	loop->epoll_fd = -1;
+	loop->ports = 0;
+}
+
+//Block until 'cmd' is received on 'port' (a port of a loop, or one of your
+//own: {.fd = fd, .cp = &cp}), or until 'timeout_us' expires. Bytes are fed and
+//decoded as they arrive and every frame goes to its handler; we return as soon
+//as the matching frame has been handled. What follows it stays in the buffer.
+//'pnum' is the packet number an FX_CMD_ACK must acknowledge (read
+//get_last_tx_packet_num() after sending), or FX_PNUM_ANY. Other replies don't
+//carry the request's packet number: 'pnum' is ignored for them.
+//Returns 0 if the frame was received, 1 on timeout or error
+uint8_t fx_wait_for_reply(FxSerialPort *port, uint8_t cmd, uint16_t pnum,
+		uint32_t timeout_us)
+{
+	struct pollfd pfd = {.fd = port->fd, .events = POLLIN};
+	struct timespec now, left;
+	int64_t deadline_ns = 0, left_ns = 0;
+	ssize_t n = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	deadline_ns = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec +
+			(int64_t)timeout_us * 1000;
+
+	//Already in the buffer?
+	if(!fx_serial_receive_until(port, cmd, pnum))
+	{
+		fx_serial_send_replies(port->cp);
+		return FX_SUCCESS;
+	}
+
+	while(1)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		left_ns = deadline_ns - ((int64_t)now.tv_sec * 1000000000 + now.tv_nsec);
+		if(left_ns <= 0)
+		{
+			return FX_PROBLEM;
+		}
+
+		left.tv_sec = left_ns / 1000000000;
+		left.tv_nsec = left_ns % 1000000000;
+		n = ppoll(&pfd, 1, &left, NULL);
+		if((n < 0) && (errno != EINTR))
+		{
+			return FX_PROBLEM;
+		}
+		if((n > 0) && !(pfd.revents & POLLIN))
+		{
+			return FX_PROBLEM;	//Hung up, or bad fd
+		}
+
+		do
+		{
+			n = fx_serial_fill(port);
+			if(!fx_serial_receive_until(port, cmd, pnum))
+			{
+				fx_serial_send_replies(port->cp);
+				return FX_SUCCESS;
+			}
+		}while(n > 0);
+		fx_serial_send_replies(port->cp);
+	}
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+//Returns B0 if the rate isn't supported
+static speed_t fx_serial_speed(uint32_t baud)
+{
+	switch(baud)
+	{
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+		case 460800:	return B460800;
+		case 921600:	return B921600;
+		case 1000000:	return B1000000;
+		case 2000000:	return B2000000;
+		case 3000000:	return B3000000;
+		case 4000000:	return B4000000;
+		default:		return B0;
+	}
+}
+
+//Raw mode, 8N1, no flow control. 'baud' = 0 keeps the current rate (ptys).
+static uint8_t fx_serial_configure(int fd, uint32_t baud)
+{
+	struct termios tio;
+	speed_t speed = fx_serial_speed(baud);
+
+	if(tcgetattr(fd, &tio))
+	{
+		return FX_PROBLEM;
+	}
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= (CLOCAL | CREAD);
+	tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	if(baud)
+	{
+		if((speed == B0) || cfsetispeed(&tio, speed) ||
+				cfsetospeed(&tio, speed))
+		{
+			return FX_PROBLEM;
+		}
+	}
+
+	if(tcsetattr(fd, TCSANOW, &tio))
+	{
+		return FX_PROBLEM;
+	}
+
+	tcflush(fd, TCIOFLUSH);
+	return FX_SUCCESS;
+}
+
+//One read(), as much as the circular buffer can take.
+//Returns the number of bytes read (0: nothing waiting, or no room)
+static ssize_t fx_serial_fill(FxSerialPort *port)
+{
+	uint8_t chunk[FX_SERIAL_READ_CHUNK];
+	CommPort *cp = port->cp;
+	uint16_t room = CIRC_BUF_SIZE - cp->cb->length;
+	ssize_t n = 0;
+
+	if(room > FX_SERIAL_READ_CHUNK)
+	{
+		room = FX_SERIAL_READ_CHUNK;
+	}
+
+	n = (room > 0) ? read(port->fd, chunk, room) : 0;
+	if(n > 0)
+	{
+		cp->stats.rx_overflows += fx_feed(cp->cb, chunk, n);
+		cp->stats.bytes_received += n;
+	}
+
+	return n;
+}
+
+//Move everything the kernel has for us to the circular buffer, and decode as
+//we go: a burst can be larger than the buffer. A frame whose handler failed
+//(ex.: catch-all) doesn't stop us, the ones behind it are handled now.
+//Returns the number of frames decoded
+static uint32_t fx_serial_read(FxSerialPort *port)
+{
+	CommPort *cp = port->cp;
+	uint32_t frames = 0, count = 0;
+	uint16_t length = 0;
+	ssize_t n = 0;
+
+	do
+	{
+		n = fx_serial_fill(port);
+		do
+		{
+			count = cp->rx_last.count;
+			length = cp->cb->length;
+			fx_receive(cp);
+			frames += cp->rx_last.count - count;
+		}while((cp->rx_last.count != count) || (cp->cb->length != length));
+	}while(n > 0);
+
+	port->frames += frames;
+	return frames;
+}
+
+//Decode what's in the buffer, one frame at a time, and stop after the one we
+//are waiting for. Frames whose handler failed still count.
+//Returns 0 if it was found, 1 otherwise
+static uint8_t fx_serial_receive_until(FxSerialPort *port, uint8_t cmd,
+		uint16_t pnum)
+{
+	RxLast *last = &port->cp->rx_last;
+	uint32_t count = 0;
+	uint16_t length = 0;
+
+	do
+	{
+		count = last->count;
+		length = port->cp->cb->length;
+		fx_receive(port->cp);
+		if(last->count != count)
+		{
+			port->frames++;
+			if((last->cmd == cmd) && ((cmd != FX_CMD_ACK) ||
+					(pnum == FX_PNUM_ANY) || (last->acked == pnum)))
+			{
+				return FX_SUCCESS;
+			}
+		}
+	}while((last->count != count) || (port->cp->cb->length != length));
+
+	return FX_PROBLEM;
+}
+
+//Whatever the handlers queued. The TX queue is shallower than the reply queue:
+//we alternate until every reply is out, or until the port stops taking frames.
+static void fx_serial_send_replies(CommPort *cp)
+{
+	uint8_t progress = 0;
+
+	if(cp->tx_fct_prt == NULL)
+	{
+		return;
+	}
+
+	do
+	{
+		progress = fx_comm_process_replies(cp);
+		while(!fx_comm_process_tx_queue(cp))
+		{
+			progress = 1;
+		}
+	}while(progress && fx_reply_queue_length(cp));
+}
+
+#endif	//defined(__linux__)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,533 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jf at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_shm: shared-memory frame delivery between host processes
+ ****************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//When several processes need the same devices (a controller, a logger, a GUI)
+//one daemon owns the ports (demo/pc_daemon) and shares what it decodes. The
+//region is a POSIX shared memory object, mapped by everyone:
+//- RX: one ring per port and per command. The daemon is the only writer;
+//  readers don't register, they keep their own cursor and never block it. A
+//  slow reader loses the oldest frames, and knows how many.
+//- TX: one queue of encoded frames. Clients push without locks, the daemon
+//  pops and writes them to their port.
+//Sleeping readers (and the daemon, when the TX queue is empty) wait on a
+//futex: no system call is made when nobody sleeps.
+
+#if defined(__linux__)
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#define _GNU_SOURCE
+#include "flexsea.h"
+#include <flexsea_shm.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+//****************************************************************************
+// Private Function Prototype(s):
+//****************************************************************************
+
+static uint8_t fx_shm_map(FxShm *shm, const char *name, int fd);
+static uint64_t fx_shm_now_ns(void);
+static void fx_shm_deadline(struct timespec *ts, uint32_t timeout_us);
+static uint8_t fx_shm_futex_wait(volatile uint32_t *word, uint32_t value,
+		struct timespec *deadline);
+static void fx_shm_futex_wake(volatile uint32_t *word, int count);
+static uint8_t fx_shm_tx_pending(FxShmTxQueue *q);
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+//Daemon: create the region 'name' (ex.: "/flexsea", see shm_open()) for
+//'ports' ports. An object left behind by a daemon that died is replaced.
+//Returns 0 if it worked, 1 otherwise (ex.: another daemon is serving 'name')
+uint8_t fx_shm_create(FxShm *shm, const char *name, uint8_t ports)
+{
+	FxShm old;
+	int fd = -1;
+
+	memset(shm, 0, sizeof(FxShm));
+	if(!ports || (ports > FX_SHM_MAX_PORTS) ||
+			(strlen(name) >= FX_SHM_NAME_LEN))
+	{
+		return FX_PROBLEM;
+	}
+
+	if(!fx_shm_attach(&old, name))
+	{
+		if(!kill(old.region->pid, 0))
+		{
+			fx_shm_detach(&old);
+			return FX_PROBLEM;
+		}
+		fx_shm_detach(&old);
+	}
+	shm_unlink(name);
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if(fd < 0)
+	{
+		return FX_PROBLEM;
+	}
+	if(ftruncate(fd, sizeof(FxShmRegion)) || fx_shm_map(shm, name, fd))
+	{
+		close(fd);
+		shm_unlink(name);
+		return FX_PROBLEM;
+	}
+	close(fd);
+
+	//ftruncate() zeroed everything
+	for(uint32_t i = 0; i < FX_SHM_TX_DEPTH; i++)
+	{
+		shm->region->tx.slot[i].seq = i;
+	}
+	shm->region->version = FX_SHM_VERSION;
+	shm->region->size = sizeof(FxShmRegion);
+	shm->region->ports = ports;
+	shm->region->pid = getpid();
+	shm->region->alive = 1;
+	__atomic_store_n(&shm->region->magic, FX_SHM_MAGIC, __ATOMIC_RELEASE);
+	shm->owner = 1;
+
+	return FX_SUCCESS;
+}
+
+//Daemon: make a decoded frame ('buf', 'len' from
+//fx_get_cmd_handler_from_bytestream()) available to the readers of its
+//command on 'port'. Sleeping readers are woken up.
+//Returns 0 if it worked, 1 otherwise
+uint8_t fx_shm_publish(FxShm *shm, uint8_t port, uint8_t *buf, uint8_t len)
+{
+	FxShmRing *ring = NULL;
+	FxShmSlot *slot = NULL;
+	uint32_t n = 0, seq = 0;
+
+	if((port >= shm->region->ports) || (len < CMD_OVERHEAD) ||
+			(len > MAX_ENCODED_PAYLOAD_BYTES))
+	{
+		return FX_PROBLEM;
+	}
+
+	ring = &shm->region->rx[port][CMD_GET_6BITS(buf[CMD_CODE_INDEX])];
+	n = ring->published;
+	slot = &ring->slot[n & (FX_SHM_RX_DEPTH - 1)];
+
+	//Odd while we write
+	seq = slot->seq;
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->index = n;
+	slot->t_rx_ns = fx_shm_now_ns();
+	slot->len = len;
+	memcpy(slot->data, buf, len);
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&ring->published, n + 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&ring->waiters, __ATOMIC_SEQ_CST))
+	{
+		fx_shm_futex_wake(&ring->published, INT_MAX);
+	}
+
+	return FX_SUCCESS;
+}
+
+//Daemon: oldest frame waiting to be sent, and its port index
+//Returns 0 if there was one, 1 if the queue is empty
+uint8_t fx_shm_tx_pop(FxShm *shm, uint8_t *port, uint8_t *frame,
+		uint8_t *len)
+{
+	FxShmTxQueue *q = &shm->region->tx;
+	uint32_t pos = q->tail;
+	FxShmTxSlot *slot = &q->slot[pos & (FX_SHM_TX_DEPTH - 1)];
+
+	if(!fx_shm_tx_pending(q))
+	{
+		return FX_PROBLEM;
+	}
+
+	*port = slot->port;
+	*len = slot->len;
+	memcpy(frame, slot->data, slot->len);
+	__atomic_store_n(&slot->seq, pos + FX_SHM_TX_DEPTH, __ATOMIC_RELEASE);
+	__atomic_store_n(&q->tail, pos + 1, __ATOMIC_RELAXED);
+
+	return FX_SUCCESS;
+}
+
+//Daemon: sleep until a client pushes a frame, or 'timeout_us' expires
+//Returns 0 if a frame is waiting, 1 on timeout
+uint8_t fx_shm_tx_wait(FxShm *shm, uint32_t timeout_us)
+{
+	FxShmTxQueue *q = &shm->region->tx;
+	struct timespec deadline;
+	uint32_t doorbell = 0;
+	uint8_t ret_val = FX_PROBLEM;
+
+	fx_shm_deadline(&deadline, timeout_us);
+	__atomic_store_n(&q->sleeping, 1, __ATOMIC_SEQ_CST);
+	while(1)
+	{
+		//Read the doorbell before we look: a push in between changes it, and
+		//the futex won't let us sleep
+		doorbell = __atomic_load_n(&q->doorbell, __ATOMIC_SEQ_CST);
+		if(fx_shm_tx_pending(q))
+		{
+			ret_val = FX_SUCCESS;
+			break;
+		}
+		if(fx_shm_futex_wait(&q->doorbell, doorbell, &deadline))
+		{
+			ret_val = fx_shm_tx_pending(q) ? FX_SUCCESS : FX_PROBLEM;
+			break;
+		}
+	}
+	__atomic_store_n(&q->sleeping, 0, __ATOMIC_SEQ_CST);
+
+	return ret_val;
+}
+
+//Daemon: unmap and remove the region. Clients that are still attached keep
+//their mapping, and see 'alive' cleared.
+void fx_shm_destroy(FxShm *shm)
+{
+	if(shm->region == NULL)
+	{
+		return;
+	}
+
+	__atomic_store_n(&shm->region->alive, 0, __ATOMIC_RELEASE);
+	fx_shm_detach(shm);
+	shm_unlink(shm->name);
+	shm->owner = 0;
+}
+
+//Client: map the region a daemon created
+//Returns 0 if it worked, 1 otherwise (no daemon, or a different version)
+uint8_t fx_shm_attach(FxShm *shm, const char *name)
+{
+	struct stat st;
+	int fd = -1;
+
+	memset(shm, 0, sizeof(FxShm));
+	if(strlen(name) >= FX_SHM_NAME_LEN)
+	{
+		return FX_PROBLEM;
+	}
+
+	fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+	if(fd < 0)
+	{
+		return FX_PROBLEM;
+	}
+	if(fstat(fd, &st) || (st.st_size != sizeof(FxShmRegion)) ||
+			fx_shm_map(shm, name, fd))
+	{
+		close(fd);
+		return FX_PROBLEM;
+	}
+	close(fd);
+
+	if((__atomic_load_n(&shm->region->magic, __ATOMIC_ACQUIRE) != FX_SHM_MAGIC)
+			|| (shm->region->version != FX_SHM_VERSION) ||
+			(shm->region->size != sizeof(FxShmRegion)) ||
+			!shm->region->alive)
+	{
+		fx_shm_detach(shm);
+		return FX_PROBLEM;
+	}
+
+	return FX_SUCCESS;
+}
+
+//Client: follow 'cmd' on 'port'. Only frames published from now on are read.
+//Returns 0 if it worked, 1 if 'port' or 'cmd' is invalid
+uint8_t fx_shm_reader_init(FxShm *shm, FxShmReader *r, uint8_t port,
+		uint8_t cmd)
+{
+	memset(r, 0, sizeof(FxShmReader));
+	if((port >= shm->region->ports) || (cmd > MAX_CMD_CODE))
+	{
+		return FX_PROBLEM;
+	}
+
+	r->port = port;
+	r->cmd = cmd;
+	r->next = __atomic_load_n(&shm->region->rx[port][cmd].published,
+			__ATOMIC_ACQUIRE);
+
+	return FX_SUCCESS;
+}
+
+//Client: copy the next frame in 'buf' (MAX_ENCODED_PAYLOAD_BYTES), without
+//blocking. Frames that were overwritten before we got to them are skipped,
+//and counted in r->lost.
+//Returns 0 if we got a frame, 1 if there's nothing new
+uint8_t fx_shm_read(FxShm *shm, FxShmReader *r, uint8_t *buf, uint8_t *len)
+{
+	FxShmRing *ring = &shm->region->rx[r->port][r->cmd];
+	FxShmSlot *slot = NULL;
+	uint32_t published = 0, seq = 0, index = 0;
+	uint8_t n = 0;
+
+	while(1)
+	{
+		published = __atomic_load_n(&ring->published, __ATOMIC_ACQUIRE);
+		if(published == r->next)
+		{
+			return FX_PROBLEM;
+		}
+		if(published - r->next > FX_SHM_RX_DEPTH)
+		{
+			r->lost += published - FX_SHM_RX_DEPTH - r->next;
+			r->next = published - FX_SHM_RX_DEPTH;
+		}
+
+		slot = &ring->slot[r->next & (FX_SHM_RX_DEPTH - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if(seq & 1)
+		{
+			continue;	//Being overwritten: we are late
+		}
+
+		index = slot->index;
+		n = slot->len;
+		n = (n > MAX_ENCODED_PAYLOAD_BYTES) ? MAX_ENCODED_PAYLOAD_BYTES : n;
+		memcpy(buf, slot->data, n);
+		r->t_rx_ns = slot->t_rx_ns;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if((__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) ||
+				(index != r->next))
+		{
+			continue;	//Torn, or already a newer frame
+		}
+
+		*len = n;
+		r->next++;
+		return FX_SUCCESS;
+	}
+}
+
+//Client: copy the most recent frame, skip the older ones (ex.: a GUI that
+//refreshes at its own rate). Skipped frames aren't counted as lost.
+//Returns 0 if we got a frame, 1 if there's nothing new
+uint8_t fx_shm_read_latest(FxShm *shm, FxShmReader *r, uint8_t *buf,
+		uint8_t *len)
+{
+	uint32_t published = __atomic_load_n(
+			&shm->region->rx[r->port][r->cmd].published, __ATOMIC_ACQUIRE);
+
+	if(published != r->next)
+	{
+		r->next = published - 1;
+	}
+
+	return fx_shm_read(shm, r, buf, len);
+}
+
+//Client: sleep until the reader has a frame to read, or 'timeout_us' expires
+//Returns 0 if a frame is ready, 1 on timeout
+uint8_t fx_shm_wait(FxShm *shm, FxShmReader *r, uint32_t timeout_us)
+{
+	FxShmRing *ring = &shm->region->rx[r->port][r->cmd];
+	struct timespec deadline;
+	uint32_t published = 0;
+	uint8_t ret_val = FX_PROBLEM;
+
+	fx_shm_deadline(&deadline, timeout_us);
+	__atomic_add_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+	while(1)
+	{
+		published = __atomic_load_n(&ring->published, __ATOMIC_SEQ_CST);
+		if(published != r->next)
+		{
+			ret_val = FX_SUCCESS;
+			break;
+		}
+		if(fx_shm_futex_wait(&ring->published, published, &deadline))
+		{
+			break;
+		}
+	}
+	__atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+
+	return ret_val;
+}
+
+//Client: queue an encoded frame (fx_create_bytestream_from_cmd()) for 'port'.
+//Safe from any number of processes and threads. Packet numbers are per
+//process: match acks with your own frames' contents if several clients ask
+//for them on the same port.
+//Returns 0 if it worked, 1 if the queue is full or the frame is invalid
+uint8_t fx_shm_tx_push(FxShm *shm, uint8_t port, uint8_t *frame, uint8_t len)
+{
+	FxShmTxQueue *q = &shm->region->tx;
+	FxShmTxSlot *slot = NULL;
+	uint32_t pos = 0, seq = 0;
+	int32_t diff = 0;
+
+	if((port >= shm->region->ports) || !len ||
+			(len > MAX_ENCODED_PAYLOAD_BYTES))
+	{
+		return FX_PROBLEM;
+	}
+
+	//Claim a slot: it's free when its sequence number is our position
+	pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+	while(1)
+	{
+		slot = &q->slot[pos & (FX_SHM_TX_DEPTH - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		diff = (int32_t)(seq - pos);
+		if(diff == 0)
+		{
+			if(__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if(diff < 0)
+		{
+			return FX_PROBLEM;	//Full
+		}
+		else
+		{
+			pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->port = port;
+	slot->len = len;
+	memcpy(slot->data, frame, len);
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&q->doorbell, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&q->sleeping, __ATOMIC_SEQ_CST))
+	{
+		fx_shm_futex_wake(&q->doorbell, 1);
+	}
+
+	return FX_SUCCESS;
+}
+
+void fx_shm_detach(FxShm *shm)
+{
+	if(shm->region != NULL)
+	{
+		munmap(shm->region, sizeof(FxShmRegion));
+	}
+	shm->region = NULL;
+}
+
+//****************************************************************************
+// Private Function(s)
+//****************************************************************************
+
+static uint8_t fx_shm_map(FxShm *shm, const char *name, int fd)
+{
+	void *p = mmap(NULL, sizeof(FxShmRegion), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+
+	if(p == MAP_FAILED)
+	{
+		return FX_PROBLEM;
+	}
+
+	shm->region = (FxShmRegion *)p;
+	strncpy(shm->name, name, FX_SHM_NAME_LEN - 1);
+	return FX_SUCCESS;
+}
+
+static uint64_t fx_shm_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//Absolute CLOCK_MONOTONIC time, 'timeout_us' from now
+static void fx_shm_deadline(struct timespec *ts, uint32_t timeout_us)
+{
+	uint64_t t = fx_shm_now_ns() + (uint64_t)timeout_us * 1000;
+
+	ts->tv_sec = t / 1000000000;
+	ts->tv_nsec = t % 1000000000;
+}
+
+//Sleep while '*word' is 'value'. Returns 1 once the deadline has passed.
+static uint8_t fx_shm_futex_wait(volatile uint32_t *word, uint32_t value,
+		struct timespec *deadline)
+{
+	//Shared futex (no FUTEX_PRIVATE_FLAG): the word is mapped by other
+	//processes. FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC time.
+	if(syscall(SYS_futex, word, FUTEX_WAIT_BITSET, value, deadline, NULL,
+			FUTEX_BITSET_MATCH_ANY) && (errno == ETIMEDOUT))
+	{
+		return FX_PROBLEM;
+	}
+
+	return FX_SUCCESS;
+}
+
+static void fx_shm_futex_wake(volatile uint32_t *word, int count)
+{
+	syscall(SYS_futex, word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+//The slot at the tail was filled
+static uint8_t fx_shm_tx_pending(FxShmTxQueue *q)
+{
+	uint32_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+	FxShmTxSlot *slot = &q->slot[pos & (FX_SHM_TX_DEPTH - 1)];
+
+	return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == pos + 1;
+}
+
+#endif	//defined(__linux__)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,160 @@
+/****************************************************************************
+ [Project] FlexSEA: Flexible & Scalable Electronics Architecture v2
+ Copyright (C) 2024 JFDuval Engineering LLC
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ [Lead developer] Jean-Francois (JF) Duval, jf at jfduvaleng dot com.
+ [Origin] Based on Jean-Francois Duval's work at the MIT Media Lab
+ Biomechatronics research group <http://biomech.media.mit.edu/> (2013-2015)
+ [Contributors to v1] Work maintained and expended by Dephy, Inc. (2015-20xx)
+ [v2.0] Complete re-write based on the original idea. (2024)
+ *****************************************************************************
+ [This file] flexsea_trace: low-overhead event trace ring
+ ****************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//The stack records fixed-size events (frame start, decode, handlers, TX) in a
+//RAM ring. The ring keeps the most recent FX_TRACE_DEPTH events. The host
+//freezes it, reads it in pages with FX_CMD_DIAG / FX_DIAG_TRACE, and rebuilds
+//a timeline (see flexsea_tools.py/decode_trace()).
+
+//****************************************************************************
+// Include(s)
+//****************************************************************************
+
+#include "flexsea.h"
+#include <flexsea_trace.h>
+
+//****************************************************************************
+// Variable(s)
+//****************************************************************************
+
+#if FX_TRACE_ENABLE
+static FxTraceEvent trace_ring[FX_TRACE_DEPTH];
+static volatile uint32_t trace_count = 0;	//Events recorded since the last clear
+static volatile uint8_t trace_running = 1;
+#endif
+
+//****************************************************************************
+// Public Function(s)
+//****************************************************************************
+
+//Add an event to the ring. Use FX_TRACE() rather than calling this directly,
+//it compiles to nothing when tracing is disabled.
+//Not reentrant: only call it from one context (your main loop), never from an
+//interrupt. An interrupt that records between our index update and our write
+//would corrupt an event.
+void fx_trace_record(uint8_t event, uint8_t port, uint16_t arg)
+{
+#if FX_TRACE_ENABLE
+	fx_trace_record_at(FX_TIMESTAMP(), event, port, arg);
+#else
+	(void)event;
+	(void)port;
+	(void)arg;
+#endif
+}
+
+//Same as fx_trace_record(), for an event timestamped earlier (ex.: in an
+//interrupt, see fx_comm_tx_done()). Use FX_TRACE_AT(). The ring is then not
+//in timestamp order anymore. Same context rules as fx_trace_record().
+void fx_trace_record_at(uint32_t timestamp, uint8_t event, uint8_t port,
+		uint16_t arg)
+{
+#if FX_TRACE_ENABLE
+	FxTraceEvent *e = NULL;
+
+	if(!trace_running)
+	{
+		return;
+	}
+
+	e = &trace_ring[trace_count & (FX_TRACE_DEPTH - 1)];
+	trace_count++;
+	e->timestamp = timestamp;
+	e->event = event;
+	e->port = port;
+	e->arg = arg;
+#else
+	(void)timestamp;
+	(void)event;
+	(void)port;
+	(void)arg;
+#endif
+}
+
+//Stop, start or clear the ring (FX_TRACE_CTRL_x)
+void fx_trace_control(uint8_t ctrl)
+{
+#if FX_TRACE_ENABLE
+	switch(ctrl)
+	{
+		case FX_TRACE_CTRL_STOP:
+			trace_running = 0;
+			break;
+		case FX_TRACE_CTRL_START:
+			trace_running = 1;
+			break;
+		case FX_TRACE_CTRL_CLEAR:
+			trace_count = 0;
+			break;
+	}
+#else
+	(void)ctrl;
+#endif
+}
+
+//Number of events recorded since the last clear. The ring holds the last
+//FX_TRACE_DEPTH of them.
+uint32_t fx_trace_get_count(void)
+{
+#if FX_TRACE_ENABLE
+	return trace_count;
+#else
+	return 0;
+#endif
+}
+
+//Copy up to 'max' events, starting at 'first' (0 is the oldest event still in
+//the ring). Stop the ring first to get a consistent dump.
+//Returns the number of events copied
+uint16_t fx_trace_read(uint16_t first, FxTraceEvent *events, uint16_t max)
+{
+#if FX_TRACE_ENABLE
+	uint32_t count = trace_count;
+	uint32_t available = (count < FX_TRACE_DEPTH) ? count : FX_TRACE_DEPTH;
+	uint32_t oldest = count - available;
+	uint16_t i = 0;
+
+	for(i = 0; (i < max) && ((first + i) < available); i++)
+	{
+		events[i] = trace_ring[(oldest + first + i) & (FX_TRACE_DEPTH - 1)];
+	}
+
+	return i;
+#else
+	(void)first;
+	(void)events;
+	(void)max;
+	return 0;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
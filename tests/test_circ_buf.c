@@ -616,6 +616,45 @@ void test_circ_buf_successive_rw(void)
 	TEST_ASSERT_EQUAL(0, cb.length);
 }
 
+//Multi-byte writes: wrap-around, and refusing what doesn't fit
+void test_circ_buf_write_many(void)
+{
+	circ_buf_t cb = {.buffer = {0}, .length = 0, .write_index = 0, .read_index =
+			0};
+	uint8_t w_array[CIRC_BUF_SIZE] = {0};
+	uint8_t r_byte = 0;
+	int i = 0;
+
+	for(i = 0; i < CIRC_BUF_SIZE; i++)
+	{
+		w_array[i] = (uint8_t)i;
+	}
+
+	//Move the indexes close to the end, then write across it
+	TEST_ASSERT_EQUAL(0, circ_buf_write(&cb, w_array, CIRC_BUF_SIZE - 10));
+	for(i = 0; i < CIRC_BUF_SIZE - 10; i++)
+	{
+		circ_buf_read_byte(&cb, &r_byte);
+	}
+	TEST_ASSERT_EQUAL(0, circ_buf_write(&cb, w_array, 25));
+	TEST_ASSERT_EQUAL(25, cb.length);
+	TEST_ASSERT_EQUAL(15, cb.write_index);
+	for(i = 0; i < 25; i++)
+	{
+		TEST_ASSERT_EQUAL(0, circ_buf_read_byte(&cb, &r_byte));
+		TEST_ASSERT_EQUAL(w_array[i], r_byte);
+	}
+
+	//Too much: we keep what fits
+	TEST_ASSERT_EQUAL(0, circ_buf_write(&cb, w_array, 0));
+	TEST_ASSERT_EQUAL(0, circ_buf_write(&cb, w_array, CIRC_BUF_SIZE - 5));
+	TEST_ASSERT_EQUAL(10, circ_buf_write(&cb, w_array, 15));
+	TEST_ASSERT_EQUAL(CIRC_BUF_SIZE, cb.length);
+	TEST_ASSERT_EQUAL(cb.read_index, cb.write_index);
+	circ_buf_peek(&cb, &r_byte, CIRC_BUF_SIZE - 1);
+	TEST_ASSERT_EQUAL(w_array[4], r_byte);
+}
+
 void test_circ_buf(void)
 {
 	RUN_TEST(test_circ_buf_w);
@@ -627,6 +666,7 @@ void test_circ_buf(void)
 	RUN_TEST(test_circ_buf_checksum);
 	RUN_TEST(test_circ_buf_massive_w);
 	RUN_TEST(test_circ_buf_successive_rw);
+	RUN_TEST(test_circ_buf_write_many);
 
 	fflush(stdout);
 }
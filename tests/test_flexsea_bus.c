@@ -0,0 +1,180 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tests.h"
+#include "flexsea.h"
+
+//Simulated transceivers and UART
+static uint8_t select_log[16][2];
+static uint8_t select_cnt = 0;
+static uint8_t bus_tx_cnt = 0;
+static uint8_t bus_tx_last[MAX_ENCODED_PAYLOAD_BYTES];
+static uint8_t bus_replies = 0;
+
+static void bus_select(uint8_t channel, uint8_t dir)
+{
+	if(select_cnt < 16)
+	{
+		select_log[select_cnt][0] = channel;
+		select_log[select_cnt][1] = dir;
+		select_cnt++;
+	}
+}
+
+static uint8_t bus_tx(uint8_t *bytes, uint16_t len)
+{
+	memcpy(bus_tx_last, bytes, len);
+	bus_tx_cnt++;
+	return 0;
+}
+
+static uint8_t bus_reply_handler(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
+		uint8_t *buf, uint8_t len)
+{
+	bus_replies++;
+	return FX_SUCCESS;
+}
+
+static uint8_t bus_failing_handler(uint8_t cmd_6bits, ReadWrite rw,
+		AckNack ack, uint8_t *buf, uint8_t len)
+{
+	bus_replies++;
+	return FX_PROBLEM;
+}
+
+static void bus_inject(circ_buf_t *cb, uint8_t cmd)
+{
+	uint8_t data[2] = {1, 2};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+
+	fx_create_bytestream_from_cmd(cmd, CmdWrite, Nack, data, 2, bytestream,
+			&bytestream_len);
+	circ_buf_write(cb, bytestream, bytestream_len);
+}
+
+//Two reads on two channels (one answered, one not) and a write
+void test_bus_poll_table(void)
+{
+	static circ_buf_t cb;
+	CommPort cp;
+	FxBus bus;
+	uint8_t data[2] = {1, 2};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+
+	circ_buf_init(&cb);
+	fx_comm_port_init(&cp, 0, &cb, &bus_tx);
+	fx_bus_init(&bus, &cp, &bus_select, 1000);
+	fx_register_rx_cmd_handler(12, &bus_reply_handler);
+	select_cnt = 0;
+	bus_tx_cnt = 0;
+	bus_replies = 0;
+
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 0));	//Empty table
+	TEST_ASSERT_EQUAL(0, fx_bus_add_poll(&bus, 0, FX_ADDR_NONE, 12, CmdRead,
+			Nack, data, 2));
+	TEST_ASSERT_EQUAL(0, fx_bus_add_poll(&bus, 1, FX_ADDR_NONE, 12, CmdRead,
+			Nack, data, 2));
+	TEST_ASSERT_EQUAL(0, fx_bus_add_poll(&bus, 1, FX_ADDR_NONE, 13, CmdWrite,
+			Nack, data, 2));
+	TEST_ASSERT_EQUAL(1, fx_bus_add_poll(&bus, 1, FX_ADDR_NONE, 13, CmdWrite,
+			Nack, data, FX_BUS_POLL_BYTES + 1));
+
+	//First request: TX, then RX on channel 0. The next one gets encoded.
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 0));
+	TEST_ASSERT_EQUAL(1, bus_tx_cnt);
+	TEST_ASSERT_EQUAL(2, select_cnt);
+	TEST_ASSERT_EQUAL(0, select_log[0][0]);
+	TEST_ASSERT_EQUAL(FX_BUS_TX, select_log[0][1]);
+	TEST_ASSERT_EQUAL(FX_BUS_RX, select_log[1][1]);
+	TEST_ASSERT_EQUAL(BusWaitReply, bus.state);
+	TEST_ASSERT_EQUAL(1, bus.next_poll);
+
+	//The device answers
+	fx_create_bytestream_from_cmd(12, CmdWrite, Nack, data, 2, bytestream,
+			&bytestream_len);
+	for(int i = 0; i < bytestream_len; i++)
+	{
+		circ_buf_write_byte(&cb, bytestream[i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 100));
+	TEST_ASSERT_EQUAL(1, bus_replies);
+	TEST_ASSERT_EQUAL(1, bus.poll[0].replies);
+	TEST_ASSERT_EQUAL(1, bus.current);
+
+	//Second request, channel 1: nobody answers
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 200));
+	TEST_ASSERT_EQUAL(2, bus_tx_cnt);
+	TEST_ASSERT_EQUAL(1, select_log[2][0]);
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 1199));
+	TEST_ASSERT_EQUAL(0, bus.poll[1].timeouts);
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 1200));
+	TEST_ASSERT_EQUAL(1, bus.poll[1].timeouts);
+
+	//Write without Ack: we don't wait, and that's the end of the cycle
+	TEST_ASSERT_EQUAL(1, fx_bus_run(&bus, 1300));
+	TEST_ASSERT_EQUAL(3, bus_tx_cnt);
+	TEST_ASSERT_EQUAL(13, CMD_GET_6BITS(bus_tx_last[2]));
+	TEST_ASSERT_EQUAL(1, bus.cycles);
+	TEST_ASSERT_EQUAL(0, bus.current);
+	TEST_ASSERT_EQUAL(3, cp.stats.frames_sent);
+}
+
+//The reply is the frame with the polled command, not whatever fx_receive()
+//liked
+void test_bus_reply_detection(void)
+{
+	static circ_buf_t cb;
+	CommPort cp;
+	FxBus bus;
+	uint8_t data[2] = {1, 2};
+
+	circ_buf_init(&cb);
+	fx_comm_port_init(&cp, 0, &cb, &bus_tx);
+	fx_bus_init(&bus, &cp, &bus_select, 1000);
+	fx_register_rx_cmd_handler(12, &bus_reply_handler);
+	fx_register_rx_cmd_handler(20, &bus_failing_handler);
+	bus_replies = 0;
+
+	TEST_ASSERT_EQUAL(0, fx_bus_add_poll(&bus, 0, FX_ADDR_NONE, 20, CmdRead,
+			Nack, data, 2));
+	TEST_ASSERT_EQUAL(0, fx_bus_add_poll(&bus, 1, FX_ADDR_NONE, 13, CmdWrite,
+			Ack, data, 2));
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 0));
+
+	//Another command: its handler is happy, but it's not our reply
+	bus_inject(&cb, 12);
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 100));
+	TEST_ASSERT_EQUAL(1, bus_replies);
+	TEST_ASSERT_EQUAL(0, bus.poll[0].replies);
+	TEST_ASSERT_EQUAL(0, bus.current);
+
+	//Ours: its handler fails, it's still a reply and not a timeout
+	bus_inject(&cb, 20);
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 200));
+	TEST_ASSERT_EQUAL(2, bus_replies);
+	TEST_ASSERT_EQUAL(1, bus.poll[0].replies);
+	TEST_ASSERT_EQUAL(0, bus.poll[0].timeouts);
+	TEST_ASSERT_EQUAL(1, bus.current);
+
+	//A Write with Ack is answered by FX_CMD_ACK
+	TEST_ASSERT_EQUAL(0, fx_bus_run(&bus, 300));
+	bus_inject(&cb, FX_CMD_ACK);
+	TEST_ASSERT_EQUAL(1, fx_bus_run(&bus, 400));
+	TEST_ASSERT_EQUAL(1, bus.poll[1].replies);
+	TEST_ASSERT_EQUAL(0, bus.poll[1].timeouts);
+}
+
+void test_flexsea_bus(void)
+{
+	RUN_TEST(test_bus_poll_table);
+	RUN_TEST(test_bus_reply_detection);
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
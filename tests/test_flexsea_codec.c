@@ -581,6 +581,262 @@ void test_codec_fx_cleanup_many_headers_in_noise(void)
 	TEST_ASSERT_EQUAL_MESSAGE(5, cb.length, "Cleanup deleted too many bytes!");
 }
 
+//Do the codec counters see escapes, bad frames and noise?
+void test_codec_stats(void)
+{
+	fx_codec_stats_t stats = {0};
+	uint8_t payload[4] = {'a', HEADER, 'c', 'd'};
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t encoded_len = 0;
+	uint8_t decoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t decoded_len = 0;
+	uint8_t ret_val = 0;
+	circ_buf_t cb = {.buffer = {0}, .length = 0, .write_index = 0, .read_index =
+			0};
+
+	fx_codec_attach_stats(&stats);
+
+	//One escape
+	ret_val = fx_encode(payload, 4, encoded, &encoded_len,
+			MAX_ENCODED_PAYLOAD_BYTES);
+	TEST_ASSERT_EQUAL(0, ret_val);
+	TEST_ASSERT_EQUAL(1, stats.escapes_encoded);
+
+	//Noise, a frame with a bad checksum, a frame with a bad footer, and a
+	//good frame
+	payload[1] = 'b';
+	fx_encode(payload, 4, encoded, &encoded_len, MAX_ENCODED_PAYLOAD_BYTES);
+	circ_buf_write_byte(&cb, 0x12);
+	circ_buf_write_byte(&cb, 0x34);
+	for(int i = 0; i < encoded_len; i++)
+	{
+		circ_buf_write_byte(&cb, (i == (encoded_len - 2)) ? encoded[i] + 1 :
+				encoded[i]);
+	}
+	for(int i = 0; i < encoded_len; i++)
+	{
+		circ_buf_write_byte(&cb, (i == (encoded_len - 1)) ? 0 : encoded[i]);
+	}
+	for(int i = 0; i < encoded_len; i++)
+	{
+		circ_buf_write_byte(&cb, encoded[i]);
+	}
+
+	ret_val = fx_decode(&cb, encoded, &encoded_len, decoded, &decoded_len);
+	TEST_ASSERT_EQUAL(0, ret_val);
+	TEST_ASSERT_EQUAL(1, stats.frames_decoded);
+	TEST_ASSERT_EQUAL(1, stats.checksum_errors);
+	TEST_ASSERT_EQUAL(1, stats.footer_errors);
+	TEST_ASSERT_EQUAL(2 + 2 * encoded_len, stats.bytes_discarded);
+	TEST_ASSERT_EQUAL(0, cb.length);
+
+	//Failed searches don't count the same bytes twice
+	for(int i = 0; i < encoded_len - 1; i++)
+	{
+		circ_buf_write_byte(&cb, (i == (encoded_len - 2)) ? encoded[i] + 1 :
+				encoded[i]);
+	}
+	circ_buf_write_byte(&cb, FOOTER);
+	for(int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL(1, fx_decode(&cb, encoded, &encoded_len, decoded,
+				&decoded_len));
+	}
+	TEST_ASSERT_EQUAL(1, stats.checksum_errors);
+
+	//fx_cleanup() counts what it flushes
+	circ_buf_init(&cb);
+	circ_buf_write_byte(&cb, 0x12);
+	circ_buf_write_byte(&cb, 0x34);
+	circ_buf_write_byte(&cb, HEADER);
+	fx_cleanup(&cb);
+	TEST_ASSERT_EQUAL(2 + 2 * 8 + 2, stats.bytes_discarded);
+
+	//Detached: nothing changes
+	fx_codec_attach_stats(NULL);
+	fx_encode(payload, 4, encoded, &encoded_len, MAX_ENCODED_PAYLOAD_BYTES);
+	circ_buf_write_byte(&cb, 0x12);
+	fx_cleanup(&cb);
+	TEST_ASSERT_EQUAL(2 + 2 * 8 + 2, stats.bytes_discarded);
+}
+
+//A buffer full of false headers: the ones that can't start a frame anymore
+//are flushed, and the frame that follows the noise gets decoded
+void test_codec_decode_header_noise(void)
+{
+	fx_codec_stats_t stats = {0};
+	uint8_t payload[4] = {'a', 'b', 'c', 'd'};
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t encoded_len = 0;
+	uint8_t decoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t decoded_len = 0;
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t frame_len = 0;
+	circ_buf_t cb = {.buffer = {0}, .length = 0, .write_index = 0, .read_index =
+			0};
+
+	fx_encode(payload, 4, frame, &frame_len, MAX_ENCODED_PAYLOAD_BYTES);
+	fx_codec_attach_stats(&stats);
+	for(int i = 0; i < CIRC_BUF_SIZE; i++)
+	{
+		circ_buf_write_byte(&cb, HEADER);
+	}
+
+	//Only what could still be the start of a frame stays
+	TEST_ASSERT_EQUAL(1, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(MAX_ENCODED_PAYLOAD_BYTES, cb.length);
+	TEST_ASSERT_EQUAL(CIRC_BUF_SIZE - MAX_ENCODED_PAYLOAD_BYTES,
+			stats.bytes_discarded);
+	TEST_ASSERT_EQUAL(1, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(MAX_ENCODED_PAYLOAD_BYTES, cb.length);
+
+	//There is room for the frame now
+	for(int i = 0; i < frame_len; i++)
+	{
+		circ_buf_write_byte(&cb, frame[i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(4, decoded_len);
+	TEST_ASSERT_EQUAL(0, memcmp(payload, decoded, 4));
+	TEST_ASSERT_EQUAL(0, cb.length);
+	TEST_ASSERT_EQUAL(1, stats.frames_decoded);
+	TEST_ASSERT_EQUAL(CIRC_BUF_SIZE, stats.bytes_discarded);
+	fx_codec_attach_stats(NULL);
+}
+
+//Multi-drop: frames for other nodes are flushed, ours lose their address
+void test_codec_address_filter(void)
+{
+	fx_codec_stats_t stats = {0};
+	uint8_t payload[4] = {'a', HEADER, 'c', 'd'};
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t encoded_len = 0;
+	uint8_t decoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t decoded_len = 0;
+	circ_buf_t cb = {.buffer = {0}, .length = 0, .write_index = 0, .read_index =
+			0};
+
+	//The address is the first payload byte, never escaped
+	TEST_ASSERT_EQUAL(0, fx_encode_addr(7, payload, 4, encoded, &encoded_len,
+			MAX_ENCODED_PAYLOAD_BYTES));
+	TEST_ASSERT_EQUAL(MIN_OVERHEAD + 1 + 4 + 1, encoded_len);
+	TEST_ASSERT_EQUAL(6, encoded[1]);
+	TEST_ASSERT_EQUAL(7, encoded[2]);
+	TEST_ASSERT_EQUAL(1, fx_encode_addr(ESCAPE, payload, 4, encoded,
+			&encoded_len, MAX_ENCODED_PAYLOAD_BYTES));
+
+	//Frame for node 3, then for node 7
+	fx_codec_attach_stats(&stats);
+	fx_codec_set_rx_address(7);
+	fx_encode_addr(3, payload, 4, encoded, &encoded_len,
+			MAX_ENCODED_PAYLOAD_BYTES);
+	for(int i = 0; i < encoded_len; i++)
+	{
+		circ_buf_write_byte(&cb, encoded[i]);
+	}
+	fx_encode_addr(7, payload, 4, encoded, &encoded_len,
+			MAX_ENCODED_PAYLOAD_BYTES);
+	for(int i = 0; i < encoded_len; i++)
+	{
+		circ_buf_write_byte(&cb, encoded[i]);
+	}
+
+	uint8_t frame_len = encoded_len;
+
+	TEST_ASSERT_EQUAL(1, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(1, stats.frames_filtered);
+	TEST_ASSERT_EQUAL(frame_len, cb.length);
+	TEST_ASSERT_EQUAL(0, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(4, decoded_len);
+	TEST_ASSERT_EQUAL(0, memcmp(payload, decoded, 4));
+	TEST_ASSERT_EQUAL(7, fx_codec_get_last_rx_address());
+	TEST_ASSERT_EQUAL(1, stats.frames_decoded);
+	TEST_ASSERT_EQUAL(0, stats.checksum_errors);
+
+	//Broadcast, a group we belong to, a group we don't
+	fx_codec_set_rx_groups(1 << 2);
+	uint8_t dst[3] = {FX_ADDR_BROADCAST, FX_ADDR_GROUP(2), FX_ADDR_GROUP(3)};
+	for(int j = 0; j < 3; j++)
+	{
+		fx_encode_addr(dst[j], payload, 4, encoded, &encoded_len,
+				MAX_ENCODED_PAYLOAD_BYTES);
+		for(int i = 0; i < encoded_len; i++)
+		{
+			circ_buf_write_byte(&cb, encoded[i]);
+		}
+	}
+	TEST_ASSERT_EQUAL(0, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(FX_ADDR_BROADCAST, fx_codec_get_last_rx_address());
+	TEST_ASSERT_EQUAL(1, FX_ADDR_IS_MULTICAST(fx_codec_get_last_rx_address()));
+	TEST_ASSERT_EQUAL(0, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(FX_ADDR_GROUP(2), fx_codec_get_last_rx_address());
+	TEST_ASSERT_EQUAL(1, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(2, stats.frames_filtered);
+	TEST_ASSERT_EQUAL(0, cb.length);
+	fx_codec_set_rx_groups(0);
+
+	//Point-to-point: the address is just data
+	fx_codec_set_rx_address(FX_ADDR_NONE);
+	fx_encode_addr(FX_ADDR_NONE, payload, 4, encoded, &encoded_len,
+			MAX_ENCODED_PAYLOAD_BYTES);
+	for(int i = 0; i < encoded_len; i++)
+	{
+		circ_buf_write_byte(&cb, encoded[i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(4, decoded_len);
+	TEST_ASSERT_EQUAL(FX_ADDR_NONE, fx_codec_get_last_rx_address());
+	fx_codec_attach_stats(NULL);
+}
+
+//Multi-drop: a false header for another node, whose footer is the one of
+//our frame. Our frame is still decoded.
+void test_codec_address_filter_false_header(void)
+{
+	fx_codec_stats_t stats = {0};
+	uint8_t payload[4] = {'a', HEADER, 'c', 'd'};
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t encoded_len = 0;
+	uint8_t decoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t decoded_len = 0;
+	circ_buf_t cb = {.buffer = {0}, .length = 0, .write_index = 0, .read_index =
+			0};
+
+	fx_codec_attach_stats(&stats);
+	fx_codec_set_rx_address(7);
+	fx_encode_addr(7, payload, 4, encoded, &encoded_len,
+			MAX_ENCODED_PAYLOAD_BYTES);
+
+	//[HEADER][# BYTES][node 3][our frame]
+	circ_buf_write_byte(&cb, HEADER);
+	circ_buf_write_byte(&cb, encoded_len - 1);
+	circ_buf_write_byte(&cb, 3);
+	for(int i = 0; i < encoded_len; i++)
+	{
+		circ_buf_write_byte(&cb, encoded[i]);
+	}
+
+	TEST_ASSERT_EQUAL(0, fx_decode(&cb, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(4, decoded_len);
+	TEST_ASSERT_EQUAL(0, memcmp(payload, decoded, 4));
+	TEST_ASSERT_EQUAL(0, cb.length);
+	TEST_ASSERT_EQUAL(0, stats.frames_filtered);
+	TEST_ASSERT_EQUAL(3, stats.bytes_discarded);
+
+	fx_codec_set_rx_address(FX_ADDR_NONE);
+	fx_codec_attach_stats(NULL);
+}
+
 void test_flexsea_codec(void)
 {
 	//Encoding:
@@ -597,6 +853,7 @@ void test_flexsea_codec(void)
 	//Continuous data stream:
 	RUN_TEST(test_codec_continuous_receive_decode);
 	RUN_TEST(test_codec_continuous_receive_decode_noisy);
+	RUN_TEST(test_codec_decode_header_noise);
 
 	//Cleaning:
 	RUN_TEST(test_codec_fx_cleanup_all_noise);
@@ -604,6 +861,13 @@ void test_flexsea_codec(void)
 	RUN_TEST(test_codec_fx_cleanup_one_header_in_noise);
 	RUN_TEST(test_codec_fx_cleanup_many_headers_in_noise);
 
+	//Statistics:
+	RUN_TEST(test_codec_stats);
+
+	//Addressing:
+	RUN_TEST(test_codec_address_filter);
+	RUN_TEST(test_codec_address_filter_false_header);
+
 	fflush(stdout);
 }
 
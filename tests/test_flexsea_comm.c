@@ -34,19 +34,8 @@ void uart_callback(uint8_t new_byte)
 void comm_port_init(CommPort *cp)
 {
 	//FlexSEA Comm Port:
-	cp->id = 0;
-	cp->send_reply = 0;
-	cp->reply_cmd = 0;
-	cp->cb = &cb_test;
-	//cp->tx_fct_prt = (void);
+	fx_comm_port_init(cp, 0, &cb_test, NULL);
 	cp->use_dbuf = 1;	//Enable ping pong buffers
-	memset(cp->dbuf[0], 0x00, DBUF_MAX_LEN);
-	memset(cp->dbuf[1], 0x00, DBUF_MAX_LEN);
-	cp->dbuf_lock[0] = 0;
-	cp->dbuf_lock[1] = 0;
-	cp->dbuf_len[0] = 0;
-	cp->dbuf_len[1] = 0;
-	cp->dbuf_selected = 0;
 }
 
 void test_comm_flexsea_ping_pong_buffer(void)
@@ -107,6 +96,7 @@ void test_comm_flexsea_receive_full_packet(void)
 	uint8_t ret_val = 0, ret_val_cmd = 0;
 	ReadWrite rw = CmdRead;
 	AckNack ack = Nack;
+	ReplyDesc desc = {0};
 
 	//Register test function:
 	fx_register_rx_cmd_handler(cmd_6bits_in, &test_command_10a);
@@ -122,9 +112,10 @@ void test_comm_flexsea_receive_full_packet(void)
 	//Receive command?
 	ret_val = fx_receive(&comm_port);
 	TEST_ASSERT_EQUAL(0, ret_val);
-	//If it got decoded, we will notify fx_transmit using these flags
-	TEST_ASSERT_EQUAL(cmd_6bits_in, comm_port.reply_cmd);
-	TEST_ASSERT_EQUAL(1, comm_port.send_reply);
+	//If it got decoded, fx_transmit will find a reply in the queue
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(cmd_6bits_in, desc.cmd);
+	TEST_ASSERT_EQUAL(ReplyData, desc.type);
 }
 
 //Receive 1000 packets using fx_receive()
@@ -144,6 +135,7 @@ void test_comm_flexsea_receive_many_full_packets(void)
 	uint8_t ret_val = 0;
 	ReadWrite rw = CmdRead;
 	AckNack ack = Nack;
+	ReplyDesc desc = {0};
 
 	//Register test function:
 	fx_register_rx_cmd_handler(cmd_6bits_in, &test_command_10a);
@@ -161,9 +153,10 @@ void test_comm_flexsea_receive_many_full_packets(void)
 		//Receive command?
 		ret_val = fx_receive(&comm_port);
 		TEST_ASSERT_EQUAL(0, ret_val);
-		//If it got decoded, we will notify fx_transmit using these flags
-		TEST_ASSERT_EQUAL(cmd_6bits_in, comm_port.reply_cmd);
-		TEST_ASSERT_EQUAL(1, comm_port.send_reply);
+		//If it got decoded, fx_transmit will find a reply in the queue
+		TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+		TEST_ASSERT_EQUAL(cmd_6bits_in, desc.cmd);
+		TEST_ASSERT_EQUAL(ReplyData, desc.type);
 	}
 }
 
@@ -193,6 +186,7 @@ void test_comm_flexsea_receive_many_full_packets_with_noise_in_between(void)
 	uint8_t ret_val = 0, ret_val_cmd = 0;
 	ReadWrite rw = CmdRead;
 	AckNack ack = Nack;
+	ReplyDesc desc = {0};
 
 	//Register test function:
 	fx_register_rx_cmd_handler(cmd_6bits_in, &test_command_10a);
@@ -216,9 +210,10 @@ void test_comm_flexsea_receive_many_full_packets_with_noise_in_between(void)
 			ret_val = fx_receive(&comm_port);
 			if(ret_val == FX_SUCCESS)
 			{
-				//If it got decoded, we will notify fx_transmit using these flags
-				TEST_ASSERT_EQUAL(cmd_6bits_in, comm_port.reply_cmd);
-				TEST_ASSERT_EQUAL(1, comm_port.send_reply);
+				//If it got decoded, fx_transmit will find a reply in the queue
+				TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+				TEST_ASSERT_EQUAL(cmd_6bits_in, desc.cmd);
+				TEST_ASSERT_EQUAL(ReplyData, desc.type);
 				good_packets++;
 				break;
 			}
@@ -243,9 +238,10 @@ void test_comm_flexsea_receive_many_full_packets_with_noise_in_between(void)
 			ret_val = fx_receive(&comm_port);
 			if(ret_val == FX_SUCCESS)
 			{
-				//If it got decoded, we will notify fx_transmit using these flags
-				TEST_ASSERT_EQUAL(cmd_6bits_in, comm_port.reply_cmd);
-				TEST_ASSERT_EQUAL(1, comm_port.send_reply);
+				//If it got decoded, fx_transmit will find a reply in the queue
+				TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+				TEST_ASSERT_EQUAL(cmd_6bits_in, desc.cmd);
+				TEST_ASSERT_EQUAL(ReplyData, desc.type);
 				TEST_FAIL();	//Just noise, not supposed to detect a packet
 				break;
 			}
@@ -273,6 +269,7 @@ void test_comm_flexsea_receive_slowly(void)
 	uint8_t ret_val = 0;
 	ReadWrite rw = CmdRead;
 	AckNack ack = Nack;
+	ReplyDesc desc = {0};
 
 	//Register test function:
 	fx_register_rx_cmd_handler(cmd_6bits_in, &test_command_10a);
@@ -297,9 +294,10 @@ void test_comm_flexsea_receive_slowly(void)
 			ret_val = fx_receive(&comm_port);
 			if(ret_val == FX_SUCCESS)
 			{
-				//If it got decoded, we will notify fx_transmit using these flags
-				TEST_ASSERT_EQUAL(cmd_6bits_in, comm_port.reply_cmd);
-				TEST_ASSERT_EQUAL(1, comm_port.send_reply);
+				//If it got decoded, fx_transmit will find a reply in the queue
+				TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+				TEST_ASSERT_EQUAL(cmd_6bits_in, desc.cmd);
+				TEST_ASSERT_EQUAL(ReplyData, desc.type);
 				good_packets++;
 				received++;
 			}
@@ -333,6 +331,7 @@ void test_comm_flexsea_receive_full_packet_byte_by_byte_ping_pong(void)
 	uint8_t ret_val = 0, ret_val_cmd = 0;
 	ReadWrite rw = CmdRead;
 	AckNack ack = Nack;
+	ReplyDesc desc = {0};
 
 	//Register test function:
 	fx_register_rx_cmd_handler(cmd_6bits_in, &test_command_10a);
@@ -361,9 +360,10 @@ void test_comm_flexsea_receive_full_packet_byte_by_byte_ping_pong(void)
 	//Receive command?
 	ret_val = fx_receive(&comm_port);
 	TEST_ASSERT_EQUAL(0, ret_val);
-	//If it got decoded, we will notify fx_transmit using these flags
-	TEST_ASSERT_EQUAL(cmd_6bits_in, comm_port.reply_cmd);
-	TEST_ASSERT_EQUAL(1, comm_port.send_reply);
+	//If it got decoded, fx_transmit will find a reply in the queue
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(cmd_6bits_in, desc.cmd);
+	TEST_ASSERT_EQUAL(ReplyData, desc.type);
 }
 
 //Receive one packet using fx_receive(), one byte at the time
@@ -384,6 +384,7 @@ void test_comm_flexsea_receive_full_packet_byte_by_byte_no_ping_pong(void)
 	uint8_t ret_val = 0, ret_val_cmd = 0;
 	ReadWrite rw = CmdRead;
 	AckNack ack = Nack;
+	ReplyDesc desc = {0};
 
 	//Register test function:
 	fx_register_rx_cmd_handler(cmd_6bits_in, &test_command_10a);
@@ -409,9 +410,718 @@ void test_comm_flexsea_receive_full_packet_byte_by_byte_no_ping_pong(void)
 	//Receive command?
 	ret_val = fx_receive(&comm_port);
 	TEST_ASSERT_EQUAL(0, ret_val);
-	//If it got decoded, we will notify fx_transmit using these flags
-	TEST_ASSERT_EQUAL(cmd_6bits_in, comm_port.reply_cmd);
-	TEST_ASSERT_EQUAL(1, comm_port.send_reply);
+	//If it got decoded, fx_transmit will find a reply in the queue
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(cmd_6bits_in, desc.cmd);
+	TEST_ASSERT_EQUAL(ReplyData, desc.type);
+}
+
+//Do streams get scheduled at the right time?
+void test_comm_stream_schedule(void)
+{
+	comm_port_init(&comm_port);
+	uint8_t cmd = 0;
+
+	//Nothing subscribed, nothing due
+	TEST_ASSERT_EQUAL(1, fx_stream_get_due(&comm_port, 1000, &cmd));
+
+	//Invalid subscriptions
+	TEST_ASSERT_EQUAL(1, fx_stream_subscribe(&comm_port, MAX_CMD_CODE + 1, 10));
+	TEST_ASSERT_EQUAL(1, fx_stream_subscribe(&comm_port, 12, 0));
+
+	//Stream command 12 every 10 ms. First sample goes out right away.
+	TEST_ASSERT_EQUAL(0, fx_stream_subscribe(&comm_port, 12, 10));
+	TEST_ASSERT_EQUAL(0, fx_stream_get_due(&comm_port, 1000, &cmd));
+	TEST_ASSERT_EQUAL(12, cmd);
+	TEST_ASSERT_EQUAL(1, fx_stream_get_due(&comm_port, 1000, &cmd));
+	TEST_ASSERT_EQUAL(1, fx_stream_get_due(&comm_port, 1009, &cmd));
+	cmd = 0;
+	TEST_ASSERT_EQUAL(0, fx_stream_get_due(&comm_port, 1010, &cmd));
+	TEST_ASSERT_EQUAL(12, cmd);
+	TEST_ASSERT_EQUAL(1, fx_stream_get_due(&comm_port, 1010, &cmd));
+
+	//We fell behind: one sample, no burst
+	TEST_ASSERT_EQUAL(0, fx_stream_get_due(&comm_port, 1055, &cmd));
+	TEST_ASSERT_EQUAL(1, fx_stream_get_due(&comm_port, 1055, &cmd));
+	TEST_ASSERT_EQUAL(0, fx_stream_get_due(&comm_port, 1065, &cmd));
+
+	//Timer wrap
+	TEST_ASSERT_EQUAL(0, fx_stream_subscribe(&comm_port, 12, 10));
+	TEST_ASSERT_EQUAL(0, fx_stream_get_due(&comm_port, 0xFFFFFFFA, &cmd));
+	TEST_ASSERT_EQUAL(1, fx_stream_get_due(&comm_port, 0x00000003, &cmd));
+	TEST_ASSERT_EQUAL(0, fx_stream_get_due(&comm_port, 0x00000004, &cmd));
+
+	//Stop
+	TEST_ASSERT_EQUAL(0, fx_stream_unsubscribe(&comm_port, 12));
+	TEST_ASSERT_EQUAL(1, fx_stream_unsubscribe(&comm_port, 12));
+	TEST_ASSERT_EQUAL(1, fx_stream_get_due(&comm_port, 2000, &cmd));
+
+	//We can't subscribe to more than FX_STREAMS_MAX commands
+	for(int i = 0; i < FX_STREAMS_MAX; i++)
+	{
+		TEST_ASSERT_EQUAL(0, fx_stream_subscribe(&comm_port, 20 + i, 5));
+	}
+	TEST_ASSERT_EQUAL(1, fx_stream_subscribe(&comm_port, 30, 5));
+	//...but we can update an existing one
+	TEST_ASSERT_EQUAL(0, fx_stream_subscribe(&comm_port, 20, 50));
+}
+
+//Can the host subscribe and unsubscribe using FX_CMD_STREAM?
+void test_comm_stream_subscribe_command(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[3] = {0};
+	uint16_t index = 0;
+	uint8_t ret_val = 0, cmd = 0;
+
+	//Subscribe to command 10 at 100 Hz
+	payload[index++] = 10;
+	SPLIT_16(10, payload, &index);
+	ret_val = fx_create_bytestream_from_cmd(FX_CMD_STREAM, CmdWrite, Nack,
+			payload, index, bytestream, &bytestream_len);
+	TEST_ASSERT_EQUAL(0, ret_val);
+	Comm_RxHandler(bytestream, bytestream_len);
+	ret_val = fx_receive(&comm_port);
+	TEST_ASSERT_EQUAL(0, ret_val);
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_length(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_stream_get_due(&comm_port, 0, &cmd));
+	TEST_ASSERT_EQUAL(10, cmd);
+
+	//Unsubscribe (period = 0)
+	index = 0;
+	payload[index++] = 10;
+	SPLIT_16(0, payload, &index);
+	ret_val = fx_create_bytestream_from_cmd(FX_CMD_STREAM, CmdWrite, Nack,
+			payload, index, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	ret_val = fx_receive(&comm_port);
+	TEST_ASSERT_EQUAL(0, ret_val);
+	TEST_ASSERT_EQUAL(1, fx_stream_get_due(&comm_port, 100, &cmd));
+}
+
+//Uses the same handler for reads and writes
+uint8_t test_command_10_any(uint8_t cmd_6bits, ReadWrite rw, AckNack ack, uint8_t *buf, uint8_t len)
+{
+	return FX_SUCCESS;
+}
+
+//Pipelined requests: every reply and ack is kept, in order
+void test_comm_reply_queue(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[4] = {1, 2, 3, 4};
+	ReplyDesc desc = {0};
+
+	fx_register_rx_cmd_handler(10, &test_command_10_any);
+
+	//Read, Write with Ack, ReadWrite: all received before we transmit
+	fx_create_bytestream_from_cmd(10, CmdRead, Nack, payload, 4, bytestream,
+			&bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	fx_create_bytestream_from_cmd(10, CmdWrite, Ack, payload, 4, bytestream,
+			&bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	uint16_t ack_pnum = get_last_rx_packet_num();
+	fx_create_bytestream_from_cmd(10, CmdReadWrite, Nack, payload, 4, bytestream,
+			&bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	//Write without Ack: nothing to send
+	fx_create_bytestream_from_cmd(10, CmdWrite, Nack, payload, 4, bytestream,
+			&bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+
+	TEST_ASSERT_EQUAL(3, fx_reply_queue_length(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_peek(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(ReplyData, desc.type);
+	TEST_ASSERT_EQUAL(3, fx_reply_queue_length(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(ReplyData, desc.type);
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(ReplyAck, desc.type);
+	TEST_ASSERT_EQUAL(10, desc.cmd);
+	TEST_ASSERT_EQUAL(ack_pnum, desc.packet_num);
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(ReplyData, desc.type);
+	TEST_ASSERT_EQUAL(1, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(1, fx_reply_queue_peek(&comm_port, &desc));
+
+	//Overflow: the oldest replies are kept, drops are counted
+	desc.type = ReplyData;
+	for(int i = 0; i < FX_REPLYQ_DEPTH + 2; i++)
+	{
+		desc.cmd = i;
+		fx_reply_queue_push(&comm_port, &desc);
+	}
+	TEST_ASSERT_EQUAL(FX_REPLYQ_DEPTH, fx_reply_queue_length(&comm_port));
+	TEST_ASSERT_EQUAL(2, comm_port.stats.replies_dropped);
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, NULL));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(1, desc.cmd);
+}
+
+//Captures what the TX queue sends
+uint8_t tx_log[8][MAX_ENCODED_PAYLOAD_BYTES];
+uint16_t tx_log_len[8];
+uint8_t tx_log_cnt = 0;
+uint8_t tx_capture(uint8_t *bytes, uint16_t len)
+{
+	if(tx_log_cnt < 8)
+	{
+		memcpy(tx_log[tx_log_cnt], bytes, len);
+		tx_log_len[tx_log_cnt] = len;
+		tx_log_cnt++;
+	}
+	return 0;
+}
+
+//Like tx_capture(), but the next 'tx_refuse' calls fail (ex.: HAL_BUSY)
+static uint8_t tx_refuse = 0;
+uint8_t tx_capture_or_refuse(uint8_t *bytes, uint16_t len)
+{
+	if(tx_refuse)
+	{
+		tx_refuse--;
+		return 1;
+	}
+	return tx_capture(bytes, len);
+}
+
+//Command code of a captured frame (header, #bytes, then the command)
+#define TX_LOG_CMD(i)	CMD_GET_6BITS(tx_log[i][2])
+
+//Do control frames go out before replies and bulk data?
+void test_comm_tx_queue_priority(void)
+{
+	uint8_t payload[10] = {0};
+	fx_comm_port_init(&comm_port, 0, &cb_test, &tx_capture);
+	tx_log_cnt = 0;
+
+	//Nothing to send
+	TEST_ASSERT_EQUAL(1, fx_comm_process_tx_queue(&comm_port));
+
+	//Bulk dump fills its class, then a reply and a control frame arrive
+	TEST_ASSERT_EQUAL(FX_TXQ_DEPTH, fx_tx_queue_free(&comm_port, TxBulk));
+	for(int i = 0; i < FX_TXQ_DEPTH; i++)
+	{
+		TEST_ASSERT_EQUAL(0, fx_tx_queue_cmd(&comm_port, TxBulk, 20 + i,
+				CmdWrite, Nack, payload, 10));
+	}
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_free(&comm_port, TxBulk));
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_cmd(&comm_port, TxBulk, 30, CmdWrite,
+			Nack, payload, 10));
+	TEST_ASSERT_EQUAL(1, comm_port.stats.frames_dropped[TxBulk]);
+
+	//First bulk frame goes out, then a reply and a control frame get queued
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_cmd(&comm_port, TxReply, 11, CmdWrite,
+			Nack, payload, 10));
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_cmd(&comm_port, TxControl, 12, CmdWrite,
+			Nack, payload, 3));
+	TEST_ASSERT_EQUAL(3, fx_tx_queue_pending(&comm_port));
+	while(!fx_comm_process_tx_queue(&comm_port));
+
+	TEST_ASSERT_EQUAL(4, tx_log_cnt);
+	TEST_ASSERT_EQUAL(20, TX_LOG_CMD(0));
+	TEST_ASSERT_EQUAL(12, TX_LOG_CMD(1));
+	TEST_ASSERT_EQUAL(11, TX_LOG_CMD(2));
+	TEST_ASSERT_EQUAL(21, TX_LOG_CMD(3));
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_pending(&comm_port));
+
+	//Pre-encoded frames are copied
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	fx_create_bytestream_from_cmd(13, CmdRead, Nack, payload, 1, bytestream,
+			&bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_frame(&comm_port, TxReply, bytestream,
+			bytestream_len));
+	memset(bytestream, 0, MAX_ENCODED_PAYLOAD_BYTES);
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(bytestream_len, tx_log_len[4]);
+	TEST_ASSERT_EQUAL(13, TX_LOG_CMD(4));
+}
+
+//With an asynchronous port the frame stays queued until the TX is done
+void test_comm_tx_queue_async(void)
+{
+	uint8_t payload[10] = {0};
+	fx_comm_port_init(&comm_port, 0, &cb_test, &tx_capture);
+	comm_port.txq.async = 1;
+	tx_log_cnt = 0;
+
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_cmd(&comm_port, TxBulk, 20, CmdWrite,
+			Nack, payload, 10));
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+
+	//Port is busy: a new control frame has to wait
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_cmd(&comm_port, TxControl, 12, CmdWrite,
+			Nack, payload, 3));
+	TEST_ASSERT_EQUAL(1, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(2, fx_tx_queue_pending(&comm_port));
+	TEST_ASSERT_EQUAL(1, tx_log_cnt);
+
+	//TX complete interrupt
+	fx_comm_tx_done(&comm_port);
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_pending(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+	fx_comm_tx_done(&comm_port);
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_pending(&comm_port));
+	TEST_ASSERT_EQUAL(12, TX_LOG_CMD(1));
+}
+
+//An asynchronous transmission that doesn't start doesn't block the port: the
+//frame is retried
+void test_comm_tx_queue_async_refused(void)
+{
+	uint8_t payload[3] = {0};
+	fx_comm_port_init(&comm_port, 0, &cb_test, &tx_capture_or_refuse);
+	comm_port.txq.async = 1;
+	tx_log_cnt = 0;
+	tx_refuse = 2;
+
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_cmd(&comm_port, TxControl, 12, CmdWrite,
+			Nack, payload, 3));
+	TEST_ASSERT_EQUAL(1, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(0, comm_port.txq.busy);
+	TEST_ASSERT_EQUAL(1, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_pending(&comm_port));
+	TEST_ASSERT_EQUAL(0, comm_port.stats.frames_sent);
+	TEST_ASSERT_EQUAL(0, tx_log_cnt);
+
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(1, comm_port.txq.busy);
+	fx_comm_tx_done(&comm_port);
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_pending(&comm_port));
+	TEST_ASSERT_EQUAL(1, tx_log_cnt);
+	TEST_ASSERT_EQUAL(12, TX_LOG_CMD(0));
+}
+
+//Reply builder for command 10
+uint8_t test_reply_builder_10(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len)
+{
+	memcpy(buf, "reply", 5);
+	*len = 5;
+	return 0;
+}
+
+//Requests in, frames out: replies from the builders, acks from the stack
+void test_comm_process_replies(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+	comm_port.tx_fct_prt = &tx_capture;
+	tx_log_cnt = 0;
+
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[4] = {1, 2, 3, 4};
+	uint8_t cmd = 0, len = 0;
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+
+	fx_register_rx_cmd_handler(10, &test_command_10_any);
+	fx_register_tx_reply_builder(10, &test_reply_builder_10);
+	fx_register_rx_cmd_handler(11, &test_command_10_any);	//No builder
+
+	//Read 10, Read 11 (no reply), Write 10 with Ack
+	fx_create_bytestream_from_cmd(10, CmdRead, Nack, payload, 4, bytestream,
+			&bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	fx_receive(&comm_port);
+	fx_create_bytestream_from_cmd(11, CmdRead, Nack, payload, 4, bytestream,
+			&bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	fx_receive(&comm_port);
+	fx_create_bytestream_from_cmd(10, CmdWrite, Ack, payload, 4, bytestream,
+			&bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	fx_receive(&comm_port);
+	uint16_t ack_pnum = get_last_rx_packet_num();
+
+	TEST_ASSERT_EQUAL(2, fx_comm_process_replies(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_length(&comm_port));
+	while(!fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(2, tx_log_cnt);
+
+	//Ack goes first
+	circ_buf_init(&cb_test);
+	for(int i = 0; i < tx_log_len[0]; i++)
+	{
+		circ_buf_write_byte(&cb_test, tx_log[0][i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_get_cmd_handler_from_bytestream(&cb_test, &cmd,
+			&rw, &ack, buf, &len));
+	TEST_ASSERT_EQUAL(FX_CMD_ACK, cmd);
+	TEST_ASSERT_EQUAL(10, buf[CMD_OVERHEAD]);
+	TEST_ASSERT_EQUAL(CMD_ACK_PNUM_LSB(ack_pnum), buf[CMD_OVERHEAD + 1]);
+
+	//Then the reply
+	circ_buf_init(&cb_test);
+	for(int i = 0; i < tx_log_len[1]; i++)
+	{
+		circ_buf_write_byte(&cb_test, tx_log[1][i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_get_cmd_handler_from_bytestream(&cb_test, &cmd,
+			&rw, &ack, buf, &len));
+	TEST_ASSERT_EQUAL(10, cmd);
+	TEST_ASSERT_EQUAL(CMD_OVERHEAD + 5, len);
+	TEST_ASSERT_EQUAL(0, memcmp("reply", &buf[CMD_OVERHEAD], 5));
+
+	//Streams use the same builders
+	fx_stream_subscribe(&comm_port, 10, 10);
+	TEST_ASSERT_EQUAL(1, fx_comm_process_streams(&comm_port, 0));
+	TEST_ASSERT_EQUAL(0, fx_comm_process_streams(&comm_port, 5));
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_pending(&comm_port));
+}
+
+//Can the host read and reset the port counters?
+void test_comm_stats_diag(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+	comm_port.tx_fct_prt = &tx_capture;
+	tx_log_cnt = 0;
+
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t selector = FX_DIAG_STATS;
+	uint8_t noise[3] = {0x12, 0x34, 0x56};
+	uint8_t cmd = 0, len = 0;
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint16_t index = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+
+	//Noise, then a stats request
+	Comm_RxHandler(noise, 3);
+	fx_create_bytestream_from_cmd(FX_CMD_DIAG, CmdRead, Nack, &selector, 1,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(3 + bytestream_len, comm_port.stats.bytes_received);
+	TEST_ASSERT_EQUAL(1, comm_port.stats.codec.frames_decoded);
+	TEST_ASSERT_EQUAL(3, comm_port.stats.codec.bytes_discarded);
+
+	TEST_ASSERT_EQUAL(1, fx_comm_process_replies(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(1, comm_port.stats.frames_sent);
+
+	//Decode the reply
+	circ_buf_init(&cb_test);
+	for(int i = 0; i < tx_log_len[0]; i++)
+	{
+		circ_buf_write_byte(&cb_test, tx_log[0][i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_get_cmd_handler_from_bytestream(&cb_test, &cmd,
+			&rw, &ack, buf, &len));
+	TEST_ASSERT_EQUAL(FX_CMD_DIAG, cmd);
+	TEST_ASSERT_EQUAL(CMD_OVERHEAD + 1 + 4 * (10 + TX_CLASSES), len);
+	index = CMD_OVERHEAD;
+	TEST_ASSERT_EQUAL(FX_DIAG_STATS, buf[index++]);
+	TEST_ASSERT_EQUAL(3 + bytestream_len, REBUILD_UINT32(buf, &index));
+	TEST_ASSERT_EQUAL(0, REBUILD_UINT32(buf, &index));
+	TEST_ASSERT_EQUAL(1, REBUILD_UINT32(buf, &index));
+
+	//Reset
+	circ_buf_init(&cb_test);
+	fx_create_bytestream_from_cmd(FX_CMD_DIAG, CmdWrite, Nack, &selector, 1,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(0, comm_port.stats.bytes_received);
+	TEST_ASSERT_EQUAL(0, comm_port.stats.codec.frames_decoded);
+
+	//Unknown selector
+	selector = 0x7F;
+	fx_create_bytestream_from_cmd(FX_CMD_DIAG, CmdRead, Nack, &selector, 1,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(1, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_length(&comm_port));
+}
+
+//Time sync: T1 is echoed, T2 <= T3, and the reply jumps ahead of normal replies
+void test_comm_time_sync(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+	comm_port.tx_fct_prt = &tx_capture;
+	tx_log_cnt = 0;
+
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t t1[FX_TSYNC_HOST_BYTES] = {1, 2, 3, 4, 5, 6, 7, 8};
+	uint8_t selector = FX_DIAG_STATS;
+	uint8_t cmd = 0, len = 0;
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint16_t index = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+
+	//A stats read, then a time sync request
+	fx_create_bytestream_from_cmd(FX_CMD_DIAG, CmdRead, Nack, &selector, 1,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	fx_create_bytestream_from_cmd(FX_CMD_TIME_SYNC, CmdRead, Nack, t1,
+			FX_TSYNC_HOST_BYTES, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(2, fx_comm_process_replies(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+
+	//First frame out is the sync reply
+	for(int i = 0; i < tx_log_len[0]; i++)
+	{
+		circ_buf_write_byte(&cb_test, tx_log[0][i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_get_cmd_handler_from_bytestream(&cb_test, &cmd,
+			&rw, &ack, buf, &len));
+	TEST_ASSERT_EQUAL(FX_CMD_TIME_SYNC, cmd);
+	TEST_ASSERT_EQUAL(CMD_OVERHEAD + FX_TSYNC_HOST_BYTES + 12, len);
+	TEST_ASSERT_EQUAL(0, memcmp(t1, &buf[CMD_OVERHEAD], FX_TSYNC_HOST_BYTES));
+	index = CMD_OVERHEAD + FX_TSYNC_HOST_BYTES;
+	uint32_t t2 = REBUILD_UINT32(buf, &index);
+	uint32_t t3 = REBUILD_UINT32(buf, &index);
+	TEST_ASSERT_EQUAL(1, (int32_t)(t3 - t2) >= 0);
+	TEST_ASSERT_EQUAL(fx_timestamp_hz(), REBUILD_UINT32(buf, &index));
+
+	//Too short, or not a read
+	fx_create_bytestream_from_cmd(FX_CMD_TIME_SYNC, CmdRead, Nack, t1, 4,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(1, fx_receive(&comm_port));
+	fx_create_bytestream_from_cmd(FX_CMD_TIME_SYNC, CmdWrite, Nack, t1,
+			FX_TSYNC_HOST_BYTES, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(1, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_length(&comm_port));
+}
+
+//Helper: FX_CMD_SCHEDULE request for an embedded command, received by comm_port
+static uint8_t schedule_cmd(uint32_t at, uint8_t *embedded, uint8_t embedded_len)
+{
+	uint8_t payload[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint16_t index = 0;
+
+	SPLIT_32(at, payload, &index);
+	memcpy(&payload[index], embedded, embedded_len);
+	fx_create_bytestream_from_cmd(FX_CMD_SCHEDULE, CmdWrite, Nack, payload,
+			index + embedded_len, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	return fx_receive(&comm_port);
+}
+
+//Scheduled commands wait for their time, then go out earliest first
+void test_comm_schedule(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+
+	uint8_t data[2] = {0x12, 0x34};
+	uint8_t early[FX_SCHED_MAX_BYTES] = {0}, late[FX_SCHED_MAX_BYTES] = {0};
+	uint8_t early_len = 0, late_len = 0;
+	uint8_t too_long[FX_SCHED_MAX_BYTES + 1] = {0};
+	uint8_t nested[CMD_OVERHEAD] = {0};
+	uint8_t nested_len = 0;
+	ReplyDesc desc = {0};
+	uint32_t now = FX_TIMESTAMP();
+
+	fx_register_rx_cmd_handler(10, &test_command_10_any);
+	fx_create_tx_cmd(10, CmdWrite, Ack, data, 2, late, &late_len);
+	uint16_t late_pnum = CMD_GET_PACKET_NUM(late[1], late[2]);
+	fx_create_tx_cmd(10, CmdWrite, Ack, data, 2, early, &early_len);
+	uint16_t early_pnum = CMD_GET_PACKET_NUM(early[1], early[2]);
+
+	//Far in the future: nothing to do yet
+	TEST_ASSERT_EQUAL(0, schedule_cmd(now + 10 * fx_timestamp_hz(), late,
+			late_len));
+	TEST_ASSERT_EQUAL(1, fx_schedule_pending(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_comm_process_schedule(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_length(&comm_port));
+
+	//Two commands that are due, received out of order
+	TEST_ASSERT_EQUAL(0, schedule_cmd(now - 10, late, late_len));
+	TEST_ASSERT_EQUAL(0, schedule_cmd(now - 20, early, early_len));
+	TEST_ASSERT_EQUAL(2, fx_comm_process_schedule(&comm_port));
+	TEST_ASSERT_EQUAL(1, fx_schedule_pending(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(ReplyAck, desc.type);
+	TEST_ASSERT_EQUAL(early_pnum, desc.packet_num);
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_pop(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(late_pnum, desc.packet_num);
+
+	//Invalid: too long, nested
+	memcpy(too_long, early, early_len);
+	TEST_ASSERT_EQUAL(1, schedule_cmd(now, too_long, sizeof(too_long)));
+	fx_create_tx_cmd(FX_CMD_SCHEDULE, CmdWrite, Nack, data, 0, nested,
+			&nested_len);
+	TEST_ASSERT_EQUAL(1, schedule_cmd(now, nested, nested_len));
+	TEST_ASSERT_EQUAL(1, fx_schedule_pending(&comm_port));
+
+	//Cancel
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	fx_create_bytestream_from_cmd(FX_CMD_SCHEDULE, CmdWrite, Nack, data, 0,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_schedule_pending(&comm_port));
+}
+
+//Multi-drop: we only answer frames sent to our address, and replies go to the host
+void test_comm_address(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+	comm_port.addr = 5;
+
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[2] = {1, 2};
+	ReplyDesc desc = {0};
+
+	fx_register_rx_cmd_handler(10, &test_command_10_any);
+
+	//Another node
+	fx_create_bytestream_from_cmd_addr(6, 10, CmdRead, Nack, payload, 2,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(1, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(0, comm_port.cb->length);
+	TEST_ASSERT_EQUAL(1, comm_port.stats.codec.frames_filtered);
+
+	//Us
+	fx_create_bytestream_from_cmd_addr(5, 10, CmdRead, Nack, payload, 2,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_peek(&comm_port, &desc));
+	TEST_ASSERT_EQUAL(10, desc.cmd);
+
+	//Our frames are addressed to the host
+	fx_tx_queue_cmd(&comm_port, TxReply, 10, CmdWrite, Nack, payload, 2);
+	TEST_ASSERT_EQUAL(FX_ADDR_HOST, comm_port.txq.frame[TxReply][0].data[2]);
+}
+
+//Broadcast and group commands are executed, but never answered
+void test_comm_multicast(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+	comm_port.addr = 5;
+	comm_port.groups = (1 << 1);
+
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[2] = {1, 2};
+
+	fx_register_rx_cmd_handler(10, &test_command_10_any);
+
+	//Read and Write with Ack, broadcast: no reply
+	fx_create_bytestream_from_cmd_addr(FX_ADDR_BROADCAST, 10, CmdRead, Nack,
+			payload, 2, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	fx_create_bytestream_from_cmd_addr(FX_ADDR_GROUP(1), 10, CmdWrite, Ack,
+			payload, 2, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_length(&comm_port));
+
+	//Not our group
+	fx_create_bytestream_from_cmd_addr(FX_ADDR_GROUP(0), 10, CmdRead, Nack,
+			payload, 2, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(1, fx_receive(&comm_port));
+
+	//Polled afterwards: we answer
+	fx_create_bytestream_from_cmd_addr(5, 10, CmdRead, Nack, payload, 2,
+			bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(1, fx_reply_queue_length(&comm_port));
+
+	//Our filter doesn't outlive fx_receive(): another node, decoding on its
+	//own, isn't in our group
+	uint8_t encoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t decoded[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t encoded_len = 0, decoded_len = 0;
+	fx_create_bytestream_from_cmd_addr(FX_ADDR_GROUP(1), 10, CmdRead, Nack,
+			payload, 2, bytestream, &bytestream_len);
+	circ_buf_write(&cb_test, bytestream, bytestream_len);
+	fx_codec_set_rx_address(9);
+	TEST_ASSERT_EQUAL(1, fx_decode(&cb_test, encoded, &encoded_len, decoded,
+			&decoded_len));
+	TEST_ASSERT_EQUAL(0, cb_test.length);
+	fx_codec_set_rx_address(FX_ADDR_NONE);
+}
+
+//TDMA: after a beacon we only transmit in our slot, once per cycle
+void test_comm_tdma(void)
+{
+	circ_buf_init(&cb_test);
+	comm_port_init(&comm_port);
+	comm_port.addr = 5;
+	comm_port.tx_fct_prt = &tx_capture;
+	tx_log_cnt = 0;
+
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t beacon[3] = {0xE8, 0x03, 4};	//1000 us, 4 slots
+	uint32_t slot_ticks = 0;
+
+	fx_register_tx_reply_builder(10, &test_reply_builder_10);
+	fx_tdma_config(&comm_port, 2, 10);
+
+	//Beacon: our sample gets queued, but slot 2 hasn't started
+	fx_create_bytestream_from_cmd_addr(FX_ADDR_BROADCAST, FX_CMD_TDMA,
+			CmdWrite, Nack, beacon, 3, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(1, comm_port.tdma.active);
+	TEST_ASSERT_EQUAL(1, comm_port.tdma.beacons);
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_pending(&comm_port));
+	slot_ticks = comm_port.tdma.slot_ticks;
+	TEST_ASSERT_EQUAL((uint32_t)(((uint64_t)1000 * fx_timestamp_hz()) / 1000000),
+			slot_ticks);
+	TEST_ASSERT_EQUAL(1, fx_comm_process_tx_queue(&comm_port));
+
+	//Middle of our slot: one frame, no more
+	comm_port.tdma.start = FX_TIMESTAMP() - (2 * slot_ticks) - (slot_ticks / 2);
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(1, tx_log_cnt);
+	TEST_ASSERT_EQUAL(10, CMD_GET_6BITS(tx_log[0][3]));	//After the address
+	fx_tx_queue_reply(&comm_port, TxReply, 10);
+	TEST_ASSERT_EQUAL(1, fx_comm_process_tx_queue(&comm_port));
+
+	//Cycle is over: silence until the next beacon
+	comm_port.tdma.sent = 0;
+	comm_port.tdma.start = FX_TIMESTAMP() - (4 * slot_ticks);
+	TEST_ASSERT_EQUAL(1, fx_comm_process_tx_queue(&comm_port));
+
+	//An empty beacon ends TDMA mode
+	fx_create_bytestream_from_cmd_addr(FX_ADDR_BROADCAST, FX_CMD_TDMA,
+			CmdWrite, Nack, beacon, 0, bytestream, &bytestream_len);
+	Comm_RxHandler(bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_receive(&comm_port));
+	TEST_ASSERT_EQUAL(0, comm_port.tdma.active);
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&comm_port));
+	TEST_ASSERT_EQUAL(2, tx_log_cnt);
 }
 
 void test_flexsea_comm(void)
@@ -423,6 +1133,19 @@ void test_flexsea_comm(void)
 	RUN_TEST(test_comm_flexsea_receive_slowly);
 	RUN_TEST(test_comm_flexsea_receive_full_packet_byte_by_byte_ping_pong);
 	RUN_TEST(test_comm_flexsea_receive_full_packet_byte_by_byte_no_ping_pong);
+	RUN_TEST(test_comm_stream_schedule);
+	RUN_TEST(test_comm_stream_subscribe_command);
+	RUN_TEST(test_comm_reply_queue);
+	RUN_TEST(test_comm_tx_queue_priority);
+	RUN_TEST(test_comm_tx_queue_async);
+	RUN_TEST(test_comm_tx_queue_async_refused);
+	RUN_TEST(test_comm_process_replies);
+	RUN_TEST(test_comm_stats_diag);
+	RUN_TEST(test_comm_time_sync);
+	RUN_TEST(test_comm_schedule);
+	RUN_TEST(test_comm_address);
+	RUN_TEST(test_comm_multicast);
+	RUN_TEST(test_comm_tdma);
 
 	fflush(stdout);
 }
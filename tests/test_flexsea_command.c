@@ -240,6 +240,49 @@ void test_command_parse_rx_registered_command(void)
 	}
 }
 
+//Reply builder used by the tests
+uint8_t test_reply_builder_23(uint8_t cmd_6bits, uint8_t *buf, uint8_t *len)
+{
+	buf[0] = cmd_6bits;
+	buf[1] = 0xAB;
+	*len = 2;
+	return 0;
+}
+
+//Are replies built by the registered builder, after a valid header?
+void test_command_build_tx_reply(void)
+{
+	fx_rx_cmd_init();
+
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t len = 0, cmd_6bits = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+
+	//Nothing registered
+	TEST_ASSERT_EQUAL(1, fx_build_tx_reply(23, CmdWrite, Nack, buf, &len));
+	TEST_ASSERT_EQUAL(0, len);
+
+	//Invalid codes
+	TEST_ASSERT_EQUAL(1, fx_register_tx_reply_builder(MAX_CMD_CODE,
+			&test_reply_builder_23));
+	TEST_ASSERT_EQUAL(1, fx_build_tx_reply(MAX_CMD_CODE, CmdWrite, Nack, buf,
+			&len));
+
+	TEST_ASSERT_EQUAL(0, fx_register_tx_reply_builder(23, &test_reply_builder_23));
+	TEST_ASSERT_EQUAL(0, fx_build_tx_reply(23, CmdWrite, Nack, buf, &len));
+	TEST_ASSERT_EQUAL(CMD_OVERHEAD + 2, len);
+	TEST_ASSERT_EQUAL(23, buf[CMD_OVERHEAD]);
+	TEST_ASSERT_EQUAL(0xAB, buf[CMD_OVERHEAD + 1]);
+	TEST_ASSERT_EQUAL(0, fx_parse_rx_cmd(buf, len, &cmd_6bits, &rw, &ack));
+	TEST_ASSERT_EQUAL(23, cmd_6bits);
+	TEST_ASSERT_EQUAL(CmdWrite, rw);
+	TEST_ASSERT_EQUAL(get_last_tx_packet_num(), get_last_rx_packet_num());
+
+	//Invalid R/W
+	TEST_ASSERT_EQUAL(1, fx_build_tx_reply(23, CmdInvalid, Nack, buf, &len));
+}
+
 //Make sure that our Ack/Nack/Packet Number macros work as intended
 void test_command_ack_nack_packet_macros(void)
 {
@@ -397,6 +440,7 @@ void test_flexsea_command(void)
 	RUN_TEST(test_command_create_tx_basic_bad_cmd_rw);
 	RUN_TEST(test_command_parse_rx_catchall);
 	RUN_TEST(test_command_parse_rx_registered_command);
+	RUN_TEST(test_command_build_tx_reply);
 	RUN_TEST(test_command_ack_nack_packet_macros);
 	RUN_TEST(test_command_encode_decode_ack_nack);
 	RUN_TEST(test_command_track_tx_packet_number);
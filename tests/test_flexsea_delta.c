@@ -0,0 +1,232 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tests.h"
+#include "flexsea.h"
+
+//Test structure, similar to what we stream
+typedef struct
+{
+	int8_t var0_int8;
+	uint32_t var1_uint32;
+	uint8_t var2_uint8;
+	int16_t var3_int16;
+	float var4_float;
+} __attribute__((__packed__)) FlexSEA_Delta_Test_s;
+
+static const uint8_t delta_test_fields[] = {
+		FX_DELTA_FIELD(FlexSEA_Delta_Test_s, var0_int8),
+		FX_DELTA_FIELD(FlexSEA_Delta_Test_s, var1_uint32),
+		FX_DELTA_FIELD(FlexSEA_Delta_Test_s, var2_uint8),
+		FX_DELTA_FIELD(FlexSEA_Delta_Test_s, var3_int16),
+		FX_DELTA_FIELD(FlexSEA_Delta_Test_s, var4_float)};
+#define DELTA_TEST_FIELDS	sizeof(delta_test_fields)
+
+//Can we describe a structure? Do we refuse the ones that are too large?
+void test_delta_init(void)
+{
+	DeltaCodec d;
+	uint8_t fields[FX_DELTA_MAX_FIELDS + 1] = {0};
+
+	TEST_ASSERT_EQUAL(0, fx_delta_init(&d, delta_test_fields, DELTA_TEST_FIELDS, 10, 1));
+	TEST_ASSERT_EQUAL(sizeof(FlexSEA_Delta_Test_s), d.obj_size);
+
+	//Too many fields
+	memset(fields, 1, sizeof(fields));
+	TEST_ASSERT_EQUAL(1, fx_delta_init(&d, fields, FX_DELTA_MAX_FIELDS + 1, 10, 1));
+	//Too many bytes
+	memset(fields, 4, sizeof(fields));
+	TEST_ASSERT_EQUAL(1, fx_delta_init(&d, fields, FX_DELTA_MAX_FIELDS, 10, 1));
+	//Nothing
+	TEST_ASSERT_EQUAL(1, fx_delta_init(&d, fields, 0, 10, 1));
+}
+
+//Keyframe, then small deltas, then a periodic keyframe
+void test_delta_encode_decode(void)
+{
+	DeltaCodec enc, dec;
+	FlexSEA_Delta_Test_s tx = {.var0_int8 = -1, .var1_uint32 = 123456,
+			.var2_uint8 = 150, .var3_int16 = -4567, .var4_float = 12.37};
+	FlexSEA_Delta_Test_s rx = {0};
+	uint8_t buf[1 + FX_DELTA_MAX_BYTES] = {0};
+	uint8_t buf_len = 0;
+
+	fx_delta_init(&enc, delta_test_fields, DELTA_TEST_FIELDS, 3, 1);
+	fx_delta_init(&dec, delta_test_fields, DELTA_TEST_FIELDS, 3, 1);
+
+	//First payload is a keyframe
+	TEST_ASSERT_EQUAL(0, fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len));
+	TEST_ASSERT_EQUAL(1 + sizeof(tx), buf_len);
+	TEST_ASSERT_EQUAL(FX_DELTA_KEYFRAME, buf[0] & FX_DELTA_KEYFRAME);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+
+	//Nothing changed: ID + bitmap only
+	memset(&rx, 0, sizeof(rx));
+	TEST_ASSERT_EQUAL(0, fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len));
+	TEST_ASSERT_EQUAL(2, buf_len);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+
+	//One field changed
+	tx.var3_int16 = 1000;
+	TEST_ASSERT_EQUAL(0, fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len));
+	TEST_ASSERT_EQUAL(2 + sizeof(tx.var3_int16), buf_len);
+	TEST_ASSERT_EQUAL((1 << 3), buf[1]);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+
+	//Two fields changed. Deltas are relative to the keyframe, not to the
+	//last payload, so var3 is still in there.
+	tx.var0_int8 = 5;
+	TEST_ASSERT_EQUAL(0, fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len));
+	TEST_ASSERT_EQUAL(2 + 1 + 2, buf_len);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+
+	//Keyframe interval reached
+	TEST_ASSERT_EQUAL(0, fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len));
+	TEST_ASSERT_EQUAL(1 + sizeof(tx), buf_len);
+	TEST_ASSERT_EQUAL(FX_DELTA_KEYFRAME | 1, buf[0]);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+}
+
+//Lost keyframe: deltas can't be decoded until the next keyframe
+void test_delta_lost_keyframe(void)
+{
+	DeltaCodec enc, dec;
+	FlexSEA_Delta_Test_s tx = {.var0_int8 = -1, .var1_uint32 = 123456};
+	FlexSEA_Delta_Test_s rx = {0};
+	uint8_t buf[1 + FX_DELTA_MAX_BYTES] = {0};
+	uint8_t buf_len = 0;
+
+	fx_delta_init(&enc, delta_test_fields, DELTA_TEST_FIELDS, 2, 1);
+	fx_delta_init(&dec, delta_test_fields, DELTA_TEST_FIELDS, 2, 1);
+
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);	//Lost
+	tx.var1_uint32++;
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(1, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	tx.var1_uint32++;
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(1, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	tx.var1_uint32++;
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);	//Keyframe
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+
+	//Truncated delta
+	tx.var1_uint32++;
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(1, fx_delta_decode(&dec, buf, buf_len - 1, (uint8_t*)&rx));
+}
+
+//Without auto_ack deltas stay relative to the last acknowledged keyframe
+void test_delta_ack(void)
+{
+	DeltaCodec enc, dec;
+	FlexSEA_Delta_Test_s tx = {.var0_int8 = -1, .var1_uint32 = 123456};
+	FlexSEA_Delta_Test_s rx = {0};
+	uint8_t buf[1 + FX_DELTA_MAX_BYTES] = {0};
+	uint8_t buf_len = 0, key_id = 0, ack = 0;
+
+	fx_delta_init(&enc, delta_test_fields, DELTA_TEST_FIELDS, 2, 0);
+	fx_delta_init(&dec, delta_test_fields, DELTA_TEST_FIELDS, 2, 0);
+	TEST_ASSERT_EQUAL(1, fx_delta_get_ack(&dec, &ack));
+
+	//Before the first ack, deltas refer to the last keyframe sent
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(FX_DELTA_KEYFRAME, buf[0] & FX_DELTA_KEYFRAME);
+	key_id = buf[0] & FX_DELTA_ID_MASK;
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(key_id, buf[0]);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+
+	//The ack byte comes back with the next request
+	TEST_ASSERT_EQUAL(0, fx_delta_get_ack(&dec, &ack));
+	TEST_ASSERT_EQUAL(FX_DELTA_KEYFRAME | key_id, ack);
+	TEST_ASSERT_EQUAL(1, fx_delta_ack(&enc, key_id + 1));
+	TEST_ASSERT_EQUAL(0, fx_delta_ack(&enc, ack));
+	TEST_ASSERT_EQUAL(1, fx_delta_ack(&enc, ack));
+
+	tx.var2_uint8 = 33;
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(key_id, buf[0]);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+
+	//New keyframe isn't acknowledged: deltas use the previous one, and the
+	//decoder still knows it
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(FX_DELTA_KEYFRAME, buf[0] & FX_DELTA_KEYFRAME);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	tx.var3_int16 = -2;
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(key_id, buf[0]);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+}
+
+//Acks stop coming back: deltas never refer to a keyframe the decoder has
+//dropped, and a lost keyframe only costs the deltas up to the next one
+void test_delta_unacknowledged(void)
+{
+	DeltaCodec enc, dec;
+	FlexSEA_Delta_Test_s tx = {.var0_int8 = -1, .var1_uint32 = 123456};
+	FlexSEA_Delta_Test_s rx = {0};
+	uint8_t buf[1 + FX_DELTA_MAX_BYTES] = {0};
+	uint8_t buf_len = 0, ack = 0, lost = 0, keyframes = 0;
+
+	fx_delta_init(&enc, delta_test_fields, DELTA_TEST_FIELDS, 2, 0);
+	fx_delta_init(&dec, delta_test_fields, DELTA_TEST_FIELDS, 2, 0);
+
+	fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+	TEST_ASSERT_EQUAL(0, fx_delta_decode(&dec, buf, buf_len, (uint8_t*)&rx));
+	TEST_ASSERT_EQUAL(0, fx_delta_get_ack(&dec, &ack));
+	TEST_ASSERT_EQUAL(0, fx_delta_ack(&enc, ack));
+
+	for(int i = 0; i < 5 * FX_DELTA_KEYFRAMES * 3; i++)
+	{
+		tx.var1_uint32 = i;
+		fx_delta_encode(&enc, (uint8_t*)&tx, buf, &buf_len);
+		if(buf[0] & FX_DELTA_KEYFRAME)
+		{
+			//The third one after the last ack never makes it
+			lost = (++keyframes == 3);
+			if(lost)
+			{
+				continue;
+			}
+		}
+		else if(keyframes > FX_DELTA_KEYFRAMES)
+		{
+			TEST_ASSERT_TRUE(buf[0] != (ack & FX_DELTA_ID_MASK));
+		}
+
+		TEST_ASSERT_EQUAL(lost, fx_delta_decode(&dec, buf, buf_len,
+				(uint8_t*)&rx));
+		if(!lost)
+		{
+			TEST_ASSERT_EQUAL_UINT8_ARRAY(&tx, &rx, sizeof(tx));
+		}
+	}
+	TEST_ASSERT_TRUE(keyframes > 3);
+}
+
+void test_flexsea_delta(void)
+{
+	RUN_TEST(test_delta_init);
+	RUN_TEST(test_delta_encode_decode);
+	RUN_TEST(test_delta_lost_keyframe);
+	RUN_TEST(test_delta_ack);
+	RUN_TEST(test_delta_unacknowledged);
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,131 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tests.h"
+#include "flexsea.h"
+
+//Samples land in log2 buckets, percentiles are the bucket's upper bound
+void test_profile_percentile(void)
+{
+	fx_profile_reset();
+
+	for(int i = 0; i < 99; i++)
+	{
+		fx_profile_record(FX_STAGE_HANDLER, 10);
+	}
+	fx_profile_record(FX_STAGE_HANDLER, 1000);
+	fx_profile_record(FX_STAGES, 10);	//Invalid stage, ignored
+
+#if FX_PROFILE_ENABLE
+	TEST_ASSERT_EQUAL(100, fx_profile_get_count(FX_STAGE_HANDLER));
+	TEST_ASSERT_EQUAL(1000, fx_profile_get_max(FX_STAGE_HANDLER));
+	//10 is in [8,16)
+	TEST_ASSERT_EQUAL(15, fx_profile_get_percentile(FX_STAGE_HANDLER, 50));
+	TEST_ASSERT_EQUAL(15, fx_profile_get_percentile(FX_STAGE_HANDLER, 99));
+	//1000 is in [512,1024), capped to the max
+	TEST_ASSERT_EQUAL(1000, fx_profile_get_percentile(FX_STAGE_HANDLER, 100));
+
+	//Zero gets its own bucket
+	fx_profile_record(FX_STAGE_DECODE, 0);
+	TEST_ASSERT_EQUAL(1, fx_profile_get_count(FX_STAGE_DECODE));
+	TEST_ASSERT_EQUAL(0, fx_profile_get_percentile(FX_STAGE_DECODE, 50));
+#endif
+
+	//Empty stage, and reset
+	TEST_ASSERT_EQUAL(0, fx_profile_get_count(FX_STAGE_ENCODE));
+	TEST_ASSERT_EQUAL(0, fx_profile_get_percentile(FX_STAGE_ENCODE, 50));
+	fx_profile_reset();
+	TEST_ASSERT_EQUAL(0, fx_profile_get_count(FX_STAGE_HANDLER));
+	TEST_ASSERT_EQUAL(0, fx_profile_get_max(FX_STAGE_HANDLER));
+}
+
+//Are the stages timed, and can we read them with FX_CMD_DIAG?
+void test_profile_diag(void)
+{
+	static circ_buf_t cb;
+	CommPort cp;
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[1] = {FX_DIAG_PROFILE};
+	uint8_t cmd = 0, len = 0;
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint16_t index = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+	uint32_t count[FX_STAGES] = {0};
+
+	circ_buf_init(&cb);
+	fx_comm_port_init(&cp, 0, &cb, NULL);
+	fx_profile_reset();
+
+	//Request (encode), received (decode, parse, handler)
+	fx_create_bytestream_from_cmd(FX_CMD_DIAG, CmdRead, Nack, payload, 1,
+			bytestream, &bytestream_len);
+	for(int i = 0; i < bytestream_len; i++)
+	{
+		circ_buf_write_byte(&cb, bytestream[i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_receive(&cp));
+	TEST_ASSERT_EQUAL(1, fx_comm_process_replies(&cp));
+
+	//Decode the reply
+	TxFrame *frame = &cp.txq.frame[TxReply][0];
+	circ_buf_init(&cb);
+	for(int i = 0; i < frame->len; i++)
+	{
+		circ_buf_write_byte(&cb, frame->data[i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_get_cmd_handler_from_bytestream(&cb, &cmd, &rw,
+			&ack, buf, &len));
+	TEST_ASSERT_EQUAL(FX_CMD_DIAG, cmd);
+	index = CMD_OVERHEAD;
+	TEST_ASSERT_EQUAL(FX_DIAG_PROFILE, buf[index++]);
+	TEST_ASSERT_EQUAL(fx_timestamp_hz(), REBUILD_UINT32(buf, &index));
+	TEST_ASSERT_EQUAL(FX_STAGES, buf[index++]);
+	for(int i = 0; i < FX_STAGES; i++)
+	{
+		count[i] = REBUILD_UINT32(buf, &index);
+		uint32_t p50 = REBUILD_UINT32(buf, &index);
+		uint32_t p99 = REBUILD_UINT32(buf, &index);
+		uint32_t max = REBUILD_UINT32(buf, &index);
+		TEST_ASSERT_EQUAL(1, (p50 <= p99) && (p99 <= max));
+	}
+	TEST_ASSERT_EQUAL(len, index);
+
+#if FX_PROFILE_ENABLE
+	TEST_ASSERT_EQUAL(1, count[FX_STAGE_DECODE]);
+	TEST_ASSERT_EQUAL(1, count[FX_STAGE_PARSE]);
+	TEST_ASSERT_EQUAL(1, count[FX_STAGE_HANDLER]);
+	TEST_ASSERT_EQUAL(1, count[FX_STAGE_ENCODE]);
+#else
+	TEST_ASSERT_EQUAL(0, count[FX_STAGE_HANDLER]);
+#endif
+
+	//Write resets
+	fx_create_bytestream_from_cmd(FX_CMD_DIAG, CmdWrite, Nack, payload, 1,
+			bytestream, &bytestream_len);
+	circ_buf_init(&cb);
+	for(int i = 0; i < bytestream_len; i++)
+	{
+		circ_buf_write_byte(&cb, bytestream[i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_receive(&cp));
+#if FX_PROFILE_ENABLE
+	//Only the handler's own exit is left
+	TEST_ASSERT_EQUAL(0, fx_profile_get_count(FX_STAGE_DECODE));
+	TEST_ASSERT_EQUAL(1, fx_profile_get_count(FX_STAGE_HANDLER));
+#endif
+}
+
+void test_flexsea_profile(void)
+{
+	RUN_TEST(test_profile_percentile);
+	RUN_TEST(test_profile_diag);
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
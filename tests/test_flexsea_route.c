@@ -0,0 +1,229 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tests.h"
+#include "flexsea.h"
+
+static uint8_t route_local_calls = 0;
+static uint8_t route_local_data = 0;
+
+static uint8_t route_tx(uint8_t *bytes, uint16_t len)
+{
+	return 0;
+}
+
+static uint8_t route_local_handler(uint8_t cmd_6bits, ReadWrite rw,
+		AckNack ack, uint8_t *buf, uint8_t len)
+{
+	route_local_calls++;
+	route_local_data = buf[CMD_OVERHEAD];
+	return FX_SUCCESS;
+}
+
+//Put a frame in a port's ring
+static void route_feed(CommPort *cp, uint8_t *bytes, uint8_t len)
+{
+	for(int i = 0; i < len; i++)
+	{
+		circ_buf_write_byte(cp->cb, bytes[i]);
+	}
+}
+
+//USB in, two buses out: by address, fan-out, local frames and misses
+void test_route_by_address(void)
+{
+	static circ_buf_t cb_in, cb_a, cb_b;
+	CommPort in, bus_a, bus_b;
+	FxRouter r;
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[3] = {ESCAPE, HEADER, 3};
+	TxFrame *out = NULL;
+
+	circ_buf_init(&cb_in);
+	circ_buf_init(&cb_a);
+	circ_buf_init(&cb_b);
+	fx_comm_port_init(&in, 0, &cb_in, &route_tx);
+	fx_comm_port_init(&bus_a, 1, &cb_a, &route_tx);
+	fx_comm_port_init(&bus_b, 2, &cb_b, &route_tx);
+	in.addr = 1;	//The bridge
+	fx_register_rx_cmd_handler(12, &route_local_handler);
+	route_local_calls = 0;
+
+	fx_route_init(&r);
+	TEST_ASSERT_EQUAL(0, fx_route_add(&r, RouteByAddr, 5, &bus_a, TxReply));
+	TEST_ASSERT_EQUAL(0, fx_route_add(&r, RouteByAddr, 6, &bus_b, TxReply));
+	TEST_ASSERT_EQUAL(0, fx_route_add(&r, RouteByAddr, FX_ADDR_BROADCAST,
+			&bus_a, TxControl));
+	TEST_ASSERT_EQUAL(0, fx_route_add(&r, RouteByAddr, FX_ADDR_BROADCAST,
+			&bus_b, TxControl));
+	TEST_ASSERT_EQUAL(1, fx_route_add(&r, RouteByCmd, 64, &bus_b, TxReply));
+	TEST_ASSERT_EQUAL(1, fx_route_add(&r, RouteByCmd, 12, &bus_b, TX_CLASSES));
+
+	//Nothing received
+	TEST_ASSERT_EQUAL(1, fx_route_receive(&r, &in));
+
+	//For node 5: bus A gets the same bytes
+	fx_create_bytestream_from_cmd_addr(5, 12, CmdRead, Nack, payload, 3,
+			bytestream, &bytestream_len);
+	route_feed(&in, bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_route_receive(&r, &in));
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_pending(&bus_a));
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_pending(&bus_b));
+	out = &bus_a.txq.frame[TxReply][0];
+	TEST_ASSERT_EQUAL(bytestream_len, out->len);
+	TEST_ASSERT_EQUAL(0, memcmp(bytestream, out->data, bytestream_len));
+	TEST_ASSERT_EQUAL(0, route_local_calls);
+
+	//Broadcast: both buses
+	fx_create_bytestream_from_cmd_addr(FX_ADDR_BROADCAST, 12, CmdWrite, Nack,
+			payload, 3, bytestream, &bytestream_len);
+	route_feed(&in, bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_route_receive(&r, &in));
+	TEST_ASSERT_EQUAL(FX_TXQ_DEPTH - 1, fx_tx_queue_free(&bus_a, TxControl));
+	TEST_ASSERT_EQUAL(FX_TXQ_DEPTH - 1, fx_tx_queue_free(&bus_b, TxControl));
+	TEST_ASSERT_EQUAL(3, r.forwarded);
+
+	//For the bridge itself: executed, and answered by 'in'
+	fx_create_bytestream_from_cmd_addr(1, 12, CmdRead, Nack, payload, 3,
+			bytestream, &bytestream_len);
+	route_feed(&in, bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_route_receive(&r, &in));
+	TEST_ASSERT_EQUAL(1, route_local_calls);
+	TEST_ASSERT_EQUAL(1, r.local);
+	TEST_ASSERT_EQUAL(1, fx_reply_queue_length(&in));
+
+	//Unknown node: dropped
+	fx_create_bytestream_from_cmd_addr(9, 12, CmdRead, Nack, payload, 3,
+			bytestream, &bytestream_len);
+	route_feed(&in, bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(1, fx_route_receive(&r, &in));
+	TEST_ASSERT_EQUAL(1, in.stats.codec.frames_filtered);
+	TEST_ASSERT_EQUAL(1, route_local_calls);
+
+	//Output full: counted
+	for(int i = 0; i < FX_TXQ_DEPTH; i++)
+	{
+		fx_create_bytestream_from_cmd_addr(6, 12, CmdRead, Nack, payload, 3,
+				bytestream, &bytestream_len);
+		route_feed(&in, bytestream, bytestream_len);
+		TEST_ASSERT_EQUAL(0, fx_route_receive(&r, &in));
+	}
+	route_feed(&in, bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_route_receive(&r, &in));
+	TEST_ASSERT_EQUAL(1, r.dropped);
+	TEST_ASSERT_EQUAL(1, bus_b.stats.frames_dropped[TxReply]);
+}
+
+//Point-to-point input, routed by command code (escaped command byte)
+void test_route_by_command(void)
+{
+	static circ_buf_t cb_in, cb_a;
+	CommPort in, bus_a;
+	FxRouter r;
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[2] = {1, 2};
+
+	circ_buf_init(&cb_in);
+	circ_buf_init(&cb_a);
+	fx_comm_port_init(&in, 0, &cb_in, &route_tx);
+	fx_comm_port_init(&bus_a, 1, &cb_a, &route_tx);
+	fx_register_rx_cmd_handler(12, &route_local_handler);
+	route_local_calls = 0;
+
+	//59 << 2 | CmdRead = 0xED, a HEADER: the command byte gets escaped
+	fx_route_init(&r);
+	TEST_ASSERT_EQUAL(0, fx_route_add(&r, RouteByCmd, 59, &bus_a, TxBulk));
+	TEST_ASSERT_EQUAL(0, fx_route_add(&r, RouteByAddr, 5, &bus_a, TxBulk));
+
+	fx_create_bytestream_from_cmd(59, CmdRead, Nack, payload, 2, bytestream,
+			&bytestream_len);
+	TEST_ASSERT_EQUAL(ESCAPE, bytestream[2]);
+	route_feed(&in, bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_route_receive(&r, &in));
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_pending(&bus_a));
+	TEST_ASSERT_EQUAL(0, memcmp(bytestream, bus_a.txq.frame[TxBulk][0].data,
+			bytestream_len));
+
+	//Other commands are ours
+	fx_create_bytestream_from_cmd(12, CmdWrite, Nack, payload, 2, bytestream,
+			&bytestream_len);
+	route_feed(&in, bytestream, bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_route_receive(&r, &in));
+	TEST_ASSERT_EQUAL(1, route_local_calls);
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_pending(&bus_a));
+}
+
+//Frames are decoded in the slot of the route we peeked. A corrupted frame
+//ahead of a good one must not leave the good one in the wrong place.
+void test_route_in_place(void)
+{
+	static circ_buf_t cb_in, cb_a, cb_b;
+	CommPort in, bus_a, bus_b;
+	FxRouter r;
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[3] = {1, 2, 3};
+	uint8_t expected[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t expected_len = 0;
+
+	circ_buf_init(&cb_in);
+	circ_buf_init(&cb_a);
+	circ_buf_init(&cb_b);
+	fx_comm_port_init(&in, 0, &cb_in, &route_tx);
+	fx_comm_port_init(&bus_a, 1, &cb_a, &route_tx);
+	fx_comm_port_init(&bus_b, 2, &cb_b, &route_tx);
+	in.addr = 1;
+	fx_register_rx_cmd_handler(12, &route_local_handler);
+	route_local_calls = 0;
+
+	fx_route_init(&r);
+	TEST_ASSERT_EQUAL(0, fx_route_add(&r, RouteByAddr, 5, &bus_a, TxReply));
+	TEST_ASSERT_EQUAL(0, fx_route_add(&r, RouteByAddr, 6, &bus_b, TxReply));
+
+	//For node 5, bad checksum, then for node 6, then for the bridge: the
+	//first one is skipped, each good one lands where it belongs
+	for(int i = 0; i < 2; i++)
+	{
+		fx_create_bytestream_from_cmd_addr(5, 12, CmdRead, Nack, payload, 3,
+				bytestream, &bytestream_len);
+		bytestream[bytestream_len - 2]++;
+		route_feed(&in, bytestream, bytestream_len);
+		payload[0] = i ? 0x42 : 1;
+		fx_create_bytestream_from_cmd_addr(i ? 1 : 6, 12, CmdRead, Nack,
+				payload, 3, bytestream, &bytestream_len);
+		route_feed(&in, bytestream, bytestream_len);
+		TEST_ASSERT_EQUAL(0, fx_route_receive(&r, &in));
+		if(i == 0)
+		{
+			memcpy(expected, bytestream, bytestream_len);
+			expected_len = bytestream_len;
+		}
+	}
+
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_pending(&bus_a));
+	TEST_ASSERT_EQUAL(1, fx_tx_queue_pending(&bus_b));
+	TEST_ASSERT_EQUAL(expected_len, bus_b.txq.frame[TxReply][0].len);
+	TEST_ASSERT_EQUAL(0, memcmp(expected, bus_b.txq.frame[TxReply][0].data,
+			expected_len));
+	TEST_ASSERT_EQUAL(1, r.forwarded);
+	TEST_ASSERT_EQUAL(1, r.local);
+	TEST_ASSERT_EQUAL(1, route_local_calls);
+	TEST_ASSERT_EQUAL(0x42, route_local_data);
+	TEST_ASSERT_EQUAL(1, fx_reply_queue_length(&in));
+}
+
+void test_flexsea_route(void)
+{
+	RUN_TEST(test_route_by_address);
+	RUN_TEST(test_route_by_command);
+	RUN_TEST(test_route_in_place);
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,316 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tests.h"
+#include "flexsea.h"
+
+#if defined(__linux__)
+
+#include <poll.h>
+#include <unistd.h>
+
+static int serial_dev_fd = -1;
+static uint8_t serial_handler_calls = 0;
+
+static uint8_t serial_dev_tx(uint8_t *bytes, uint16_t len)
+{
+	return fx_serial_write(serial_dev_fd, bytes, len);
+}
+
+static uint8_t serial_handler(uint8_t cmd_6bits, ReadWrite rw, AckNack ack,
+		uint8_t *buf, uint8_t len)
+{
+	serial_handler_calls++;
+	return FX_SUCCESS;
+}
+
+static uint8_t serial_failing_handler(uint8_t cmd_6bits, ReadWrite rw,
+		AckNack ack, uint8_t *buf, uint8_t len)
+{
+	return FX_PROBLEM;
+}
+
+static uint8_t serial_reply_builder(uint8_t cmd_6bits, uint8_t *buf,
+		uint8_t *len)
+{
+	memcpy(buf, "pty", 3);
+	*len = 3;
+	return FX_SUCCESS;
+}
+
+//A simulated device on a pseudo-terminal: requests written on the master side
+//wake the loop up, get decoded and answered
+void test_serial_pty_loop(void)
+{
+	static circ_buf_t cb;
+	CommPort dev;
+	FxSerialLoop loop;
+	int master_fd = -1, fd_invalid = -1;
+	char slave[64] = {0};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t burst[3 * MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint16_t burst_len = 0;
+	uint8_t rx[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t payload[2] = {1, 2};
+	struct pollfd pfd;
+	ssize_t n = 0;
+
+	TEST_ASSERT_EQUAL(0, fx_serial_open_pty(&master_fd, slave, sizeof(slave)));
+	TEST_ASSERT_EQUAL(0, fx_serial_open(slave, 0, &serial_dev_fd));
+	TEST_ASSERT_EQUAL(1, fx_serial_open("/dev/does_not_exist", 115200,
+			&fd_invalid));
+
+	circ_buf_init(&cb);
+	fx_comm_port_init(&dev, 0, &cb, &serial_dev_tx);
+	fx_register_rx_cmd_handler(14, &serial_handler);
+	fx_register_tx_reply_builder(14, &serial_reply_builder);
+	serial_handler_calls = 0;
+	TEST_ASSERT_EQUAL(0, fx_serial_loop_init(&loop));
+	TEST_ASSERT_EQUAL(0, fx_serial_loop_add(&loop, serial_dev_fd, &dev));
+
+	//Nothing yet
+	TEST_ASSERT_EQUAL(0, fx_serial_loop_run(&loop, 0));
+
+	//Three requests in one burst, one wake-up
+	for(int i = 0; i < 3; i++)
+	{
+		fx_create_bytestream_from_cmd(14, (i == 2) ? CmdRead : CmdWrite, Nack,
+				payload, 2, bytestream, &bytestream_len);
+		memcpy(&burst[burst_len], bytestream, bytestream_len);
+		burst_len += bytestream_len;
+	}
+	TEST_ASSERT_EQUAL(0, fx_serial_write(master_fd, burst, burst_len));
+	TEST_ASSERT_EQUAL(3, fx_serial_loop_run(&loop, 1000));
+	TEST_ASSERT_EQUAL(3, serial_handler_calls);
+	TEST_ASSERT_EQUAL(burst_len, dev.stats.bytes_received);
+	TEST_ASSERT_EQUAL(1, loop.wakeups);
+
+	//The read got answered
+	pfd.fd = master_fd;
+	pfd.events = POLLIN;
+	TEST_ASSERT_EQUAL(1, poll(&pfd, 1, 1000));
+	n = read(master_fd, rx, sizeof(rx));
+	TEST_ASSERT_TRUE(n > MIN_OVERHEAD);
+	TEST_ASSERT_EQUAL(HEADER, rx[0]);
+	TEST_ASSERT_EQUAL(14, CMD_GET_6BITS(rx[2]));
+	TEST_ASSERT_EQUAL(1, dev.stats.frames_sent);
+
+	fx_serial_loop_close(&loop);
+	fx_serial_close(serial_dev_fd);
+	fx_serial_close(master_fd);
+}
+
+//More pipelined reads than the TX queue holds, behind a frame whose handler
+//fails: everything is handled and answered in one pass
+void test_serial_loop_drain(void)
+{
+	static circ_buf_t cb;
+	CommPort dev;
+	FxSerialLoop loop;
+	int master_fd = -1;
+	char slave[64] = {0};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t burst[7 * MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint16_t burst_len = 0;
+	uint8_t rx[7 * MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint16_t rx_len = 0;
+	uint8_t payload[2] = {1, 2};
+	struct pollfd pfd;
+	ssize_t n = 0;
+
+	TEST_ASSERT_EQUAL(0, fx_serial_open_pty(&master_fd, slave, sizeof(slave)));
+	TEST_ASSERT_EQUAL(0, fx_serial_open(slave, 0, &serial_dev_fd));
+	circ_buf_init(&cb);
+	fx_comm_port_init(&dev, 0, &cb, &serial_dev_tx);
+	fx_register_rx_cmd_handler(14, &serial_handler);
+	fx_register_tx_reply_builder(14, &serial_reply_builder);
+	fx_register_rx_cmd_handler(15, &serial_failing_handler);
+	serial_handler_calls = 0;
+	TEST_ASSERT_EQUAL(0, fx_serial_loop_init(&loop));
+	TEST_ASSERT_EQUAL(0, fx_serial_loop_add(&loop, serial_dev_fd, &dev));
+
+	fx_create_bytestream_from_cmd(15, CmdWrite, Nack, payload, 2, bytestream,
+			&bytestream_len);
+	memcpy(&burst[burst_len], bytestream, bytestream_len);
+	burst_len += bytestream_len;
+	for(int i = 0; i < 6; i++)
+	{
+		fx_create_bytestream_from_cmd(14, CmdRead, Nack, payload, 2,
+				bytestream, &bytestream_len);
+		memcpy(&burst[burst_len], bytestream, bytestream_len);
+		burst_len += bytestream_len;
+	}
+	TEST_ASSERT_EQUAL(0, fx_serial_write(master_fd, burst, burst_len));
+	TEST_ASSERT_EQUAL(7, fx_serial_loop_run(&loop, 1000));
+	TEST_ASSERT_EQUAL(6, serial_handler_calls);
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_length(&dev));
+	TEST_ASSERT_EQUAL(6, dev.stats.frames_sent);
+
+	//All six replies are on their way, no new RX bytes needed
+	pfd.fd = master_fd;
+	pfd.events = POLLIN;
+	while((rx_len < 6 * (MIN_OVERHEAD + CMD_OVERHEAD + 3)) &&
+			(poll(&pfd, 1, 1000) == 1))
+	{
+		n = read(master_fd, &rx[rx_len], sizeof(rx) - rx_len);
+		TEST_ASSERT_TRUE(n > 0);
+		rx_len += n;
+	}
+	TEST_ASSERT_EQUAL(6 * (MIN_OVERHEAD + CMD_OVERHEAD + 3), rx_len);
+
+	fx_serial_loop_close(&loop);
+	fx_serial_close(serial_dev_fd);
+	fx_serial_close(master_fd);
+}
+
+//Noise full of false headers doesn't keep the loop busy, and the frame that
+//follows it gets decoded
+void test_serial_loop_noise(void)
+{
+	static circ_buf_t cb;
+	CommPort dev;
+	FxSerialLoop loop;
+	int master_fd = -1;
+	char slave[64] = {0};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t noise[1500];
+	uint8_t payload[2] = {1, 2};
+
+	TEST_ASSERT_EQUAL(0, fx_serial_open_pty(&master_fd, slave, sizeof(slave)));
+	TEST_ASSERT_EQUAL(0, fx_serial_open(slave, 0, &serial_dev_fd));
+	circ_buf_init(&cb);
+	fx_comm_port_init(&dev, 0, &cb, &serial_dev_tx);
+	fx_register_rx_cmd_handler(14, &serial_handler);
+	serial_handler_calls = 0;
+	TEST_ASSERT_EQUAL(0, fx_serial_loop_init(&loop));
+	TEST_ASSERT_EQUAL(0, fx_serial_loop_add(&loop, serial_dev_fd, &dev));
+
+	//Everything got read, nothing is left to wake us up
+	memset(noise, HEADER, sizeof(noise));
+	TEST_ASSERT_EQUAL(0, fx_serial_write(master_fd, noise, sizeof(noise)));
+	while((dev.stats.bytes_received < sizeof(noise)) && (loop.wakeups < 100))
+	{
+		fx_serial_loop_run(&loop, 100);
+	}
+	TEST_ASSERT_EQUAL(sizeof(noise), dev.stats.bytes_received);
+	TEST_ASSERT_EQUAL(0, fx_serial_loop_run(&loop, 0));
+	TEST_ASSERT_TRUE(loop.wakeups < 100);
+
+	fx_create_bytestream_from_cmd(14, CmdWrite, Nack, payload, 2, bytestream,
+			&bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_serial_write(master_fd, bytestream, bytestream_len));
+	TEST_ASSERT_EQUAL(1, fx_serial_loop_run(&loop, 1000));
+	TEST_ASSERT_EQUAL(1, serial_handler_calls);
+
+	fx_serial_loop_close(&loop);
+	fx_serial_close(serial_dev_fd);
+	fx_serial_close(master_fd);
+}
+
+//A host blocked on a reply: other frames are handled on the way, and only the
+//ack with the right packet number ends the wait
+void test_serial_wait_for_reply(void)
+{
+	static circ_buf_t cb;
+	CommPort host;
+	FxSerialPort port;
+	int master_fd = -1;
+	char slave[64] = {0};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[3] = {14, 0, 0};
+	uint16_t pnum[2] = {5, 7};
+
+	TEST_ASSERT_EQUAL(0, fx_serial_open_pty(&master_fd, slave, sizeof(slave)));
+	circ_buf_init(&cb);
+	fx_comm_port_init(&host, 1, &cb, NULL);
+	port.cp = &host;
+	port.frames = 0;
+	TEST_ASSERT_EQUAL(0, fx_serial_open(slave, 0, &port.fd));
+	fx_register_rx_cmd_handler(14, &serial_handler);
+	serial_handler_calls = 0;
+
+	//A frame for someone else's handler, then two acks
+	fx_create_bytestream_from_cmd(14, CmdWrite, Nack, payload, 2, bytestream,
+			&bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_serial_write(master_fd, bytestream, bytestream_len));
+	for(int i = 0; i < 2; i++)
+	{
+		payload[1] = CMD_ACK_PNUM_LSB(pnum[i]);
+		payload[2] = CMD_ACK_PNUM_MSB(1, pnum[i]);
+		fx_create_bytestream_from_cmd(FX_CMD_ACK, CmdWrite, Ack, payload, 3,
+				bytestream, &bytestream_len);
+		TEST_ASSERT_EQUAL(0, fx_serial_write(master_fd, bytestream,
+				bytestream_len));
+	}
+
+	TEST_ASSERT_EQUAL(0, fx_wait_for_reply(&port, FX_CMD_ACK, 7, 1000000));
+	TEST_ASSERT_EQUAL(1, serial_handler_calls);
+	TEST_ASSERT_EQUAL(3, port.frames);
+	TEST_ASSERT_EQUAL(7, host.rx_last.acked);
+
+	//Nothing else is coming
+	TEST_ASSERT_EQUAL(1, fx_wait_for_reply(&port, 14, FX_PNUM_ANY, 2000));
+
+	fx_serial_close(port.fd);
+	fx_serial_close(master_fd);
+}
+
+//A burst of false headers doesn't make the next waits time out
+void test_serial_wait_after_noise(void)
+{
+	static circ_buf_t cb;
+	CommPort host;
+	FxSerialPort port;
+	int master_fd = -1;
+	char slave[64] = {0};
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t noise[1500];
+	uint8_t payload[3] = {14, CMD_ACK_PNUM_LSB(9), CMD_ACK_PNUM_MSB(1, 9)};
+
+	TEST_ASSERT_EQUAL(0, fx_serial_open_pty(&master_fd, slave, sizeof(slave)));
+	circ_buf_init(&cb);
+	fx_comm_port_init(&host, 1, &cb, NULL);
+	port.cp = &host;
+	port.frames = 0;
+	TEST_ASSERT_EQUAL(0, fx_serial_open(slave, 0, &port.fd));
+
+	memset(noise, HEADER, sizeof(noise));
+	TEST_ASSERT_EQUAL(0, fx_serial_write(master_fd, noise, sizeof(noise)));
+	TEST_ASSERT_EQUAL(1, fx_wait_for_reply(&port, FX_CMD_ACK, 9, 20000));
+
+	fx_create_bytestream_from_cmd(FX_CMD_ACK, CmdWrite, Ack, payload, 3,
+			bytestream, &bytestream_len);
+	TEST_ASSERT_EQUAL(0, fx_serial_write(master_fd, bytestream, bytestream_len));
+	TEST_ASSERT_EQUAL(0, fx_wait_for_reply(&port, FX_CMD_ACK, 9, 1000000));
+	TEST_ASSERT_EQUAL(sizeof(noise) + bytestream_len,
+			host.stats.bytes_received);
+	TEST_ASSERT_EQUAL(1, port.frames);
+
+	fx_serial_close(port.fd);
+	fx_serial_close(master_fd);
+}
+
+#endif	//defined(__linux__)
+
+void test_flexsea_serial(void)
+{
+#if defined(__linux__)
+	RUN_TEST(test_serial_pty_loop);
+	RUN_TEST(test_serial_loop_drain);
+	RUN_TEST(test_serial_loop_noise);
+	RUN_TEST(test_serial_wait_for_reply);
+	RUN_TEST(test_serial_wait_after_noise);
+#endif
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
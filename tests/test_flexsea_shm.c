@@ -0,0 +1,226 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tests.h"
+#include "flexsea.h"
+
+#if defined(__linux__)
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+static char shm_name[32] = {0};
+
+//Unique per test run: tests can run in parallel on the same machine
+static const char *shm_test_name(void)
+{
+	snprintf(shm_name, sizeof(shm_name), "/fx_test_%d", (int)getpid());
+	return shm_name;
+}
+
+//[CMD|RW][ACK|PNUM][PNUM][DATA]
+static uint8_t shm_frame(uint8_t *buf, uint8_t cmd, uint8_t value)
+{
+	buf[0] = CMD_SET_W(cmd);
+	buf[1] = 0;
+	buf[2] = 0;
+	buf[3] = value;
+	return 4;
+}
+
+//Daemon and client in the same process, two mappings of the same region
+void test_shm_publish_read(void)
+{
+	FxShm daemon, client, other;
+	FxShmReader r, r_other_cmd, r_latest;
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0}, len = 0;
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES] = {0}, frame_len = 0;
+
+	TEST_ASSERT_EQUAL(1, fx_shm_attach(&client, shm_test_name()));
+	TEST_ASSERT_EQUAL(1, fx_shm_create(&daemon, shm_test_name(), 0));
+	TEST_ASSERT_EQUAL(0, fx_shm_create(&daemon, shm_test_name(), 2));
+	TEST_ASSERT_EQUAL(0, fx_shm_attach(&client, shm_test_name()));
+	TEST_ASSERT_TRUE(daemon.region != client.region);
+
+	//We are alive: a second daemon can't take over
+	TEST_ASSERT_EQUAL(1, fx_shm_create(&other, shm_test_name(), 1));
+
+	TEST_ASSERT_EQUAL(1, fx_shm_reader_init(&client, &r, 2, 20));
+	TEST_ASSERT_EQUAL(1, fx_shm_reader_init(&client, &r, 0, 64));
+	TEST_ASSERT_EQUAL(0, fx_shm_reader_init(&client, &r, 1, 20));
+	TEST_ASSERT_EQUAL(0, fx_shm_reader_init(&client, &r_other_cmd, 1, 21));
+	TEST_ASSERT_EQUAL(1, fx_shm_read(&client, &r, buf, &len));
+
+	//Frames go to their command's ring, in order
+	for(int i = 0; i < 3; i++)
+	{
+		frame_len = shm_frame(frame, 20, i);
+		TEST_ASSERT_EQUAL(0, fx_shm_publish(&daemon, 1, frame, frame_len));
+	}
+	frame_len = shm_frame(frame, 20, 99);
+	TEST_ASSERT_EQUAL(0, fx_shm_publish(&daemon, 0, frame, frame_len));
+	TEST_ASSERT_EQUAL(1, fx_shm_publish(&daemon, 2, frame, frame_len));
+	TEST_ASSERT_EQUAL(1, fx_shm_publish(&daemon, 0, frame, 2));
+	for(int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL(0, fx_shm_read(&client, &r, buf, &len));
+		TEST_ASSERT_EQUAL(4, len);
+		TEST_ASSERT_EQUAL(20, CMD_GET_6BITS(buf[0]));
+		TEST_ASSERT_EQUAL(i, buf[3]);
+		TEST_ASSERT_TRUE(r.t_rx_ns > 0);
+	}
+	TEST_ASSERT_EQUAL(1, fx_shm_read(&client, &r, buf, &len));
+	TEST_ASSERT_EQUAL(1, fx_shm_read(&client, &r_other_cmd, buf, &len));
+	TEST_ASSERT_EQUAL(0, r.lost);
+
+	//A reader that falls behind loses the oldest frames, and counts them
+	TEST_ASSERT_EQUAL(0, fx_shm_reader_init(&client, &r_latest, 1, 20));
+	for(int i = 0; i < FX_SHM_RX_DEPTH + 5; i++)
+	{
+		frame_len = shm_frame(frame, 20, i);
+		fx_shm_publish(&daemon, 1, frame, frame_len);
+	}
+	TEST_ASSERT_EQUAL(0, fx_shm_read(&client, &r, buf, &len));
+	TEST_ASSERT_EQUAL(5, buf[3]);
+	TEST_ASSERT_EQUAL(5, r.lost);
+	for(int i = 1; i < FX_SHM_RX_DEPTH; i++)
+	{
+		TEST_ASSERT_EQUAL(0, fx_shm_read(&client, &r, buf, &len));
+	}
+	TEST_ASSERT_EQUAL(FX_SHM_RX_DEPTH + 4, buf[3]);
+	TEST_ASSERT_EQUAL(1, fx_shm_read(&client, &r, buf, &len));
+
+	//Latest only: nothing is lost
+	TEST_ASSERT_EQUAL(0, fx_shm_read_latest(&client, &r_latest, buf, &len));
+	TEST_ASSERT_EQUAL(FX_SHM_RX_DEPTH + 4, buf[3]);
+	TEST_ASSERT_EQUAL(0, r_latest.lost);
+	TEST_ASSERT_EQUAL(1, fx_shm_read_latest(&client, &r_latest, buf, &len));
+
+	//Nothing came in
+	TEST_ASSERT_EQUAL(1, fx_shm_wait(&client, &r, 1000));
+
+	//Gone: clients keep their mapping, new ones can't attach
+	fx_shm_destroy(&daemon);
+	TEST_ASSERT_EQUAL(0, client.region->alive);
+	TEST_ASSERT_EQUAL(1, fx_shm_attach(&other, shm_test_name()));
+	fx_shm_detach(&client);
+}
+
+//Several producers, one consumer: frames come out in order until the queue
+//is full
+void test_shm_tx_queue(void)
+{
+	FxShm daemon, client;
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES] = {0}, len = 0, port = 0;
+
+	TEST_ASSERT_EQUAL(0, fx_shm_create(&daemon, shm_test_name(), 2));
+	TEST_ASSERT_EQUAL(0, fx_shm_attach(&client, shm_test_name()));
+
+	TEST_ASSERT_EQUAL(1, fx_shm_tx_pop(&daemon, &port, frame, &len));
+	TEST_ASSERT_EQUAL(1, fx_shm_tx_wait(&daemon, 1000));
+	TEST_ASSERT_EQUAL(1, fx_shm_tx_push(&client, 2, frame, 5));
+	TEST_ASSERT_EQUAL(1, fx_shm_tx_push(&client, 0, frame, 0));
+
+	for(int i = 0; i < FX_SHM_TX_DEPTH; i++)
+	{
+		frame[0] = i;
+		TEST_ASSERT_EQUAL(0, fx_shm_tx_push(&client, i & 1, frame, 1 + (i & 3)));
+	}
+	TEST_ASSERT_EQUAL(1, fx_shm_tx_push(&client, 0, frame, 1));
+	TEST_ASSERT_EQUAL(0, fx_shm_tx_wait(&daemon, 1000));
+
+	for(int i = 0; i < FX_SHM_TX_DEPTH; i++)
+	{
+		TEST_ASSERT_EQUAL(0, fx_shm_tx_pop(&daemon, &port, frame, &len));
+		TEST_ASSERT_EQUAL(i, frame[0]);
+		TEST_ASSERT_EQUAL(i & 1, port);
+		TEST_ASSERT_EQUAL(1 + (i & 3), len);
+
+		//Room again
+		if(i == 0)
+		{
+			TEST_ASSERT_EQUAL(0, fx_shm_tx_push(&client, 1, frame, 1));
+			TEST_ASSERT_EQUAL(1, fx_shm_tx_push(&client, 1, frame, 1));
+		}
+	}
+	TEST_ASSERT_EQUAL(0, fx_shm_tx_pop(&daemon, &port, frame, &len));
+	TEST_ASSERT_EQUAL(1, fx_shm_tx_pop(&daemon, &port, frame, &len));
+
+	fx_shm_detach(&client);
+	fx_shm_destroy(&daemon);
+}
+
+//Another process sleeps on a ring and wakes up for our frame, then pushes an
+//answer that wakes us up
+void test_shm_wait_other_process(void)
+{
+	FxShm daemon;
+	uint8_t frame[MAX_ENCODED_PAYLOAD_BYTES] = {0}, len = 0, port = 0;
+	int status = -1;
+	pid_t pid = 0;
+
+	TEST_ASSERT_EQUAL(0, fx_shm_create(&daemon, shm_test_name(), 1));
+
+	pid = fork();
+	TEST_ASSERT_TRUE(pid >= 0);
+	if(pid == 0)
+	{
+		FxShm client;
+		FxShmReader r;
+		uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0}, buf_len = 0;
+
+		if(fx_shm_attach(&client, shm_name) ||
+				fx_shm_reader_init(&client, &r, 0, 30))
+		{
+			_exit(1);
+		}
+		//Ready
+		buf[0] = 0xAA;
+		fx_shm_tx_push(&client, 0, buf, 1);
+		if(fx_shm_wait(&client, &r, 2000000) ||
+				fx_shm_read(&client, &r, buf, &buf_len) || (buf[3] != 42))
+		{
+			_exit(2);
+		}
+		fx_shm_tx_push(&client, 0, buf, buf_len);
+		_exit(0);
+	}
+
+	TEST_ASSERT_EQUAL(0, fx_shm_tx_wait(&daemon, 2000000));
+	TEST_ASSERT_EQUAL(0, fx_shm_tx_pop(&daemon, &port, frame, &len));
+	TEST_ASSERT_EQUAL(0xAA, frame[0]);
+
+	//Let it fall asleep
+	usleep(10000);
+	len = shm_frame(frame, 30, 42);
+	TEST_ASSERT_EQUAL(0, fx_shm_publish(&daemon, 0, frame, len));
+
+	TEST_ASSERT_EQUAL(0, fx_shm_tx_wait(&daemon, 2000000));
+	TEST_ASSERT_EQUAL(0, fx_shm_tx_pop(&daemon, &port, frame, &len));
+	TEST_ASSERT_EQUAL(4, len);
+	TEST_ASSERT_EQUAL(42, frame[3]);
+
+	TEST_ASSERT_EQUAL(pid, waitpid(pid, &status, 0));
+	TEST_ASSERT_TRUE(WIFEXITED(status));
+	TEST_ASSERT_EQUAL(0, WEXITSTATUS(status));
+
+	fx_shm_destroy(&daemon);
+}
+
+#endif	//defined(__linux__)
+
+void test_flexsea_shm(void)
+{
+#if defined(__linux__)
+	RUN_TEST(test_shm_publish_read);
+	RUN_TEST(test_shm_tx_queue);
+	RUN_TEST(test_shm_wait_other_process);
+#endif
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,187 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tests.h"
+#include "flexsea.h"
+
+//Events are recorded in order, the ring keeps the most recent ones
+void test_trace_record_read(void)
+{
+	FxTraceEvent events[FX_TRACE_DEPTH] = {0};
+
+	fx_trace_control(FX_TRACE_CTRL_CLEAR);
+	fx_trace_control(FX_TRACE_CTRL_START);
+
+	FX_TRACE(FX_TRACE_USER, 1, 100);
+	FX_TRACE(FX_TRACE_USER + 1, 2, 200);
+
+#if FX_TRACE_ENABLE
+	TEST_ASSERT_EQUAL(2, fx_trace_get_count());
+	TEST_ASSERT_EQUAL(2, fx_trace_read(0, events, FX_TRACE_DEPTH));
+	TEST_ASSERT_EQUAL(FX_TRACE_USER, events[0].event);
+	TEST_ASSERT_EQUAL(1, events[0].port);
+	TEST_ASSERT_EQUAL(100, events[0].arg);
+	TEST_ASSERT_EQUAL(FX_TRACE_USER + 1, events[1].event);
+	TEST_ASSERT_EQUAL(200, events[1].arg);
+	TEST_ASSERT_EQUAL(1, (events[1].timestamp - events[0].timestamp) < FX_TIMESTAMP_HZ);
+
+	//Pages
+	TEST_ASSERT_EQUAL(1, fx_trace_read(1, events, FX_TRACE_DEPTH));
+	TEST_ASSERT_EQUAL(200, events[0].arg);
+	TEST_ASSERT_EQUAL(0, fx_trace_read(2, events, FX_TRACE_DEPTH));
+
+	//Wrap: the oldest events are overwritten
+	for(int i = 0; i < FX_TRACE_DEPTH + 5; i++)
+	{
+		FX_TRACE(FX_TRACE_USER, 0, i);
+	}
+	TEST_ASSERT_EQUAL(FX_TRACE_DEPTH + 7, fx_trace_get_count());
+	TEST_ASSERT_EQUAL(FX_TRACE_DEPTH, fx_trace_read(0, events, FX_TRACE_DEPTH));
+	TEST_ASSERT_EQUAL(5, events[0].arg);
+	TEST_ASSERT_EQUAL(FX_TRACE_DEPTH + 4, events[FX_TRACE_DEPTH - 1].arg);
+
+	//Stopped: nothing gets recorded
+	fx_trace_control(FX_TRACE_CTRL_STOP);
+	FX_TRACE(FX_TRACE_USER, 0, 0);
+	TEST_ASSERT_EQUAL(FX_TRACE_DEPTH + 7, fx_trace_get_count());
+	fx_trace_control(FX_TRACE_CTRL_CLEAR);
+	fx_trace_control(FX_TRACE_CTRL_START);
+	TEST_ASSERT_EQUAL(0, fx_trace_read(0, events, FX_TRACE_DEPTH));
+#else
+	//Disabled: nothing to read
+	TEST_ASSERT_EQUAL(0, fx_trace_get_count());
+	TEST_ASSERT_EQUAL(0, fx_trace_read(0, events, FX_TRACE_DEPTH));
+#endif
+}
+
+//Does fx_receive() leave a trace, and can we dump it with FX_CMD_DIAG?
+void test_trace_diag_dump(void)
+{
+	static circ_buf_t cb;
+	CommPort cp;
+	uint8_t bytestream[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint8_t bytestream_len = 0;
+	uint8_t payload[3] = {FX_DIAG_TRACE, 0, 0};
+	uint8_t cmd = 0, len = 0;
+	uint8_t buf[MAX_ENCODED_PAYLOAD_BYTES] = {0};
+	uint16_t index = 0;
+	ReadWrite rw = CmdInvalid;
+	AckNack ack = Nack;
+	ReplyDesc desc = {0};
+
+	circ_buf_init(&cb);
+	fx_comm_port_init(&cp, 3, &cb, NULL);
+	fx_trace_control(FX_TRACE_CTRL_CLEAR);
+	fx_trace_control(FX_TRACE_CTRL_START);
+
+	//Read the first page
+	fx_create_bytestream_from_cmd(FX_CMD_DIAG, CmdRead, Nack, payload, 3,
+			bytestream, &bytestream_len);
+	for(int i = 0; i < bytestream_len; i++)
+	{
+		circ_buf_write_byte(&cb, bytestream[i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_receive(&cp));
+	TEST_ASSERT_EQUAL(0, fx_reply_queue_peek(&cp, &desc));
+	TEST_ASSERT_EQUAL(FX_DIAG_TRACE, desc.arg[0]);
+
+	//The reply is in the TX queue, we decode it from there
+	TEST_ASSERT_EQUAL(1, fx_comm_process_replies(&cp));
+	TxFrame *frame = &cp.txq.frame[TxReply][0];
+	circ_buf_init(&cb);
+	for(int i = 0; i < frame->len; i++)
+	{
+		circ_buf_write_byte(&cb, frame->data[i]);
+	}
+	TEST_ASSERT_EQUAL(0, fx_get_cmd_handler_from_bytestream(&cb, &cmd, &rw,
+			&ack, buf, &len));
+	TEST_ASSERT_EQUAL(FX_CMD_DIAG, cmd);
+	index = CMD_OVERHEAD;
+	TEST_ASSERT_EQUAL(FX_DIAG_TRACE, buf[index++]);
+	TEST_ASSERT_EQUAL(fx_timestamp_hz(), REBUILD_UINT32(buf, &index));
+	uint32_t count = REBUILD_UINT32(buf, &index);
+	TEST_ASSERT_EQUAL(0, REBUILD_UINT16(buf, &index));
+	uint8_t n = buf[index++];
+	TEST_ASSERT_EQUAL(index + n * sizeof(FxTraceEvent), len);
+
+#if FX_TRACE_ENABLE
+	//Frame start, decode, handler enter & exit (the reply itself gets traced
+	//once it's queued)
+	TEST_ASSERT_EQUAL(4, n);
+	TEST_ASSERT_EQUAL(4, count);
+	TEST_ASSERT_EQUAL(5, fx_trace_get_count());
+	FxTraceEvent *events = (FxTraceEvent *)&buf[index];
+	TEST_ASSERT_EQUAL(FX_TRACE_FRAME_START, events[0].event);
+	TEST_ASSERT_EQUAL(3, events[0].port);
+	TEST_ASSERT_EQUAL(FX_TRACE_DECODE_OK, events[1].event);
+	TEST_ASSERT_EQUAL(FX_CMD_DIAG, events[1].arg);
+	TEST_ASSERT_EQUAL(FX_TRACE_HANDLER_ENTER, events[2].event);
+	TEST_ASSERT_EQUAL(FX_TRACE_HANDLER_EXIT, events[3].event);
+	TEST_ASSERT_EQUAL(0, events[3].arg);
+#else
+	TEST_ASSERT_EQUAL(0, n);
+	TEST_ASSERT_EQUAL(0, count);
+#endif
+}
+
+static uint8_t trace_tx(uint8_t *bytes, uint16_t len)
+{
+	(void)bytes;
+	(void)len;
+	return 0;
+}
+
+//The TX complete interrupt doesn't touch the ring: the main loop records the
+//completion on its next pass
+void test_trace_async_tx_done(void)
+{
+	static circ_buf_t cb;
+	CommPort cp;
+	uint8_t payload[3] = {0};
+
+	circ_buf_init(&cb);
+	fx_comm_port_init(&cp, 2, &cb, &trace_tx);
+	cp.txq.async = 1;
+	TEST_ASSERT_EQUAL(0, fx_tx_queue_cmd(&cp, TxBulk, 12, CmdWrite, Nack,
+			payload, 3));
+	fx_trace_control(FX_TRACE_CTRL_CLEAR);
+	fx_trace_control(FX_TRACE_CTRL_START);
+
+	TEST_ASSERT_EQUAL(0, fx_comm_process_tx_queue(&cp));
+	uint32_t count = fx_trace_get_count();
+	fx_comm_tx_done(&cp);
+	uint32_t t_done = FX_TIMESTAMP();
+	TEST_ASSERT_EQUAL(count, fx_trace_get_count());
+	TEST_ASSERT_EQUAL(1, cp.txq.done);
+
+	//The main loop gets to it later, the event keeps the completion time
+	while((FX_TIMESTAMP() - t_done) < (FX_TIMESTAMP_HZ / 1000));
+	TEST_ASSERT_EQUAL(1, fx_comm_process_tx_queue(&cp));
+	TEST_ASSERT_EQUAL(0, cp.txq.done);
+
+#if FX_TRACE_ENABLE
+	FxTraceEvent events[FX_TRACE_DEPTH];
+	TEST_ASSERT_EQUAL(1, count);
+	TEST_ASSERT_EQUAL(2, fx_trace_read(0, events, FX_TRACE_DEPTH));
+	TEST_ASSERT_EQUAL(FX_TRACE_TX_START, events[0].event);
+	TEST_ASSERT_EQUAL(FX_TRACE_TX_COMPLETE, events[1].event);
+	TEST_ASSERT_EQUAL(2, events[1].port);
+	TEST_ASSERT_EQUAL(TxBulk, events[1].arg);
+	TEST_ASSERT_TRUE(events[1].timestamp <= t_done);
+	TEST_ASSERT_TRUE(events[1].timestamp >= events[0].timestamp);
+#endif
+}
+
+void test_flexsea_trace(void)
+{
+	RUN_TEST(test_trace_record_read);
+	RUN_TEST(test_trace_diag_dump);
+	RUN_TEST(test_trace_async_tx_done);
+
+	fflush(stdout);
+}
+
+#ifdef __cplusplus
+}
+#endif
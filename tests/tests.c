@@ -13,6 +13,13 @@ int main(void)
 	RUN_TEST(test_flexsea_command);
 	RUN_TEST(test_flexsea_comm);
 	RUN_TEST(test_flexsea);
+	RUN_TEST(test_flexsea_delta);
+	RUN_TEST(test_flexsea_trace);
+	RUN_TEST(test_flexsea_profile);
+	RUN_TEST(test_flexsea_bus);
+	RUN_TEST(test_flexsea_route);
+	RUN_TEST(test_flexsea_serial);
+	RUN_TEST(test_flexsea_shm);
 
 	return UNITY_END();
 }
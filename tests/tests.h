@@ -18,6 +18,13 @@ void test_flexsea_codec(void);
 void test_flexsea_command(void);
 void test_flexsea_comm(void);
 void test_flexsea(void);
+void test_flexsea_delta(void);
+void test_flexsea_trace(void);
+void test_flexsea_profile(void);
+void test_flexsea_bus(void);
+void test_flexsea_route(void);
+void test_flexsea_serial(void);
+void test_flexsea_shm(void);
 
 #endif	//INC_TEST_H
 